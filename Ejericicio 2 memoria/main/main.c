@@ -3,16 +3,16 @@
 #include "freertos/task.h"
 #include "led_strip.h" 
 #include "esp_log.h"
-#include "nvs.h"
 #include "nvs_flash.h"
+#include "nvs_cache.h"
 
 #define BLINK_GPIO 2
+#define NVS_COMMIT_MS 30000 // el color cambia cada segundo; a flash va como mucho cada 30 s
 
 uint8_t led_color = 0; 
 static const char *TAG = "NVS_TEST";
 
 led_strip_handle_t led_strip;
-nvs_handle_t_ app_nvs_handle;
 
 static void init_led_rgb(void)
 {
@@ -35,10 +35,15 @@ static void init_led_rgb(void)
 
 static esp_err_t init_nvs()
 {
-    esp_err_t error;
-    nvs_flash_init();
+    esp_err_t error = nvs_flash_init();
+    if (error == ESP_ERR_NVS_NO_FREE_PAGES || error == ESP_ERR_NVS_NEW_VERSION_FOUND)
+    {
+        ESP_ERROR_CHECK(nvs_flash_erase());
+        error = nvs_flash_init();
+    }
+    ESP_ERROR_CHECK(error);
 
-   error =  nvs_open(TAG,NVS_READWRITE, &app_nvs_handle);
+   error = nvs_cache_init(TAG, NVS_COMMIT_MS);
    if (error != ESP_OK)
    {
       ESP_LOGE(TAG, "Error opening NVS"); 
@@ -53,7 +58,7 @@ static esp_err_t init_nvs()
 static esp_err_t read_nvs(char * key, uint8_t * value)
 {
     esp_err_t error;
-    error = (app_nvs_handle, key,value );
+    error = nvs_cache_get_u8(key, value);
 
       if (error != ESP_OK)
    {
@@ -69,7 +74,7 @@ static esp_err_t read_nvs(char * key, uint8_t * value)
 static esp_err_t write_nvs(char * key, uint8_t value)
 {
     esp_err_t error;
-    error = nvs_set_u8(app_nvs_handle, key, value)
+    error = nvs_cache_set_u8(key, value);
 
           if (error != ESP_OK)
    {
@@ -127,5 +132,5 @@ void app_main(void)
         }
         vTaskDelay(pdMS_TO_TICKS(1000));
         write_nvs(key, led_color);
-    }
+    }
 }
\ No newline at end of file
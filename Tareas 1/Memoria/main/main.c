@@ -3,22 +3,21 @@
 #include "freertos/FreeRTOS.h"
 #include "freertos/task.h"
 #include "esp_log.h"
-#include "freertos/timers.h"
+#include "stimer.h"
 
 #define bombillodelesp32 2 // pin del led
 
 uint8_t led_level = 0;
 static const char *tag = "Main";
-TimerHandle_t xTimers;
+stimer_t xTimers; // en la rueda compartida: sin despertar la tarea de timers de FreeRTOS
 int interval = 50; // tiempo en ms
-int timerId = 1;
 
 esp_err_t init_led(void);
 esp_err_t blink_led(void);
 esp_err_t set_timer(void);
 
 // función del timer
-void vTimerCallback(TimerHandle_t pxTimer)
+void vTimerCallback(void *arg)
 {
     ESP_LOGI(tag, "Event was called from timer");
     blink_led(); // parpadea el led
@@ -50,23 +49,14 @@ esp_err_t blink_led(void)
 esp_err_t set_timer(void)
 {
     ESP_LOGI(tag, "Timer init configuration");
-    xTimers = xTimerCreate("Timer",                   
-                           (pdMS_TO_TICKS(interval)), 
-                           pdTRUE,                    
-                           (void *)timerId,           
-                           vTimerCallback);           
-
-    if (xTimers == NULL)
+    esp_err_t err = stimer_iniciar();
+    if (err != ESP_OK)
     {
         ESP_LOGE(tag, "The timer was not created.");
+        return err;
     }
-    else
-    {
-        if (xTimerStart(xTimers, 0) != pdPASS)
-        {
-            ESP_LOGE(tag, "The timer could not be set into the Active state");
-        }
-    }
+    stimer_crear(&xTimers, vTimerCallback, NULL);
+    stimer_periodico(&xTimers, interval);
 
     return ESP_OK;
 }
\ No newline at end of file
@@ -4,8 +4,10 @@
 #include "freertos/task.h"
 #include "esp_log.h"
 
-#include "nvs.h"
 #include "nvs_flash.h"
+#include "nvs_cache.h"
+#include "stimer.h"
+#include "alog.h"
 
 static const char *TAG = "WORDS_ROTATOR";
 
@@ -20,7 +22,13 @@ enum { kWordsCount = sizeof(kWords) / sizeof(kWords[0]) };
 /* --- NVS --- */
 static const char *kNvsNamespace = "storage";
 static const char *kIndexKey     = "current_index";
-static nvs_handle_t s_nvs = 0;
+/* El indice cambia cada 500 ms; a flash se confirma como mucho cada 10 s (y al reiniciar) */
+#define kNvsCommitMs 10000
+
+/* Cada 500 ms en la rueda compartida; app_main termina y su tarea (y pila) se liberan */
+#define kRotateMs 500
+static stimer_t s_rotate;
+static int32_t s_pos;
 
 /* --- Declaraciones --- */
 static void words_show(int32_t idx);
@@ -28,11 +36,13 @@ static int32_t words_next(int32_t idx);
 static esp_err_t nvs_boot(void);
 static int32_t nvs_read_index_default0(void);
 static void nvs_write_index(int32_t idx);
+static void words_tick(void *arg);
 
 /* ---------- Implementación ---------- */
 
 void app_main(void)
 {
+    alog_iniciar(1, tskNO_AFFINITY);   // el log del tick se vacía a la UART en esta tarea, no en esp_timer
     ESP_ERROR_CHECK(nvs_boot());
 
     int32_t pos = nvs_read_index_default0();
@@ -41,15 +51,21 @@ void app_main(void)
         pos = 0;
     }
 
-    for (;;) {
-        words_show(pos);               // Muestra palabra actual
-        pos = words_next(pos);         // Calcula siguiente posición (cíclica)
-        nvs_write_index(pos);          // Persiste el índice para el próximo arranque
-        vTaskDelay(pdMS_TO_TICKS(500)); // 500 ms
-    }
+    s_pos = pos;
+    words_tick(NULL);                  // la primera palabra enseguida
+    stimer_crear(&s_rotate, words_tick, NULL);
+    stimer_periodico(&s_rotate, kRotateMs);
 }
 
-/* Inicializa NVS y abre el espacio de trabajo */
+/* Corre en la tarea de esp_timer: solo log diferido (alog) y caché NVS (RAM), nada que bloquee */
+static void words_tick(void *arg)
+{
+    words_show(s_pos);                 // Muestra palabra actual
+    s_pos = words_next(s_pos);         // Calcula siguiente posición (cíclica)
+    nvs_write_index(s_pos);            // Persiste el índice para el próximo arranque
+}
+
+/* Inicializa NVS y abre el espacio de trabajo en la cache */
 static esp_err_t nvs_boot(void)
 {
     esp_err_t err = nvs_flash_init();
@@ -59,7 +75,7 @@ static esp_err_t nvs_boot(void)
     }
     ESP_ERROR_CHECK(err);
 
-    err = nvs_open(kNvsNamespace, NVS_READWRITE, &s_nvs);
+    err = nvs_cache_init(kNvsNamespace, kNvsCommitMs);
     if (err != ESP_OK) {
         ESP_LOGE(TAG, "No se pudo abrir NVS (%s)", esp_err_to_name(err));
     }
@@ -70,7 +86,7 @@ static esp_err_t nvs_boot(void)
 static int32_t nvs_read_index_default0(void)
 {
     int32_t idx = 0;
-    esp_err_t err = nvs_get_i32(s_nvs, kIndexKey, &idx);
+    esp_err_t err = nvs_cache_get_i32(kIndexKey, &idx);
     if (err == ESP_ERR_NVS_NOT_FOUND) {
         ESP_LOGI(TAG, "Indice no presente en NVS; iniciando en 0.");
         idx = 0;
@@ -81,17 +97,12 @@ static int32_t nvs_read_index_default0(void)
     return idx;
 }
 
-/* Escribe el indice y confirma el commit */
+/* Deja el indice en la cache; el commit lo agrupa nvs_cache */
 static void nvs_write_index(int32_t idx)
 {
-    esp_err_t err = nvs_set_i32(s_nvs, kIndexKey, idx);
-    if (err != ESP_OK) {
-        ESP_LOGE(TAG, "Error nvs_set_i32: %s", esp_err_to_name(err));
-        return;
-    }
-    err = nvs_commit(s_nvs);
+    esp_err_t err = nvs_cache_set_i32(kIndexKey, idx);
     if (err != ESP_OK) {
-        ESP_LOGE(TAG, "Error nvs_commit: %s", esp_err_to_name(err));
+        ESP_LOGE(TAG, "Error nvs_cache_set_i32: %s", esp_err_to_name(err));
     }
 }
 
@@ -100,7 +111,7 @@ static void words_show(int32_t idx)
 {
     // Seguridad: clamp por si llega un valor inesperado
     if (idx < 0 || idx >= (int32_t)kWordsCount) idx = 0;
-    ESP_LOGI(TAG, "%s", kWords[idx]);
+    ALOGI(TAG, "%s", kWords[idx]);    // literal: vive para siempre, se puede diferir
 }
 
 /* Calcula el siguiente indice cíclico */
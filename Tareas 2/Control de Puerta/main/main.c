@@ -7,11 +7,15 @@
 //   → CERRADO: luz apagada permanente
 //   → ABRIENDO: parpadeo rápido comenzando encendido
 //   → CERRANDO: parpadeo rápido comenzando apagado
+//   (lo genera el LEDC vía components/indic; ninguna tarea despierta por cada cambio)
 //
-// Órdenes válidas:
-//   - "abrir": se ignora si ya está abierto o en proceso
-//   - "cerrar": se ignora si ya está cerrado o en proceso
-//   - "emergencia": detiene toda acción hasta reinicio del dispositivo
+// Órdenes válidas (diccionario compartido components/gate_cmd: inglés o español, palabra suelta,
+// JSON {"cmd":...} o CBOR; sin distinguir mayúsculas):
+//   - "abrir"/"open": se ignora si ya está abierto o en proceso
+//   - "cerrar"/"close": se ignora si ya está cerrado o en proceso
+//   - "emergencia"/"emergency": detiene toda acción hasta reinicio del dispositivo
+//     (en CBOR también el código numérico STOP, como antes; "stop"/"parar" en texto no es una orden)
+//   - "diag": publica pila libre de las tareas y estado del heap
 
 #include <stdio.h>
 #include <stdint.h>
@@ -23,6 +27,7 @@
 
 #include "esp_log.h"
 #include "esp_system.h"
+#include "esp_heap_caps.h"
 #include "esp_event.h"
 #include "nvs_flash.h"
 #include "esp_netif.h"
@@ -32,6 +37,10 @@
 #include "mqtt_client.h"
 #include "driver/gpio.h"
 
+#include "gate_cmd.h"
+#include "gate_wire.h"
+#include "indic.h"
+
 // ===================================================
 //                General Configuration
 // ===================================================
@@ -39,6 +48,7 @@
 #define LED_PIN          GPIO_NUM_2
 #define TICKS_TRAVEL     30          // simulated motion duration
 #define BLINK_RATE_MS    100         // LED blink interval for transitions
+#define FSM_TASK_STACK   2048        // bytes; check with the "diag" command
 
 // MQTT Broker / Topics (same parameters, different format)
 #define MQTT_URI         "ws://broker.emqx.io:8083/mqtt"
@@ -46,6 +56,11 @@
 #define MQTT_PASS        "demo-para-el-canal"
 #define TOPIC_CMD        "easy-learning/puerta/cmd"
 #define TOPIC_STATUS     "easy-learning/puerta/status"
+// Binary wire format (gate_wire / CBOR) on the "<topic>/cbor" subtopics, JSON topics unchanged.
+// Status: 0 = JSON only, 1 = JSON + CBOR, 2 = CBOR only. Commands are accepted on both.
+#define WIRE_CBOR        0
+#define TOPIC_CMD_CBOR   TOPIC_CMD "/" GW_SUBTOPIC
+#define TOPIC_STATUS_CBOR TOPIC_STATUS "/" GW_SUBTOPIC
 
 // ===================================================
 //                State Definitions
@@ -65,20 +80,21 @@ typedef struct {
     volatile door_state_t target;
     volatile int          move_ticks;
     volatile bool         emergency;
-    volatile bool         blink_phase;
-    volatile bool         start_open_anim;
-    volatile bool         start_close_anim;
+    int                   led;           // indic channel of LED_PIN
     esp_mqtt_client_handle_t client;
 } controller_t;
 
+// Statically allocated task: no heap involved, stack visible in the map file
+static StackType_t  fsm_stack[FSM_TASK_STACK];
+static StaticTask_t fsm_tcb;
+static TaskHandle_t fsm_handle;
+
 static controller_t g = {
     .current          = ST_CLOSED,
     .target           = ST_CLOSED,
     .move_ticks       = 0,
     .emergency        = false,
-    .blink_phase      = false,
-    .start_open_anim  = true,
-    .start_close_anim = false,
+    .led              = -1,
     .client           = NULL
 };
 
@@ -86,10 +102,11 @@ static controller_t g = {
 //                Function Prototypes
 // ===================================================
 static void init_led(void);
+static void led_show(door_state_t st);
 static void start_mqtt(void);
 static void mqtt_send_status(const char *state, const char *info);
+static void mqtt_send_diag(void);
 static void mqtt_event_handler(void *handler_args, esp_event_base_t base, int32_t event_id, void *event_data);
-static void led_task(void *arg);
 static void fsm_task(void *arg);
 
 // ===================================================
@@ -104,23 +121,38 @@ static void mqtt_event_handler(void *handler_args, esp_event_base_t base, int32_
     case MQTT_EVENT_CONNECTED:
         ESP_LOGI(LOG_TAG, "Connected to MQTT broker");
         esp_mqtt_client_subscribe(g.client, TOPIC_CMD, 0);
+        esp_mqtt_client_subscribe(g.client, TOPIC_CMD_CBOR, 0);
         mqtt_send_status("boot", "system_ready");
         break;
 
     case MQTT_EVENT_DATA: {
-        char topic[64] = {0};
-        char data[64]  = {0};
-        snprintf(topic, sizeof(topic), "%.*s", ev->topic_len, ev->topic);
-        snprintf(data,  sizeof(data),  "%.*s", ev->data_len,  ev->data);
-        ESP_LOGI(LOG_TAG, "Received -> %s : %s", topic, data);
+        // Parsed in place from the MQTT buffer (not NUL-terminated): no copies
+        bool cbor = ev->topic_len == (int)sizeof(TOPIC_CMD_CBOR) - 1 &&
+                    memcmp(ev->topic, TOPIC_CMD_CBOR, sizeof(TOPIC_CMD_CBOR) - 1) == 0;
+        gate_cmd_msg_t m;
+        bool ok = cbor ? gate_cmd_parse_cbor((const uint8_t *)ev->data, (size_t)ev->data_len, &m)
+                       : gate_cmd_parse(ev->data, (size_t)ev->data_len, &m);
+        ESP_LOGI(LOG_TAG, "Received -> %.*s : %s", ev->topic_len, ev->topic, gate_cmd_nombre(m.cmd));
+        if (!ok) {
+            mqtt_send_status("error", cbor ? "bad_cbor_command" : "unknown_command");
+            break;
+        }
+
+        if (m.cmd == CMD_DIAG) {   // allowed even while moving or frozen
+            mqtt_send_diag();
+            break;
+        }
 
         if (g.emergency) {
             mqtt_send_status("error", "emergency_active_restart_required");
             break;
         }
 
-        if (strcmp(data, "emergencia") == 0) {
+        // Only "emergencia" latches. The numeric STOP code on the CBOR topic always meant
+        // emergency here; the text STOP aliases stay an unknown command, as before
+        if (m.cmd == CMD_EMERGENCY || (cbor && m.cmd == CMD_STOP)) {
             g.emergency = true;
+            if (g.led >= 0) indic_congelar(g.led);   // LED frozen where it is
             mqtt_send_status("emergency", "system_frozen_restart_needed");
             break;
         }
@@ -130,13 +162,13 @@ static void mqtt_event_handler(void *handler_args, esp_event_base_t base, int32_
             break;
         }
 
-        if (strcmp(data, "abrir") == 0) {
+        if (m.cmd == CMD_OPEN) {
             if (g.current == ST_OPEN) {
                 mqtt_send_status("error", "already_open");
             } else {
                 g.target = ST_OPEN;
             }
-        } else if (strcmp(data, "cerrar") == 0) {
+        } else if (m.cmd == CMD_CLOSE) {
             if (g.current == ST_CLOSED) {
                 mqtt_send_status("error", "already_closed");
             } else {
@@ -168,6 +200,18 @@ static void mqtt_send_status(const char *state, const char *info)
 {
     if (!g.client) return;
 
+#if WIRE_CBOR
+    uint8_t bin[96];
+    gw_writer_t w;
+    gw_writer_init(&w, bin, sizeof(bin));
+    gw_map(&w, (info && info[0]) ? 2 : 1);
+    gw_put_text(&w, GW_K_STATE, state);
+    if (info && info[0]) gw_put_text(&w, GW_K_INFO, info);
+    size_t n = gw_writer_len(&w);
+    if (n) esp_mqtt_client_publish(g.client, TOPIC_STATUS_CBOR, (const char *)bin, (int)n, 0, 0);
+    if (WIRE_CBOR == 2) return;
+#endif
+
     char payload[128];
     if (info && info[0]) {
         snprintf(payload, sizeof(payload),
@@ -179,67 +223,41 @@ static void mqtt_send_status(const char *state, const char *info)
     esp_mqtt_client_publish(g.client, TOPIC_STATUS, payload, 0, 0, 0);
 }
 
+// Stack high-water marks (bytes never used) and heap figures, as status "diag"
+static void mqtt_send_diag(void)
+{
+    char info[112];
+    TaskHandle_t mqtt = xTaskGetHandle("mqtt_task");
+    snprintf(info, sizeof(info), "heap_free=%u heap_min=%u heap_largest=%u fsm=%u mqtt=%u",
+             (unsigned)heap_caps_get_free_size(MALLOC_CAP_DEFAULT),
+             (unsigned)heap_caps_get_minimum_free_size(MALLOC_CAP_DEFAULT),
+             (unsigned)heap_caps_get_largest_free_block(MALLOC_CAP_DEFAULT),
+             fsm_handle ? (unsigned)uxTaskGetStackHighWaterMark(fsm_handle) : 0u,
+             mqtt ? (unsigned)uxTaskGetStackHighWaterMark(mqtt) : 0u);
+    mqtt_send_status("diag", info);
+}
+
 // ===================================================
 //                LED Section
 // ===================================================
 static void init_led(void)
 {
-    gpio_reset_pin(LED_PIN);
-    gpio_set_direction(LED_PIN, GPIO_MODE_OUTPUT);
-    gpio_set_level(LED_PIN, 0);
+    g.led = indic_agregar(LED_PIN, false);
+    if (g.led < 0) ESP_LOGE(LOG_TAG, "No LEDC channel for the LED");
 }
 
-// Handles LED feedback depending on door state
-static void led_task(void *arg)
+// LED feedback for a door state; the pattern then runs in hardware until the next change
+static void led_show(door_state_t st)
 {
-    TickType_t last = xTaskGetTickCount();
-
-    for (;;) {
-        if (g.emergency) {  // during emergency keep LED frozen
-            vTaskDelay(pdMS_TO_TICKS(200));
-            continue;
-        }
-
-        switch (g.current) {
-
-        case ST_OPEN:
-            gpio_set_level(LED_PIN, 1);  // solid ON
-            vTaskDelay(pdMS_TO_TICKS(200));
-            break;
-
-        case ST_CLOSED:
-            gpio_set_level(LED_PIN, 0);  // solid OFF
-            vTaskDelay(pdMS_TO_TICKS(200));
-            break;
-
-        case ST_OPENING:
-            // starts ON, toggles quickly
-            g.blink_phase = !g.blink_phase;
-            if (g.start_open_anim) {
-                gpio_set_level(LED_PIN, 1);
-                g.start_open_anim = false;
-            } else {
-                gpio_set_level(LED_PIN, g.blink_phase ? 1 : 0);
-            }
-            vTaskDelayUntil(&last, pdMS_TO_TICKS(BLINK_RATE_MS));
-            break;
-
-        case ST_CLOSING:
-            // starts OFF, toggles quickly (inverse pattern)
-            g.blink_phase = !g.blink_phase;
-            if (!g.start_close_anim) {
-                gpio_set_level(LED_PIN, 0);
-                g.start_close_anim = true;
-            } else {
-                gpio_set_level(LED_PIN, g.blink_phase ? 0 : 1);
-            }
-            vTaskDelayUntil(&last, pdMS_TO_TICKS(BLINK_RATE_MS));
-            break;
-
-        default:
-            vTaskDelay(pdMS_TO_TICKS(250));
-            break;
-        }
+    // Blink period = two BLINK_RATE_MS toggles; closing is the same blink shifted half a period
+    static const indic_patron_t k_open_blink  = { 2 * BLINK_RATE_MS, 50, 0 };
+    static const indic_patron_t k_close_blink = { 2 * BLINK_RATE_MS, 50, 50 };
+    if (g.led < 0) return;
+    switch (st) {
+    case ST_OPEN:    indic_set(g.led, INDIC_FIJO);    break;  // solid ON
+    case ST_CLOSED:  indic_set(g.led, INDIC_APAGADO); break;  // solid OFF
+    case ST_OPENING: indic_set(g.led, k_open_blink);  break;  // starts ON
+    case ST_CLOSING: indic_set(g.led, k_close_blink); break;  // starts OFF (inverse pattern)
     }
 }
 
@@ -258,12 +276,12 @@ static void fsm_task(void *arg)
         if (g.current == ST_OPEN && g.target == ST_CLOSED) {
             g.current = ST_CLOSING;
             g.move_ticks = TICKS_TRAVEL;
-            g.start_close_anim = false;
+            led_show(ST_CLOSING);
             mqtt_send_status("closing", "");
         } else if (g.current == ST_CLOSED && g.target == ST_OPEN) {
             g.current = ST_OPENING;
             g.move_ticks = TICKS_TRAVEL;
-            g.start_open_anim = true;
+            led_show(ST_OPENING);
             mqtt_send_status("opening", "");
         }
 
@@ -274,10 +292,12 @@ static void fsm_task(void *arg)
                 if (g.current == ST_OPENING) {
                     g.current = ST_OPEN;
                     g.target  = ST_OPEN;
+                    led_show(ST_OPEN);
                     mqtt_send_status("open", "");
                 } else {
                     g.current = ST_CLOSED;
                     g.target  = ST_CLOSED;
+                    led_show(ST_CLOSED);
                     mqtt_send_status("closed", "");
                 }
             }
@@ -305,9 +325,9 @@ void app_main(void)
     // Initial door state
     g.current = ST_CLOSED;
     g.target  = ST_CLOSED;
+    led_show(ST_CLOSED);
     mqtt_send_status("closed", "startup");
 
-    // Task creation
-    xTaskCreate(led_task, "led_task", 2048, NULL, 5, NULL);
-    xTaskCreate(fsm_task, "fsm_task", 2048, NULL, 6, NULL);
+    // Task creation (the LED needs none: LEDC runs the pattern)
+    fsm_handle = xTaskCreateStatic(fsm_task, "fsm_task", FSM_TASK_STACK, NULL, 6, fsm_stack, &fsm_tcb);
 }
@@ -0,0 +1,478 @@
+/**
+ * @file bench.c
+ * @brief Firmware de carga (soak) del controlador de portón.
+ *
+ * Usa sin cambios la FSM, cmd_sched, el antirrebote, el HAL y wifi_fast de main/, y les pone delante:
+ *  - generador: comandos sintéticos a BENCH_CMD_HZ por cmd_sched_submit() (q_cmd), como MQTT/LAN,
+ *  - planta: un esp_timer cada BENCH_PLANTA_US que mira el motor y escribe los finales de carrera en
+ *    los mismos pines (GPIO_MODE_INPUT_OUTPUT: la ISR de ls_debounce ve el flanco como si viniera de
+ *    afuera), con BENCH_REBOTES rebotes al pisar cada tope,
+ *  - tormenta MQTT: BENCH_PUB_HZ mensajes de BENCH_PUB_BYTES a "<BENCH_TOPIC>/storm", a los que el
+ *    banco está suscripto; el ida y vuelta por el broker sale de la marca que lleva cada payload.
+ *    Cada transición publica además el estado del portón, como el firmware.
+ *
+ * Cada BENCH_INFORME_S segundos (y al terminar, BENCH_DURACION_S; 0 = sin fin) sale por la UART una
+ * línea "BENCH {json}" con caudales, p50/p99/max de cada latencia, heap mínimo y fragmentación, y la
+ * pila libre de cada tarea; también va a "<BENCH_TOPIC>/summary" si hay broker. Para comparar versiones:
+ *   idf.py monitor | grep '^BENCH ' > corrida.jsonl
+ *
+ * Pines por defecto para un ESP32 DevKit: ningún cable externo (el loopback es el propio pad),
+ * pero no conectar el banco a un motor real.
+ */
+
+#include <stdio.h>
+#include <stdarg.h>
+#include <string.h>
+#include <stdbool.h>
+
+#include "freertos/FreeRTOS.h"
+#include "freertos/task.h"
+#include "freertos/event_groups.h"
+
+#include "driver/gpio.h"
+
+#include "esp_log.h"
+#include "esp_event.h"
+#include "esp_netif.h"
+#include "esp_wifi.h"
+#include "esp_timer.h"
+#include "esp_random.h"
+#include "esp_system.h"
+#include "esp_app_desc.h"
+#include "esp_heap_caps.h"
+#include "nvs_flash.h"
+#include "mqtt_client.h"
+
+#include "gate_fsm.h"
+#include "gate_hal_esp.h"
+#include "gate_json.h"
+#include "cmd_sched.h"
+#include "task_plan.h"
+#include "task_report.h"
+#include "wifi_fast.h"
+#include "nvs_cache.h"
+#include "alog.h"
+#include "bench_lat.h"
+
+// ----------------------- CONFIGURACIÓN AJUSTABLE ------------------------------
+// Red: sin SSID o sin broker el banco corre solo la parte local (comandos + planta)
+#ifndef BENCH_WIFI_SSID
+#define BENCH_WIFI_SSID     ""
+#endif
+#ifndef BENCH_WIFI_PASS
+#define BENCH_WIFI_PASS     ""
+#endif
+#ifndef BENCH_MQTT_URI
+#define BENCH_MQTT_URI      ""          // p.ej. mqtt://192.168.1.10:1883
+#endif
+#define BENCH_TOPIC         "bench/porton"
+
+#define BENCH_GATES         2
+#define BENCH_CMD_HZ        200         // comandos sintéticos por segundo (todos los portones)
+#define BENCH_PUB_HZ        50          // mensajes de la tormenta MQTT por segundo
+#define BENCH_PUB_BYTES     128
+#define BENCH_PUB_QOS       0
+#define BENCH_RECORRIDO_MS  400         // recorrido simulado de la hoja
+#define BENCH_DEBOUNCE_MS   3
+#define BENCH_REBOTES       2           // rebotes del contacto al pisar un tope (1 ms cada uno)
+#define BENCH_PLANTA_US     1000
+#define BENCH_MUESTRA_MS    1000        // muestreo de heap
+#define BENCH_INFORME_S     60
+#define BENCH_DURACION_S    (4 * 3600)  // 0 = sin fin
+#define BENCH_DRENAR_MS     2000        // al terminar: lo que quedó en cola llega antes del resumen
+
+// Tareas del banco: la FSM con los valores del firmware, la carga en el núcleo de red
+#define STACK_GEN       3072
+#define STACK_TORMENTA  4096
+#define STACK_INFORME   4096            // task_report_json + printf
+#define PRIO_GEN        PRIO_LOCAL      // entra por cmd_sched como un comando de la LAN
+#define PRIO_TORMENTA   PRIO_HTTPD
+#define PRIO_INFORME    PRIO_OTA
+
+#define NVS_NAMESPACE   "bench"
+#define NVS_COMMIT_MS   5000
+
+_Static_assert(BENCH_GATES <= CMD_SCHED_MAX_GATES, "BENCH_GATES excede CMD_SCHED_MAX_GATES");
+_Static_assert(BENCH_PUB_BYTES >= 64, "el payload de la tormenta lleva seq y marca de tiempo");
+
+static const char *TAG = "BENCH";
+
+static const gate_cfg_t k_cfg[BENCH_GATES] = {
+    { .nombre = "bench0", .pin_lsa = GPIO_NUM_25, .pin_lsc = GPIO_NUM_26, .pin_motor_a = GPIO_NUM_27, .pin_motor_c = GPIO_NUM_14,
+      .pin_lamp = GPIO_NUM_2,  .lm_activo = 0, .debounce_ms = BENCH_DEBOUNCE_MS, .t_open_ms = 3 * BENCH_RECORRIDO_MS, .t_close_ms = 3 * BENCH_RECORRIDO_MS },
+    { .nombre = "bench1", .pin_lsa = GPIO_NUM_32, .pin_lsc = GPIO_NUM_33, .pin_motor_a = GPIO_NUM_18, .pin_motor_c = GPIO_NUM_19,
+      .pin_lamp = GPIO_NUM_21, .lm_activo = 0, .debounce_ms = BENCH_DEBOUNCE_MS, .t_open_ms = 3 * BENCH_RECORRIDO_MS, .t_close_ms = 3 * BENCH_RECORRIDO_MS },
+};
+
+// ------------------------------ ESTADO ----------------------------------------
+static gate_t s_gates[BENCH_GATES];
+static gate_esp_t s_hw[BENCH_GATES];
+static EventGroupHandle_t s_ev;
+static StaticEventGroup_t s_ev_buf;
+static esp_mqtt_client_handle_t s_client = NULL;
+static volatile bool s_mqtt_ok = false;
+static volatile bool s_fin = false;          // terminó la corrida: los generadores se detienen
+
+// Planta simulada (solo la tarea esp_timer, salvo t_tope_us que lee la FSM)
+typedef struct {
+    int32_t          pos_us;                 // 0 = cerrado, BENCH_RECORRIDO_MS * 1000 = abierto
+    uint32_t         ls;                     // bits GATE_LS_* escritos en los pines
+    uint32_t         rebota;                 // bit que está rebotando
+    uint8_t          rebotes;                // cambios de nivel pendientes
+    volatile int64_t t_tope_us;              // cuándo se pisó el último tope (0 = ya medido)
+} planta_t;
+static planta_t s_planta[BENCH_GATES];
+static esp_timer_handle_t s_t_planta;
+
+// Latencias (cada una la escribe una sola tarea)
+typedef enum { LAT_DEQ = 0, LAT_ACT, LAT_LS_STOP, LAT_PUB, LAT_RTT, LAT_COUNT } lat_id_t;
+static const char *const k_lat_nombre[LAT_COUNT] = { "cmd_deq", "cmd_act", "ls_stop", "mqtt_pub", "mqtt_rtt" };
+static bench_lat_t s_lat[LAT_COUNT];
+
+static struct {
+    uint32_t cmd_tx, cmd_rechazados, aplicados;
+    uint32_t trans, abiertos, cerrados, errores;
+    uint32_t pub_tx, pub_fallidos, pub_rx, estados;
+    uint64_t pub_bytes;
+    uint32_t mqtt_caidas, wifi_caidas;
+    uint32_t heap_largest_min, frag_max_pct;
+} s_st;
+
+// Tareas (pila/TCB estáticos, como con TASK_PLAN_ESTATICO)
+#define TAREA(n, bytes)  static StackType_t n##_pila[bytes]; static StaticTask_t n##_tcb; static TaskHandle_t n
+TAREA(s_fsm, STACK_FSM);
+TAREA(s_gen, STACK_GEN);
+TAREA(s_torm, STACK_TORMENTA);
+TAREA(s_inf, STACK_INFORME);
+#define CREAR(n, fn, nombre, arg, prio, core) \
+    (n = xTaskCreateStaticPinnedToCore(fn, nombre, sizeof(n##_pila) / sizeof(StackType_t), arg, prio, n##_pila, &n##_tcb, core))
+
+static uint32_t s_rng = 1;
+static inline uint32_t rnd(void) { s_rng ^= s_rng << 13; s_rng ^= s_rng >> 17; s_rng ^= s_rng << 5; return s_rng; }
+
+// ------------------------------ PLANTA ----------------------------------------
+static void escribir_ls(int k, uint32_t ls) {
+    int act = k_cfg[k].lm_activo;
+    gpio_set_level(k_cfg[k].pin_lsa, (ls & GATE_LS_LSA) ? act : !act);
+    gpio_set_level(k_cfg[k].pin_lsc, (ls & GATE_LS_LSC) ? act : !act);
+}
+
+/** @brief La hoja avanza mientras el motor gira; en cada extremo el contacto rebota y queda pisado. */
+static void on_planta(void *arg) {
+    const int32_t fin = BENCH_RECORRIDO_MS * 1000;
+    for (int k = 0; k < BENCH_GATES; k++) {
+        planta_t *p = &s_planta[k];
+        const gate_t *g = &s_gates[k];
+        if (g->motorA)      p->pos_us += BENCH_PLANTA_US;
+        else if (g->motorC) p->pos_us -= BENCH_PLANTA_US;
+        if (p->pos_us > fin) p->pos_us = fin;
+        if (p->pos_us < 0)   p->pos_us = 0;
+        uint32_t ls = (p->pos_us >= fin ? GATE_LS_LSA : 0) | (p->pos_us <= 0 ? GATE_LS_LSC : 0);
+        if (ls != p->ls) {
+            uint32_t nuevo = ls & ~p->ls;
+            if (nuevo) { p->t_tope_us = esp_timer_get_time(); p->rebota = nuevo; p->rebotes = 2 * BENCH_REBOTES; }
+            p->ls = ls;
+            escribir_ls(k, ls);
+        } else if (p->rebotes) {
+            p->rebotes--;
+            escribir_ls(k, (p->rebotes & 1) ? (ls & ~p->rebota) : ls);
+        }
+    }
+}
+
+/** @brief Los pines de los finales pasan a entrada+salida y arrancan cerrados. */
+static void planta_iniciar(void) {
+    for (int k = 0; k < BENCH_GATES; k++) {
+        s_planta[k] = (planta_t){ .pos_us = 0, .ls = GATE_LS_LSC };
+        escribir_ls(k, GATE_LS_LSC);
+        gpio_set_direction(k_cfg[k].pin_lsa, GPIO_MODE_INPUT_OUTPUT);
+        gpio_set_direction(k_cfg[k].pin_lsc, GPIO_MODE_INPUT_OUTPUT);
+    }
+    const esp_timer_create_args_t a = { .callback = on_planta, .name = "planta" };
+    ESP_ERROR_CHECK(esp_timer_create(&a, &s_t_planta));
+    ESP_ERROR_CHECK(esp_timer_start_periodic(s_t_planta, BENCH_PLANTA_US));
+}
+
+// ------------------------------ FSM -------------------------------------------
+static void on_transicion(gate_t *g, int prev) {
+    s_st.trans++;
+    if (g->estado == ESTADO_ERROR) s_st.errores++;
+    bool tope = (prev == ESTADO_ABRIENDO && g->estado == ESTADO_ABIERTO) || (prev == ESTADO_CERRANDO && g->estado == ESTADO_CERRADO);
+    if (tope) {
+        if (g->estado == ESTADO_ABIERTO) s_st.abiertos++; else s_st.cerrados++;
+        int64_t t0 = s_planta[g->id].t_tope_us;
+        if (t0) { bench_lat_add(&s_lat[LAT_LS_STOP], esp_timer_get_time() - t0); s_planta[g->id].t_tope_us = 0; }
+    }
+    if (!s_mqtt_ok) return;
+    char js[GATE_JSON_MAX];
+    size_t n = gate_json_estado(js, sizeof(js), g, true, true);
+    if (n && esp_mqtt_client_enqueue(s_client, BENCH_TOPIC "/status", js, (int)n, 0, 0, true) >= 0) s_st.estados++;
+}
+
+/** @brief Igual que state_machine_task() del firmware, más la medición de cada comando. */
+static void fsm_task(void *arg) {
+    for (int k = 0; k < BENCH_GATES; k++) ESP_ERROR_CHECK(gate_esp_init(&s_gates[k], &s_hw[k], &k_cfg[k], (uint8_t)k, s_ev, on_transicion));
+    planta_iniciar();
+    ESP_ERROR_CHECK(cmd_sched_init(s_ev, EV_CMD));
+    vTaskDelay(pdMS_TO_TICKS(4 * BENCH_DEBOUNCE_MS + 10));   // el antirrebote confirma lo que escribió la planta
+    for (int k = 0; k < BENCH_GATES; k++) gate_evaluar(&s_gates[k]);
+    xTaskNotifyGive((TaskHandle_t)arg);
+    while (1) {
+        EventBits_t ev = xEventGroupWaitBits(s_ev, EV_CMD | EV_LS | EV_DEADLINE, pdTRUE, pdFALSE, portMAX_DELAY);
+        if (ev & (EV_LS | EV_DEADLINE)) {
+            for (int k = 0; k < BENCH_GATES; k++) gate_evaluar(&s_gates[k]);
+        }
+        gate_msg_t m;
+        while (cmd_sched_next(&m)) {
+            if (m.gate >= BENCH_GATES) continue;
+            gate_t *g = &s_gates[m.gate];
+            if (m.t_rx_us) bench_lat_add(&s_lat[LAT_DEQ], esp_timer_get_time() - m.t_rx_us);
+            bool lamp = m.cmd == CMD_LAMP_ON || m.cmd == CMD_LAMP_OFF;
+            if (!lamp) gate_ref_fijar(g, &m.ref, m.t_rx_us);
+            g->t_cmd_rx_us = m.t_rx_us;
+            gate_comando(g, (gate_cmd_t)m.cmd);
+            g->t_cmd_rx_us = 0;
+            if (!lamp && g->ref_act_us >= 0) bench_lat_add(&s_lat[LAT_ACT], g->ref_act_us);
+            s_st.aplicados++;
+        }
+    }
+}
+
+// ------------------------------ GENERADORES -----------------------------------
+/** @brief Cuántos eventos tocan en este tick para sostener `hz` (el resto se arrastra). */
+static inline uint32_t por_tick(uint32_t hz, uint32_t *resto) {
+    *resto += hz;
+    uint32_t n = *resto / configTICK_RATE_HZ;
+    *resto %= configTICK_RATE_HZ;
+    return n;
+}
+
+// Mezcla de comandos: mayoría de movimientos, algo de STOP/TOGGLE y lámpara. Nunca EMERGENCY (traba)
+static const uint8_t k_mezcla[] = {
+    CMD_OPEN, CMD_OPEN, CMD_OPEN, CMD_CLOSE, CMD_CLOSE, CMD_CLOSE, CMD_TOGGLE, CMD_STOP, CMD_LAMP_ON, CMD_LAMP_OFF,
+};
+
+static void generador_task(void *arg) {
+    TickType_t t = xTaskGetTickCount();
+    uint32_t resto = 0, id = 0;
+    while (!s_fin) {
+        vTaskDelayUntil(&t, 1);
+        for (uint32_t n = por_tick(BENCH_CMD_HZ, &resto); n; n--) {
+            if (!++id) id = 1;   // 0 = sin referencia
+            gate_ref_t r = { .id = id };
+            gate_cmd_t c = (gate_cmd_t)k_mezcla[rnd() % sizeof(k_mezcla)];
+            if (cmd_sched_submit((uint8_t)(rnd() % BENCH_GATES), c, esp_timer_get_time(), &r)) s_st.cmd_tx++;
+            else s_st.cmd_rechazados++;
+        }
+    }
+    vTaskSuspend(NULL);   // queda viva para el informe de pila
+}
+
+static void tormenta_task(void *arg) {
+    static char js[BENCH_PUB_BYTES + 1];
+    TickType_t t = xTaskGetTickCount();
+    uint32_t resto = 0, seq = 0;
+    while (!s_fin) {
+        vTaskDelayUntil(&t, 1);
+        for (uint32_t n = por_tick(BENCH_PUB_HZ, &resto); n && s_mqtt_ok; n--) {
+            int64_t t0 = esp_timer_get_time();
+            int h = snprintf(js, sizeof(js), "{\"seq\":%lu,\"t\":%lld,\"pad\":\"", (unsigned long)++seq, (long long)t0);
+            memset(js + h, 'x', BENCH_PUB_BYTES - 2 - (size_t)h);
+            memcpy(js + BENCH_PUB_BYTES - 2, "\"}", 2);
+            int r = esp_mqtt_client_publish(s_client, BENCH_TOPIC "/storm", js, BENCH_PUB_BYTES, BENCH_PUB_QOS, 0);
+            bench_lat_add(&s_lat[LAT_PUB], esp_timer_get_time() - t0);
+            if (r < 0) s_st.pub_fallidos++;
+            else { s_st.pub_tx++; s_st.pub_bytes += BENCH_PUB_BYTES; }
+        }
+    }
+    vTaskSuspend(NULL);
+}
+
+/** @brief Marca "t" del payload de la tormenta (sin terminador); 0 si no está al principio. */
+static int64_t leer_marca(const char *d, int n) {
+    for (int i = 0; i + 4 < n && i < 32; i++) {
+        if (memcmp(d + i, "\"t\":", 4)) continue;
+        int64_t v = 0;
+        for (i += 4; i < n && d[i] >= '0' && d[i] <= '9'; i++) v = v * 10 + (d[i] - '0');
+        return v;
+    }
+    return 0;
+}
+
+// ------------------------------ RED -------------------------------------------
+static void mqtt_event_handler(void *handler_args, esp_event_base_t base, int32_t event_id, void *event_data) {
+    esp_mqtt_event_handle_t e = event_data;
+    switch (event_id) {
+        case MQTT_EVENT_CONNECTED:
+            esp_mqtt_client_subscribe(s_client, BENCH_TOPIC "/storm", 0);
+            s_mqtt_ok = true;
+            break;
+        case MQTT_EVENT_DISCONNECTED:
+            if (s_mqtt_ok) s_st.mqtt_caidas++;
+            s_mqtt_ok = false;
+            break;
+        case MQTT_EVENT_DATA: {
+            if (e->current_data_offset || e->topic_len != (int)sizeof(BENCH_TOPIC "/storm") - 1) break;
+            int64_t t0 = leer_marca(e->data, e->data_len);
+            if (t0) { bench_lat_add(&s_lat[LAT_RTT], esp_timer_get_time() - t0); s_st.pub_rx++; }
+            break;
+        }
+        default: break;
+    }
+}
+
+static void mqtt_iniciar(void) {
+    const esp_mqtt_client_config_t cfg = { .broker.address.uri = BENCH_MQTT_URI, .task.priority = PRIO_MQTT };
+    s_client = esp_mqtt_client_init(&cfg);
+    esp_mqtt_client_register_event(s_client, ESP_EVENT_ANY_ID, mqtt_event_handler, NULL);
+    esp_mqtt_client_start(s_client);
+    CREAR(s_torm, tormenta_task, "tormenta", NULL, PRIO_TORMENTA, CORE_NET);
+}
+
+static void wifi_event_handler(void *arg, esp_event_base_t base, int32_t id, void *data) {
+    if (base == WIFI_EVENT && id == WIFI_EVENT_STA_START) esp_wifi_connect();
+    else if (base == WIFI_EVENT && id == WIFI_EVENT_STA_CONNECTED) wifi_fast_on_connected((wifi_event_sta_connected_t *)data);
+    else if (base == WIFI_EVENT && id == WIFI_EVENT_STA_DISCONNECTED) {
+        s_st.wifi_caidas++;
+        wifi_fast_on_disconnected();
+        esp_wifi_connect();
+    } else if (base == IP_EVENT && id == IP_EVENT_STA_GOT_IP) {
+        wifi_fast_on_got_ip(&((ip_event_got_ip_t *)data)->ip_info);
+        if (!s_client && BENCH_MQTT_URI[0]) mqtt_iniciar();
+    }
+}
+
+static void wifi_iniciar(void) {
+    esp_err_t ret = nvs_flash_init();
+    if (ret == ESP_ERR_NVS_NO_FREE_PAGES || ret == ESP_ERR_NVS_NEW_VERSION_FOUND) { ESP_ERROR_CHECK(nvs_flash_erase()); ESP_ERROR_CHECK(nvs_flash_init()); }
+    ESP_ERROR_CHECK(nvs_cache_init(NVS_NAMESPACE, NVS_COMMIT_MS));
+    ESP_ERROR_CHECK(esp_netif_init());
+    ESP_ERROR_CHECK(esp_event_loop_create_default());
+    esp_netif_t *sta = esp_netif_create_default_wifi_sta();
+    wifi_init_config_t ic = WIFI_INIT_CONFIG_DEFAULT();
+    ESP_ERROR_CHECK(esp_wifi_init(&ic));
+    ESP_ERROR_CHECK(esp_event_handler_register(WIFI_EVENT, ESP_EVENT_ANY_ID, wifi_event_handler, NULL));
+    ESP_ERROR_CHECK(esp_event_handler_register(IP_EVENT, IP_EVENT_STA_GOT_IP, wifi_event_handler, NULL));
+    wifi_fast_init(sta, BENCH_WIFI_SSID, false);
+    wifi_config_t c = { 0 };
+    strncpy((char *)c.sta.ssid, BENCH_WIFI_SSID, sizeof(c.sta.ssid));
+    strncpy((char *)c.sta.password, BENCH_WIFI_PASS, sizeof(c.sta.password));
+    wifi_fast_config(&c);
+    ESP_ERROR_CHECK(esp_wifi_set_mode(WIFI_MODE_STA));
+    ESP_ERROR_CHECK(esp_wifi_set_config(WIFI_IF_STA, &c));
+    ESP_ERROR_CHECK(esp_wifi_start());
+}
+
+// ------------------------------ INFORME ---------------------------------------
+typedef struct { char *p; size_t left; bool ok; } out_t;
+
+static void put(out_t *o, const char *fmt, ...) __attribute__((format(printf, 2, 3)));
+static void put(out_t *o, const char *fmt, ...) {
+    if (!o->ok) return;
+    va_list ap; va_start(ap, fmt);
+    int n = vsnprintf(o->p, o->left, fmt, ap);
+    va_end(ap);
+    if (n < 0 || (size_t)n >= o->left) { o->ok = false; return; }
+    o->p += n; o->left -= (size_t)n;
+}
+
+static inline unsigned long por_s(uint64_t x, uint32_t s) { return s ? (unsigned long)(x / s) : 0; }
+
+/** @brief Resumen de una línea; los caudales son promedios desde el arranque de la carga. */
+static size_t resumen(char *buf, size_t cap, uint32_t up_s, bool final) {
+    out_t o = { buf, cap, true };
+    cmd_sched_stats_t cs; cmd_sched_get_stats(&cs);
+    put(&o, "{\"fw\":\"%s\",\"idf\":\"%s\",\"up_s\":%lu,\"final\":%s,", esp_app_get_description()->version,
+        esp_get_idf_version(), (unsigned long)up_s, final ? "true" : "false");
+    put(&o, "\"cfg\":{\"gates\":%d,\"cmd_hz\":%d,\"pub_hz\":%d,\"pub_bytes\":%d,\"pub_qos\":%d,\"travel_ms\":%d,\"bounces\":%d},",
+        BENCH_GATES, BENCH_CMD_HZ, BENCH_PUB_HZ, BENCH_PUB_BYTES, BENCH_PUB_QOS, BENCH_RECORRIDO_MS, BENCH_REBOTES);
+    put(&o, "\"cmd\":{\"tx\":%lu,\"rejected\":%lu,\"applied\":%lu,\"per_s\":%lu,\"coalesced\":%lu,\"queue_full\":%lu,\"annulled\":%lu,\"depth_max\":%lu},",
+        (unsigned long)s_st.cmd_tx, (unsigned long)s_st.cmd_rechazados, (unsigned long)s_st.aplicados, por_s(s_st.aplicados, up_s),
+        (unsigned long)cs.coalescidos, (unsigned long)cs.descartes_llena, (unsigned long)cs.anulados_stop, (unsigned long)cs.profundidad_max);
+    put(&o, "\"fsm\":{\"trans\":%lu,\"per_s\":%lu,\"opened\":%lu,\"closed\":%lu,\"errors\":%lu},",
+        (unsigned long)s_st.trans, por_s(s_st.trans, up_s), (unsigned long)s_st.abiertos, (unsigned long)s_st.cerrados, (unsigned long)s_st.errores);
+    put(&o, "\"mqtt\":{\"connected\":%s,\"tx\":%lu,\"tx_fail\":%lu,\"rx\":%lu,\"per_s\":%lu,\"bytes\":%llu,\"status\":%lu,\"outbox\":%d,\"disconnects\":%lu,\"wifi_drops\":%lu},",
+        s_mqtt_ok ? "true" : "false", (unsigned long)s_st.pub_tx, (unsigned long)s_st.pub_fallidos, (unsigned long)s_st.pub_rx,
+        por_s(s_st.pub_tx, up_s), (unsigned long long)s_st.pub_bytes, (unsigned long)s_st.estados,
+        s_client ? esp_mqtt_client_get_outbox_size(s_client) : 0, (unsigned long)s_st.mqtt_caidas, (unsigned long)s_st.wifi_caidas);
+    put(&o, "\"lat_us\":{");
+    for (int i = 0; i < LAT_COUNT; i++) {
+        const bench_lat_t *h = &s_lat[i];
+        put(&o, "%s\"%s\":{\"n\":%lu,\"avg\":%lu,\"p50\":%lu,\"p99\":%lu,\"max\":%lu}", i ? "," : "", k_lat_nombre[i], (unsigned long)h->n,
+            h->n ? (unsigned long)(h->suma / h->n) : 0, (unsigned long)bench_lat_percentil(h, 500),
+            (unsigned long)bench_lat_percentil(h, 990), (unsigned long)h->max);
+    }
+    put(&o, "},\"heap\":{\"free\":%u,\"min\":%u,\"largest\":%u,\"largest_min\":%lu,\"frag_max_pct\":%lu},\"stack_free\":{",
+        (unsigned)heap_caps_get_free_size(MALLOC_CAP_DEFAULT), (unsigned)heap_caps_get_minimum_free_size(MALLOC_CAP_DEFAULT),
+        (unsigned)heap_caps_get_largest_free_block(MALLOC_CAP_DEFAULT), (unsigned long)s_st.heap_largest_min, (unsigned long)s_st.frag_max_pct);
+    static const char *const k_sistema[] = { "esp_timer", "mqtt_task", "tiT", "wifi", "sys_evt", "alog" };
+    struct { const char *n; TaskHandle_t h; } t[4 + sizeof(k_sistema) / sizeof(k_sistema[0])] = {
+        { "fsm", s_fsm }, { "generador", s_gen }, { "tormenta", s_torm }, { "informe", s_inf },
+    };
+    size_t nt = 4;
+    for (size_t i = 0; i < sizeof(k_sistema) / sizeof(k_sistema[0]); i++) { t[nt].n = k_sistema[i]; t[nt++].h = xTaskGetHandle(k_sistema[i]); }
+    bool primero = true;
+    for (size_t i = 0; i < nt; i++) {
+        if (!t[i].h) continue;
+        put(&o, "%s\"%s\":%u", primero ? "" : ",", t[i].n, (unsigned)uxTaskGetStackHighWaterMark(t[i].h));
+        primero = false;
+    }
+    put(&o, "},\"cpu\":");
+    if (o.ok) {
+        size_t n = task_report_json(o.p, o.left);
+        if (n) { o.p += n; o.left -= n; } else put(&o, "null");
+    }
+    put(&o, "}");
+    return o.ok ? cap - o.left : 0;
+}
+
+static void muestrear_heap(void) {
+    uint32_t libre = (uint32_t)heap_caps_get_free_size(MALLOC_CAP_DEFAULT);
+    uint32_t mayor = (uint32_t)heap_caps_get_largest_free_block(MALLOC_CAP_DEFAULT);
+    if (!s_st.heap_largest_min || mayor < s_st.heap_largest_min) s_st.heap_largest_min = mayor;
+    uint32_t frag = libre ? 100u - (uint32_t)((uint64_t)mayor * 100u / libre) : 0;
+    if (frag > s_st.frag_max_pct) s_st.frag_max_pct = frag;
+}
+
+static void informar(int64_t t0_us, bool final) {
+    static char js[3072];
+    size_t n = resumen(js, sizeof(js), (uint32_t)((esp_timer_get_time() - t0_us) / 1000000), final);
+    if (!n) { ESP_LOGW(TAG, "Resumen truncado"); return; }
+    printf("BENCH %s\n", js);
+    if (s_mqtt_ok) esp_mqtt_client_publish(s_client, BENCH_TOPIC "/summary", js, (int)n, 1, 0);
+}
+
+static void informe_task(void *arg) {
+    int64_t t0 = esp_timer_get_time();
+    TickType_t t = xTaskGetTickCount();
+    uint32_t muestras = 0;
+    const uint32_t por_informe = BENCH_INFORME_S * 1000u / BENCH_MUESTRA_MS;
+    while (1) {
+        vTaskDelayUntil(&t, pdMS_TO_TICKS(BENCH_MUESTRA_MS));
+        muestrear_heap();
+        if (BENCH_DURACION_S && esp_timer_get_time() - t0 >= (int64_t)BENCH_DURACION_S * 1000000) break;
+        if (++muestras % por_informe == 0) informar(t0, false);
+    }
+    s_fin = true;
+    vTaskDelay(pdMS_TO_TICKS(BENCH_DRENAR_MS));
+    muestrear_heap();
+    informar(t0, true);
+    ESP_LOGI(TAG, "Corrida terminada (%d s)", BENCH_DURACION_S);
+    vTaskSuspend(NULL);
+}
+
+// ------------------------------ ARRANQUE --------------------------------------
+void app_main(void) {
+    s_rng = esp_random() | 1u;
+    s_ev = xEventGroupCreateStatic(&s_ev_buf);
+    CREAR(s_fsm, fsm_task, "fsm", xTaskGetCurrentTaskHandle(), PRIO_FSM, CORE_CTRL);
+    ulTaskNotifyTake(pdTRUE, portMAX_DELAY);
+    alog_iniciar(PRIO_LOG, CORE_NET);
+
+    if (BENCH_WIFI_SSID[0]) wifi_iniciar();
+    else ESP_LOGW(TAG, "Sin BENCH_WIFI_SSID: sin tormenta MQTT");
+    CREAR(s_gen, generador_task, "generador", NULL, PRIO_GEN, CORE_NET);
+    CREAR(s_inf, informe_task, "informe", NULL, PRIO_INFORME, CORE_NET);
+    ESP_LOGI(TAG, "Banco: %d portones, %d cmd/s, %d pub/s de %d B, informe cada %d s", BENCH_GATES, BENCH_CMD_HZ,
+             BENCH_PUB_HZ, BENCH_PUB_BYTES, BENCH_INFORME_S);
+}
@@ -0,0 +1,43 @@
+/**
+ * @file bench_lat.c
+ * @brief Buckets log-lineales y percentiles (ver bench_lat.h).
+ */
+
+#include "bench_lat.h"
+
+#define SUB_N  (1u << BENCH_LAT_SUB)
+
+static inline uint32_t bucket(uint32_t v) {
+    if (v < SUB_N) return v;
+    uint32_t oct = 31u - (uint32_t)__builtin_clz(v);   // >= BENCH_LAT_SUB
+    uint32_t sub = (v >> (oct - BENCH_LAT_SUB)) & (SUB_N - 1);
+    return ((oct - BENCH_LAT_SUB + 1) << BENCH_LAT_SUB) | sub;
+}
+/** @brief Mayor valor que cae en el bucket `i`. */
+static inline uint32_t techo(uint32_t i) {
+    if (i < SUB_N) return i;
+    uint32_t oct = (i >> BENCH_LAT_SUB) + BENCH_LAT_SUB - 1, sub = i & (SUB_N - 1);
+    uint64_t bajo = (uint64_t)(SUB_N | sub) << (oct - BENCH_LAT_SUB);
+    uint64_t t = bajo + (1ull << (oct - BENCH_LAT_SUB)) - 1;
+    return t > UINT32_MAX ? UINT32_MAX : (uint32_t)t;
+}
+
+void bench_lat_add(bench_lat_t *h, int64_t us) {
+    if (us < 0) return;
+    uint32_t v = us > UINT32_MAX ? UINT32_MAX : (uint32_t)us;
+    uint32_t i = bucket(v);
+    h->b[i < BENCH_LAT_BUCKETS ? i : BENCH_LAT_BUCKETS - 1]++;
+    if (v > h->max) h->max = v;
+    h->suma += v;
+    h->n++;
+}
+
+uint32_t bench_lat_percentil(const bench_lat_t *h, uint32_t pm) {
+    if (!h->n) return 0;
+    uint64_t objetivo = ((uint64_t)h->n * pm + 999) / 1000, acum = 0;
+    if (!objetivo) objetivo = 1;
+    for (uint32_t i = 0; i < BENCH_LAT_BUCKETS; i++) {
+        if ((acum += h->b[i]) >= objetivo) { uint32_t t = techo(i); return t < h->max ? t : h->max; }
+    }
+    return h->max;
+}
@@ -0,0 +1,26 @@
+/**
+ * @file bench_lat.h
+ * @brief Histograma de latencias con percentiles: 8 sub-buckets por octava (error < 12,5 %).
+ *
+ * Valores en µs. 0..7 son exactos; desde 8, cada potencia de dos se parte en 8 tramos iguales.
+ * Cada histograma lo escribe una sola tarea; la lectura desde otra es aproximada (cuentas sueltas).
+ * Sin dependencias de ESP-IDF.
+ */
+#pragma once
+
+#include <stdint.h>
+
+#define BENCH_LAT_SUB      3                          // log2 de sub-buckets por octava
+#define BENCH_LAT_BUCKETS  (30u << BENCH_LAT_SUB)     // hasta 2^32 µs
+
+typedef struct {
+    uint32_t n;
+    uint32_t max;
+    uint64_t suma;
+    uint32_t b[BENCH_LAT_BUCKETS];
+} bench_lat_t;
+
+void bench_lat_add(bench_lat_t *h, int64_t us);
+
+/** @brief Percentil `pm` por mil (500 = p50, 990 = p99): límite superior de su bucket, acotado por max. */
+uint32_t bench_lat_percentil(const bench_lat_t *h, uint32_t pm);
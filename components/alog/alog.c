@@ -0,0 +1,118 @@
+/**
+ * @file alog.c
+ * @brief Anillo multi-productor sin locks (secuencia por ranura) y tarea que lo vacía.
+ */
+
+#include "alog.h"
+
+#include <stdio.h>
+#include <string.h>
+
+#include "freertos/FreeRTOS.h"
+#include "freertos/task.h"
+#include "esp_log.h"
+
+_Static_assert((ALOG_REGISTROS & (ALOG_REGISTROS - 1)) == 0, "ALOG_REGISTROS debe ser potencia de 2");
+_Static_assert(sizeof(uintptr_t) == sizeof(uint32_t), "los argumentos se pasan a snprintf como palabras de 32 bits");
+#define MASK (ALOG_REGISTROS - 1u)
+
+// La ranura de la posición p está libre si seq == ronda(p) y escrita si seq == ronda(p) + 1; al
+// leerla pasa a ronda(p) + ALOG_REGISTROS. Arranca en 0 (ronda 0) sin inicializar nada.
+typedef struct {
+    uint32_t    seq;
+    uint32_t    ms;
+    const char *tag;
+    const char *fmt;
+    uint32_t    a[ALOG_ARGS];
+    uint8_t     nivel;
+} reg_t;
+
+static reg_t          s_r[ALOG_REGISTROS];
+static uint32_t       s_cab;            // próxima posición a reservar (productores)
+static uint32_t       s_cola;           // próxima a leer (solo la tarea)
+static alog_stats_t   s_st;
+static alog_reenvio_t s_reenvio;
+static int            s_reenvio_max;
+
+static StaticTask_t   s_tcb;
+static StackType_t    s_pila[ALOG_STACK];
+static TaskHandle_t   s_task;
+
+static inline uint32_t ronda(uint32_t p) { return p & ~MASK; }
+
+// ------------------------------ PRODUCTORES -----------------------------------
+void alog_put(uint8_t nivel, const char *tag, const char *fmt, uint32_t a0, uint32_t a1, uint32_t a2, uint32_t a3) {
+    uint32_t p = __atomic_load_n(&s_cab, __ATOMIC_RELAXED);
+    reg_t *r;
+    while (1) {
+        r = &s_r[p & MASK];
+        int32_t d = (int32_t)(__atomic_load_n(&r->seq, __ATOMIC_ACQUIRE) - ronda(p));
+        if (d == 0) {
+            if (__atomic_compare_exchange_n(&s_cab, &p, p + 1, true, __ATOMIC_RELAXED, __ATOMIC_RELAXED)) break;
+        } else if (d < 0) {   // la tarea todavía no leyó la vuelta anterior: lleno
+            __atomic_fetch_add(&s_st.descartados, 1u, __ATOMIC_RELAXED);
+            return;
+        } else {
+            p = __atomic_load_n(&s_cab, __ATOMIC_RELAXED);   // otro productor ganó la ranura
+        }
+    }
+    r->ms = esp_log_timestamp(); r->tag = tag; r->fmt = fmt; r->nivel = nivel;
+    r->a[0] = a0; r->a[1] = a1; r->a[2] = a2; r->a[3] = a3;
+    __atomic_store_n(&r->seq, ronda(p) + 1, __ATOMIC_RELEASE);
+    __atomic_fetch_add(&s_st.escritos, 1u, __ATOMIC_RELAXED);
+}
+
+// ------------------------------ TAREA -----------------------------------------
+static void emitir(int nivel, uint32_t ms, const char *tag, const char *msg, size_t n) {
+    static const char k_letra[] = "NEWIDV";
+    printf("%c (%lu) %s: %.*s\n", k_letra[nivel <= ALOG_VERBOSE ? nivel : 0], (unsigned long)ms, tag, (int)n, msg);
+    alog_reenvio_t cb = s_reenvio;
+    if (cb && nivel <= s_reenvio_max) cb(nivel, tag, msg, n);
+}
+
+/** @brief Formatea y saca todo lo escrito; se detiene en la primera ranura a medio escribir. */
+static void drenar(void) {
+    static char linea[ALOG_LINEA_MAX];
+    uint32_t pend = __atomic_load_n(&s_cab, __ATOMIC_RELAXED) - s_cola;
+    if (pend > s_st.ocupacion_max) s_st.ocupacion_max = pend;
+    while (1) {
+        reg_t *r = &s_r[s_cola & MASK];
+        if (__atomic_load_n(&r->seq, __ATOMIC_ACQUIRE) != ronda(s_cola) + 1) break;
+        reg_t c = *r;
+        __atomic_store_n(&r->seq, ronda(s_cola) + ALOG_REGISTROS, __ATOMIC_RELEASE);   // libre ya: se formatea la copia
+        s_cola++;
+        int n = snprintf(linea, sizeof(linea), c.fmt, c.a[0], c.a[1], c.a[2], c.a[3]);
+        if (n < 0) continue;
+        emitir(c.nivel, c.ms, c.tag, linea, (size_t)n < sizeof(linea) ? (size_t)n : sizeof(linea) - 1);
+    }
+}
+
+static void alog_task(void *arg) {
+    uint32_t perdidos = 0;
+    while (1) {
+        vTaskDelay(pdMS_TO_TICKS(ALOG_DRENAR_MS));
+        drenar();
+        uint32_t d = __atomic_load_n(&s_st.descartados, __ATOMIC_RELAXED);
+        if (d != perdidos) {
+            char m[48];
+            int n = snprintf(m, sizeof(m), "%lu registros descartados (anillo lleno)", (unsigned long)(d - perdidos));
+            perdidos = d;
+            emitir(ALOG_WARN, esp_log_timestamp(), "ALOG", m, (size_t)n);
+        }
+    }
+}
+
+esp_err_t alog_iniciar(unsigned prio, int core) {
+    if (s_task) return ESP_OK;
+    s_task = xTaskCreateStaticPinnedToCore(alog_task, "alog", ALOG_STACK, NULL, prio, s_pila, &s_tcb,
+                                           core < 0 ? tskNO_AFFINITY : core);
+    return s_task ? ESP_OK : ESP_FAIL;
+}
+
+void alog_reenviar(alog_reenvio_t cb, int nivel_max) { s_reenvio_max = nivel_max; s_reenvio = cb; }
+
+void alog_get_stats(alog_stats_t *st) {
+    st->escritos = __atomic_load_n(&s_st.escritos, __ATOMIC_RELAXED);
+    st->descartados = __atomic_load_n(&s_st.descartados, __ATOMIC_RELAXED);
+    st->ocupacion_max = s_st.ocupacion_max;
+}
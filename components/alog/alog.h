@@ -0,0 +1,85 @@
+/**
+ * @file alog.h
+ * @brief Log diferido: el llamador deja un registro fijo en un anillo sin locks y una tarea de
+ *        baja prioridad lo formatea y lo saca por UART (y opcionalmente por un reenvío, p. ej. MQTT).
+ *
+ * En el camino caliente no hay formateo ni UART: ALOGx guarda marca de tiempo, nivel, TAG, el
+ * puntero al formato y hasta ALOG_ARGS argumentos de 32 bits (un CAS y unas escrituras a RAM).
+ * Por eso los argumentos solo pueden ser enteros de hasta 32 bits o cadenas que vivan para
+ * siempre (literales, TAG, nombres de configuración); nada de float, 64 bits ni buffers de pila.
+ * Si el anillo está lleno el registro se descarta y se cuenta; la tarea avisa cuántos se perdieron.
+ *
+ * Nivel en compilación por módulo, como LOG_LOCAL_LEVEL de esp_log: definir ALOG_NIVEL antes de
+ * incluir este header (o con target_compile_definitions en el componente). Lo que queda por
+ * encima no genera código. Se puede llamar desde cualquier tarea o callback de esp_timer; no desde ISR.
+ */
+#pragma once
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+
+#include "esp_err.h"
+
+#define ALOG_NINGUNO  0
+#define ALOG_ERROR    1
+#define ALOG_WARN     2
+#define ALOG_INFO     3
+#define ALOG_DEBUG    4
+#define ALOG_VERBOSE  5
+
+#ifndef ALOG_NIVEL
+#ifdef CONFIG_LOG_MAXIMUM_LEVEL
+#define ALOG_NIVEL    CONFIG_LOG_MAXIMUM_LEVEL
+#else
+#define ALOG_NIVEL    ALOG_INFO
+#endif
+#endif
+
+#ifndef ALOG_REGISTROS
+#define ALOG_REGISTROS  128           // potencia de 2; 36 bytes cada uno
+#endif
+#define ALOG_ARGS       4
+#define ALOG_LINEA_MAX  160           // línea ya formateada (se recorta)
+#define ALOG_DRENAR_MS  20            // la tarea revisa el anillo con este periodo
+#define ALOG_STACK      3072
+
+/** @brief Recibe cada línea formateada (sin '\n') en la tarea de log. `nivel` es ALOG_ERROR.. */
+typedef void (*alog_reenvio_t)(int nivel, const char *tag, const char *linea, size_t len);
+
+/** @brief Crea la tarea que vacía el anillo. Antes de eso los registros se acumulan (y descartan). */
+esp_err_t alog_iniciar(unsigned prio, int core);
+
+/** @brief Reenvía las líneas de nivel <= `nivel_max` (NULL lo quita). Corre en la tarea de log. */
+void alog_reenviar(alog_reenvio_t cb, int nivel_max);
+
+/** @brief Deja un registro en el anillo; usar las macros ALOGx. */
+void alog_put(uint8_t nivel, const char *tag, const char *fmt, uint32_t a0, uint32_t a1, uint32_t a2, uint32_t a3);
+
+typedef struct {
+    uint32_t escritos;
+    uint32_t descartados;   // anillo lleno
+    uint32_t ocupacion_max; // registros pendientes, máximo visto por la tarea
+} alog_stats_t;
+
+void alog_get_stats(alog_stats_t *st);
+
+static inline void __attribute__((format(printf, 1, 2))) alog_chk_(const char *fmt, ...) { }
+
+// Hasta ALOG_ARGS argumentos; los que faltan se completan con 0. alog_chk_ revisa el formato y
+// ALOG_N_ (cuenta hasta 8) hace que uno de más no compile en vez de perderse en silencio
+#define ALOG_A_(_, a, b, c, d, ...)  (uint32_t)(uintptr_t)(a), (uint32_t)(uintptr_t)(b), (uint32_t)(uintptr_t)(c), (uint32_t)(uintptr_t)(d)
+#define ALOG_N__(_, a, b, c, d, e, f, g, h, n, ...)  n
+#define ALOG_N_(...)  ALOG_N__(0, ##__VA_ARGS__, 8, 7, 6, 5, 4, 3, 2, 1, 0)
+#define ALOG_(n, tag, fmt, ...) \
+    do { \
+        _Static_assert(ALOG_N_(__VA_ARGS__) <= ALOG_ARGS, "ALOGx: mas de ALOG_ARGS argumentos"); \
+        if (0) alog_chk_((fmt), ##__VA_ARGS__); \
+        if (ALOG_NIVEL >= (n)) alog_put((n), (tag), (fmt), ALOG_A_(0, ##__VA_ARGS__, 0, 0, 0, 0)); \
+    } while (0)
+
+#define ALOGE(tag, fmt, ...)  ALOG_(ALOG_ERROR,   tag, fmt, ##__VA_ARGS__)
+#define ALOGW(tag, fmt, ...)  ALOG_(ALOG_WARN,    tag, fmt, ##__VA_ARGS__)
+#define ALOGI(tag, fmt, ...)  ALOG_(ALOG_INFO,    tag, fmt, ##__VA_ARGS__)
+#define ALOGD(tag, fmt, ...)  ALOG_(ALOG_DEBUG,   tag, fmt, ##__VA_ARGS__)
+#define ALOGV(tag, fmt, ...)  ALOG_(ALOG_VERBOSE, tag, fmt, ##__VA_ARGS__)
@@ -0,0 +1,180 @@
+/**
+ * @file gate_cmd.c
+ * @brief Diccionario por hash perfecto y escáneres JSON / palabra / CBOR para los tópicos de comandos.
+ */
+
+#include "gate_cmd.h"
+
+#include <string.h>
+#include <strings.h>
+
+#include "gate_cmd_dic.h"
+#include "gate_cmd_hash.h"
+#include "gate_wire.h"
+
+typedef struct { const char *p, *end; } scan_t;
+
+// ------------------------------ DICCIONARIO -----------------------------------
+typedef struct { const char *s; uint8_t n; uint8_t cmd; } palabra_t;
+#define X(p, c) { p, sizeof(p) - 1, c },
+static const palabra_t k_palabras[] = { GATE_CMD_PALABRAS(X) };
+#undef X
+_Static_assert(sizeof(k_palabras) / sizeof(k_palabras[0]) == GATE_CMD_HASH_PALABRAS,
+               "gate_cmd_hash.h no corresponde a gate_cmd_dic.h (lo genera el build)");
+
+static const char *const k_nombres[CMD_ULTIMO + 1] = {
+    "NONE", "OPEN", "CLOSE", "STOP", "TOGGLE", "LAMP_ON", "LAMP_OFF", "METRICS", "DIAG", "EMERGENCY",
+};
+
+gate_cmd_t gate_cmd_palabra(const char *s, size_t n) {
+    if (!n || n > GATE_CMD_PALABRA_MAX) return CMD_NONE;
+    uint8_t r = k_gate_cmd_ranura[gate_cmd_hash(s, n, GATE_CMD_HASH_SEMILLA) >> (32 - GATE_CMD_HASH_BITS)];
+    if (!r) return CMD_NONE;
+    const palabra_t *p = &k_palabras[r - 1];
+    return (p->n == n && !strncasecmp(p->s, s, n)) ? (gate_cmd_t)p->cmd : CMD_NONE;
+}
+
+const char *gate_cmd_nombre(gate_cmd_t cmd) { return (cmd > CMD_NONE && cmd <= CMD_ULTIMO) ? k_nombres[cmd] : k_nombres[0]; }
+
+// ------------------------------ JSON ------------------------------------------
+
+static inline void skip_ws(scan_t *s) {
+    while (s->p < s->end && (*s->p == ' ' || *s->p == '\t' || *s->p == '\r' || *s->p == '\n')) s->p++;
+}
+static inline bool eat(scan_t *s, char c) {
+    skip_ws(s);
+    if (s->p < s->end && *s->p == c) { s->p++; return true; }
+    return false;
+}
+
+/** @brief Cadena entre comillas; devuelve el contenido crudo (sin desescapar). */
+static bool scan_string(scan_t *s, const char **str, size_t *n) {
+    if (!eat(s, '"')) return false;
+    const char *ini = s->p;
+    while (s->p < s->end && *s->p != '"') {
+        if (*s->p == '\\') s->p++;
+        s->p++;
+    }
+    if (s->p >= s->end) return false;
+    *str = ini; *n = (size_t)(s->p - ini);
+    s->p++;
+    return true;
+}
+
+/** @brief Salta un valor cualquiera (anidados por conteo de llaves/corchetes). */
+static bool skip_value(scan_t *s) {
+    skip_ws(s);
+    if (s->p >= s->end) return false;
+    if (*s->p == '"') { const char *x; size_t n; return scan_string(s, &x, &n); }
+    if (*s->p == '{' || *s->p == '[') {
+        int depth = 0;
+        while (s->p < s->end) {
+            char c = *s->p;
+            if (c == '"') { const char *x; size_t n; if (!scan_string(s, &x, &n)) return false; continue; }
+            if (c == '{' || c == '[') depth++;
+            else if (c == '}' || c == ']') { if (--depth == 0) { s->p++; return true; } }
+            s->p++;
+        }
+        return false;
+    }
+    // número / true / false / null
+    while (s->p < s->end && *s->p != ',' && *s->p != '}' && *s->p != ' ' && *s->p != '\t' && *s->p != '\r' && *s->p != '\n') s->p++;
+    return true;
+}
+
+static bool scan_int(scan_t *s, int *v) {
+    skip_ws(s);
+    bool neg = (s->p < s->end && *s->p == '-');
+    if (neg) s->p++;
+    if (s->p >= s->end || *s->p < '0' || *s->p > '9') return false;
+    int acc = 0;
+    while (s->p < s->end && *s->p >= '0' && *s->p <= '9') {
+        if (acc < 100000) acc = acc * 10 + (*s->p - '0');
+        s->p++;
+    }
+    *v = neg ? -acc : acc;
+    return skip_value(s);   // descarta decimales/exponente si los hubiera
+}
+
+/** @brief Entero sin signo; false si no lo es o pasa de `max`. */
+static bool scan_u64(scan_t *s, uint64_t max, uint64_t *v) {
+    skip_ws(s);
+    if (s->p >= s->end || *s->p < '0' || *s->p > '9') return false;
+    uint64_t acc = 0;
+    while (s->p < s->end && *s->p >= '0' && *s->p <= '9') {
+        unsigned d = (unsigned)(*s->p++ - '0');
+        if (acc > (max - d) / 10) return false;
+        acc = acc * 10 + d;
+    }
+    *v = acc;
+    return skip_value(s);
+}
+
+#define KEY_IS(k, n, lit) ((n) == sizeof(lit) - 1 && !memcmp((k), lit, sizeof(lit) - 1))
+
+bool gate_cmd_parse_json(const char *data, size_t len, gate_cmd_msg_t *out) {
+    out->cmd = CMD_NONE; out->gate = -1; out->ref = (gate_ref_t){ 0 };
+    if (!data || !len) return false;
+
+    scan_t s = { data, data + len };
+    if (!eat(&s, '{')) return false;
+    if (eat(&s, '}')) return false;
+
+    do {
+        const char *key; size_t kn;
+        if (!scan_string(&s, &key, &kn) || !eat(&s, ':')) return false;
+        skip_ws(&s);
+        if (KEY_IS(key, kn, "cmd") && s.p < s.end && *s.p == '"') {
+            const char *v; size_t vn;
+            if (!scan_string(&s, &v, &vn)) return false;
+            out->cmd = gate_cmd_palabra(v, vn);
+        } else if (KEY_IS(key, kn, "gate") && s.p < s.end && (*s.p == '-' || (*s.p >= '0' && *s.p <= '9'))) {
+            if (!scan_int(&s, &out->gate)) return false;
+        } else if (KEY_IS(key, kn, "id") && s.p < s.end && *s.p >= '0' && *s.p <= '9') {
+            uint64_t v; if (!scan_u64(&s, UINT32_MAX, &v)) return false;
+            out->ref.id = (uint32_t)v;
+        } else if (KEY_IS(key, kn, "ts") && s.p < s.end && *s.p >= '0' && *s.p <= '9') {
+            if (!scan_u64(&s, UINT64_MAX, &out->ref.ts)) return false;
+        } else if (!skip_value(&s)) {
+            return false;
+        }
+    } while (eat(&s, ','));
+
+    return eat(&s, '}') && out->cmd != CMD_NONE;
+}
+
+// ------------------------------ PALABRA / AUTO --------------------------------
+static inline bool es_ws(char c) { return c == ' ' || c == '\t' || c == '\r' || c == '\n'; }
+
+bool gate_cmd_parse(const char *data, size_t len, gate_cmd_msg_t *out) {
+    out->cmd = CMD_NONE; out->gate = -1; out->ref = (gate_ref_t){ 0 };
+    if (!data) return false;
+    const char *p = data, *end = data + len;
+    while (p < end && es_ws(*p)) p++;
+    if (p < end && *p == '{') return gate_cmd_parse_json(p, (size_t)(end - p), out);
+    while (end > p && es_ws(end[-1])) end--;
+    out->cmd = gate_cmd_palabra(p, (size_t)(end - p));
+    return out->cmd != CMD_NONE;
+}
+
+// ------------------------------ CBOR ------------------------------------------
+
+static void cbor_campo(void *ctx, uint32_t clave, const gw_val_t *v) {
+    gate_cmd_msg_t *out = ctx;
+    if (clave == GW_K_CMD) {
+        if (v->tipo == GW_T_UINT && v->i > CMD_NONE && v->i <= CMD_ULTIMO) out->cmd = (gate_cmd_t)v->i;
+        else if (v->tipo == GW_T_TEXT) out->cmd = gate_cmd_palabra(v->s, v->n);   // también se acepta el nombre
+    } else if (clave == GW_K_GATE && v->tipo == GW_T_UINT && v->i < 256) {
+        out->gate = (int)v->i;
+    } else if (clave == GW_K_ID && v->tipo == GW_T_UINT && v->i <= UINT32_MAX) {
+        out->ref.id = (uint32_t)v->i;
+    } else if (clave == GW_K_TS && v->tipo == GW_T_UINT) {
+        out->ref.ts = (uint64_t)v->i;
+    }
+}
+
+bool gate_cmd_parse_cbor(const uint8_t *data, size_t len, gate_cmd_msg_t *out) {
+    out->cmd = CMD_NONE; out->gate = -1; out->ref = (gate_ref_t){ 0 };
+    if (!data || !len) return false;
+    return gw_parse(data, len, cbor_campo, out) && out->cmd != CMD_NONE;
+}
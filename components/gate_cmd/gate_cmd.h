@@ -0,0 +1,67 @@
+/**
+ * @file gate_cmd.h
+ * @brief Comandos de portón comunes a los dos firmwares: conjunto, diccionario y lectura sin copias.
+ *
+ * Un mensaje puede venir como:
+ *   - JSON: {"cmd":"OPEN","gate":0,"id":17,"ts":1700000000000} (claves desconocidas se saltan),
+ *   - palabra suelta: "abrir", "STOP", " emergencia\n" (espacios alrededor se ignoran),
+ *   - CBOR (gate_wire.h): {GW_K_CMD: gate_cmd_t o nombre, GW_K_GATE, GW_K_ID, GW_K_TS}.
+ * Todo se recorre una vez sobre el buffer original, sin heap ni copias.
+ *
+ * Las palabras (inglés y español, sin distinguir mayúsculas) están en gate_cmd_dic.h y se buscan
+ * con un hash perfecto generado por tools/cmd_hash_gen (gate_cmd_hash.h): un hash y una comparación.
+ *
+ * "id" (uint32) y "ts" (entero sin signo, en la unidad que use el emisor) son opcionales y vuelven
+ * en el estado que provoque el comando (ver gate_ref_t). Los números de gate_cmd_t son parte del
+ * protocolo binario: no renumerar. Sin dependencias de ESP-IDF (se compila también en el host).
+ */
+#pragma once
+
+#include <stddef.h>
+#include <stdbool.h>
+#include <stdint.h>
+
+typedef enum {
+    CMD_NONE = 0,
+    CMD_OPEN,
+    CMD_CLOSE,
+    CMD_STOP,
+    CMD_TOGGLE,
+    CMD_LAMP_ON,
+    CMD_LAMP_OFF,
+    CMD_METRICS,       // no llega a la FSM: pide el informe de gate_metrics
+    CMD_DIAG,          // no llega a la FSM: pide pilas libres y estado del heap
+    CMD_EMERGENCY,     // STOP que queda trabado: ningún movimiento hasta reiniciar
+    CMD_ULTIMO = CMD_EMERGENCY
+} gate_cmd_t;
+
+// Referencia opcional que trae un comando ("id"/"ts") y vuelve en el estado que provoca
+typedef struct {
+    uint32_t id;    // 0 = sin id
+    uint64_t ts;    // marca de tiempo del emisor, se devuelve tal cual (0 = no vino)
+} gate_ref_t;
+
+typedef struct {
+    gate_cmd_t cmd;
+    int        gate;     // -1 si el mensaje no trae "gate"
+    gate_ref_t ref;      // ceros si no trae "id"/"ts"
+} gate_cmd_msg_t;
+
+/** @brief Busca una palabra (sin terminador, sin distinguir mayúsculas). CMD_NONE si no existe. */
+gate_cmd_t gate_cmd_palabra(const char *s, size_t n);
+
+/** @brief Nombre canónico ("OPEN", "EMERGENCY", ...); "NONE" fuera de rango. */
+const char *gate_cmd_nombre(gate_cmd_t cmd);
+
+/**
+ * @brief Analiza `len` bytes de `data` (no necesita terminador): objeto JSON si empieza con '{',
+ *        si no, palabra suelta.
+ * @return true si se encontró un comando reconocido.
+ */
+bool gate_cmd_parse(const char *data, size_t len, gate_cmd_msg_t *out);
+
+/** @brief Solo JSON. */
+bool gate_cmd_parse_json(const char *data, size_t len, gate_cmd_msg_t *out);
+
+/** @brief Igual que gate_cmd_parse_json() para un mensaje CBOR. */
+bool gate_cmd_parse_cbor(const uint8_t *data, size_t len, gate_cmd_msg_t *out);
@@ -0,0 +1,40 @@
+/**
+ * @file gate_cmd_dic.h
+ * @brief Palabras aceptadas y función de hash; las usan gate_cmd.c y tools/cmd_hash_gen.
+ *
+ * gate_cmd_hash.h lo regenera el build desde este archivo (gate_cmd_hash.cmake) en su directorio de
+ * build; no hay que correr tools/cmd_hash_gen a mano. No guardar una copia en components/gate_cmd:
+ * el #include "gate_cmd_hash.h" la encontraría antes que la generada y volvería una tabla vieja.
+ * (gate_sim verifica el diccionario completo al arrancar).
+ */
+#pragma once
+
+#include <stddef.h>
+#include <stdint.h>
+
+#include "gate_cmd.h"
+
+#define GATE_CMD_PALABRA_MAX  10   // la más larga; lo más largo se rechaza sin mirar la tabla
+
+// X(palabra en minúsculas, comando)
+#define GATE_CMD_PALABRAS(X)                                                   \
+    X("open", CMD_OPEN)           X("abrir", CMD_OPEN)                         \
+    X("close", CMD_CLOSE)         X("cerrar", CMD_CLOSE)                       \
+    X("stop", CMD_STOP)           X("parar", CMD_STOP)       X("detener", CMD_STOP) \
+    X("toggle", CMD_TOGGLE)       X("alternar", CMD_TOGGLE)                    \
+    X("lamp_on", CMD_LAMP_ON)     X("luz_on", CMD_LAMP_ON)                     \
+    X("lamp_off", CMD_LAMP_OFF)   X("luz_off", CMD_LAMP_OFF)                   \
+    X("metrics", CMD_METRICS)     X("metricas", CMD_METRICS)                   \
+    X("diag", CMD_DIAG)                                                        \
+    X("emergency", CMD_EMERGENCY) X("emergencia", CMD_EMERGENCY) X("estop", CMD_EMERGENCY)
+
+/** @brief FNV-1a de 32 bits sobre la palabra en minúsculas, mezclado con `semilla`. */
+static inline uint32_t gate_cmd_hash(const char *s, size_t n, uint32_t semilla) {
+    uint32_t h = 2166136261u ^ semilla;
+    for (size_t i = 0; i < n; i++) {
+        uint8_t c = (uint8_t)s[i];
+        if (c >= 'A' && c <= 'Z') c = (uint8_t)(c + 32);
+        h = (h ^ c) * 16777619u;
+    }
+    return h ^ (h >> 15);
+}
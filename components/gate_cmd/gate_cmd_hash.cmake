@@ -0,0 +1,35 @@
+# gate_cmd_hash.h se genera en el build desde gate_cmd_dic.h (tools/cmd_hash_gen), así que la tabla
+# no puede quedar vieja respecto del diccionario. Uso: include() de este archivo y
+# gate_cmd_hash(<target que compila gate_cmd.c>).
+set(GATE_CMD_DIR ${CMAKE_CURRENT_LIST_DIR})
+set(GATE_CMD_GEN_DIR ${CMAKE_CURRENT_LIST_DIR}/../../tools/cmd_hash_gen)
+
+function(gate_cmd_hash target)
+    set(out ${CMAKE_CURRENT_BINARY_DIR}/gate_cmd_gen)
+    if(ESP_PLATFORM)
+        # El compilador del proyecto es el cruzado: el generador es un proyecto aparte con el del host
+        include(ExternalProject)
+        ExternalProject_Add(cmd_hash_gen_host
+            SOURCE_DIR ${GATE_CMD_GEN_DIR}
+            BINARY_DIR ${out}/host
+            INSTALL_COMMAND ""
+            BUILD_ALWAYS 1
+            BUILD_BYPRODUCTS ${out}/host/cmd_hash_gen)
+        set(gen ${out}/host/cmd_hash_gen)
+        set(gen_dep cmd_hash_gen_host ${gen})
+    else()
+        add_executable(cmd_hash_gen ${GATE_CMD_GEN_DIR}/cmd_hash_gen.c)
+        target_include_directories(cmd_hash_gen PRIVATE ${GATE_CMD_DIR})
+        set(gen $<TARGET_FILE:cmd_hash_gen>)
+        set(gen_dep cmd_hash_gen)
+    endif()
+    add_custom_command(OUTPUT ${out}/gate_cmd_hash.h
+        COMMAND ${CMAKE_COMMAND} -E make_directory ${out}
+        COMMAND ${gen} ${out}/gate_cmd_hash.h
+        DEPENDS ${gen_dep} ${GATE_CMD_DIR}/gate_cmd_dic.h
+        COMMENT "Generando gate_cmd_hash.h desde gate_cmd_dic.h"
+        VERBATIM)
+    add_custom_target(${target}_cmd_hash DEPENDS ${out}/gate_cmd_hash.h)
+    add_dependencies(${target} ${target}_cmd_hash)
+    target_include_directories(${target} PRIVATE ${out})
+endfunction()
@@ -0,0 +1,117 @@
+/**
+ * @file gate_wire.c
+ * @brief Codificador/decodificador CBOR mínimo (ver gate_wire.h).
+ */
+
+#include "gate_wire.h"
+
+#include <string.h>
+
+// Tipos mayores CBOR
+#define MT_UINT  0
+#define MT_NEG   1
+#define MT_BYTES 2
+#define MT_TEXT  3
+#define MT_ARRAY 4
+#define MT_MAP   5
+#define MT_TAG   6
+#define MT_SIMPLE 7
+
+#define SIMPLE_FALSE 20
+#define SIMPLE_TRUE  21
+
+// ------------------------------ ESCRITURA ------------------------------------
+static void cabecera(gw_writer_t *w, uint8_t mt, uint64_t v) {
+    if (!w->ok) return;
+    uint8_t tmp[9]; size_t n;
+    if (v < 24)          { tmp[0] = (uint8_t)(mt << 5 | v); n = 1; }
+    else if (v <= 0xFF)  { tmp[0] = (uint8_t)(mt << 5 | 24); tmp[1] = (uint8_t)v; n = 2; }
+    else if (v <= 0xFFFF){ tmp[0] = (uint8_t)(mt << 5 | 25); tmp[1] = (uint8_t)(v >> 8); tmp[2] = (uint8_t)v; n = 3; }
+    else if (v <= 0xFFFFFFFFu) { tmp[0] = (uint8_t)(mt << 5 | 26); tmp[1] = (uint8_t)(v >> 24); tmp[2] = (uint8_t)(v >> 16); tmp[3] = (uint8_t)(v >> 8); tmp[4] = (uint8_t)v; n = 5; }
+    else { tmp[0] = (uint8_t)(mt << 5 | 27); for (int i = 0; i < 8; i++) tmp[1 + i] = (uint8_t)(v >> (56 - 8 * i)); n = 9; }
+    if (w->cap - w->n < n) { w->ok = false; return; }
+    memcpy(w->p + w->n, tmp, n); w->n += n;
+}
+
+void gw_map(gw_writer_t *w, unsigned pares) { cabecera(w, MT_MAP, pares); }
+
+void gw_put_uint(gw_writer_t *w, gw_key_t k, uint32_t v) { cabecera(w, MT_UINT, k); cabecera(w, MT_UINT, v); }
+void gw_put_u64(gw_writer_t *w, gw_key_t k, uint64_t v)   { cabecera(w, MT_UINT, k); cabecera(w, MT_UINT, v); }
+
+void gw_put_int(gw_writer_t *w, gw_key_t k, int32_t v) {
+    cabecera(w, MT_UINT, k);
+    if (v >= 0) cabecera(w, MT_UINT, (uint32_t)v);
+    else        cabecera(w, MT_NEG, (uint32_t)(-1 - (int64_t)v));
+}
+
+void gw_put_bool(gw_writer_t *w, gw_key_t k, bool v) { cabecera(w, MT_UINT, k); cabecera(w, MT_SIMPLE, v ? SIMPLE_TRUE : SIMPLE_FALSE); }
+
+void gw_put_text(gw_writer_t *w, gw_key_t k, const char *s) {
+    size_t n = s ? strlen(s) : 0;
+    cabecera(w, MT_UINT, k); cabecera(w, MT_TEXT, (uint32_t)n);
+    if (!w->ok) return;
+    if (w->cap - w->n < n) { w->ok = false; return; }
+    memcpy(w->p + w->n, s, n); w->n += n;
+}
+
+// ------------------------------- LECTURA -------------------------------------
+typedef struct { const uint8_t *p, *end; } rd_t;
+
+/** @brief Lee la cabecera de un ítem: tipo mayor y argumento (sin longitudes indefinidas). */
+static bool leer_cab(rd_t *r, uint8_t *mt, uint64_t *arg) {
+    if (r->p >= r->end) return false;
+    uint8_t b = *r->p++;
+    *mt = b >> 5;
+    uint8_t ai = b & 0x1F;
+    if (ai < 24) { *arg = ai; return true; }
+    size_t n = ai == 24 ? 1 : ai == 25 ? 2 : ai == 26 ? 4 : ai == 27 ? 8 : 0;
+    if (!n || (size_t)(r->end - r->p) < n) return false;
+    uint64_t v = 0;
+    while (n--) v = v << 8 | *r->p++;
+    *arg = v;
+    return true;
+}
+
+static bool saltar(rd_t *r, int prof) {
+    uint8_t mt; uint64_t arg;
+    if (prof > 4 || !leer_cab(r, &mt, &arg)) return false;
+    switch (mt) {
+        case MT_BYTES: case MT_TEXT:
+            if ((uint64_t)(r->end - r->p) < arg) return false;
+            r->p += arg; return true;
+        case MT_ARRAY:
+            for (uint64_t i = 0; i < arg; i++) if (!saltar(r, prof + 1)) return false;
+            return true;
+        case MT_MAP:
+            for (uint64_t i = 0; i < 2 * arg; i++) if (!saltar(r, prof + 1)) return false;
+            return true;
+        case MT_TAG: return saltar(r, prof + 1);
+        default:     return true;   // enteros y simples ya consumidos por la cabecera
+    }
+}
+
+bool gw_parse(const uint8_t *data, size_t len, void (*cb)(void *ctx, uint32_t clave, const gw_val_t *v), void *ctx) {
+    rd_t r = { data, data + len };
+    uint8_t mt; uint64_t pares;
+    if (!data || !leer_cab(&r, &mt, &pares) || mt != MT_MAP) return false;
+    for (uint64_t i = 0; i < pares; i++) {
+        uint64_t clave;
+        const uint8_t *ini = r.p;
+        if (!leer_cab(&r, &mt, &clave)) return false;
+        if (mt != MT_UINT || clave > UINT32_MAX) { r.p = ini; if (!saltar(&r, 0) || !saltar(&r, 0)) return false; continue; }
+
+        gw_val_t v = { .tipo = GW_T_OTRO };
+        const uint8_t *vini = r.p;
+        uint64_t arg;
+        if (!leer_cab(&r, &mt, &arg)) return false;
+        if (mt == MT_UINT && arg <= INT64_MAX)      { v.tipo = GW_T_UINT; v.i = (int64_t)arg; }
+        else if (mt == MT_NEG && arg < INT64_MAX)   { v.tipo = GW_T_NEG;  v.i = -1 - (int64_t)arg; }
+        else if (mt == MT_SIMPLE && (arg == SIMPLE_FALSE || arg == SIMPLE_TRUE)) { v.tipo = GW_T_BOOL; v.i = arg == SIMPLE_TRUE; }
+        else if (mt == MT_TEXT) {
+            if ((uint64_t)(r.end - r.p) < arg) return false;
+            v.tipo = GW_T_TEXT; v.s = (const char *)r.p; v.n = (size_t)arg; r.p += arg;
+        } else { r.p = vini; if (!saltar(&r, 0)) return false; }
+        cb(ctx, (uint32_t)clave, &v);
+    }
+    return true;
+}
@@ -0,0 +1,67 @@
+/**
+ * @file gate_wire.h
+ * @brief Formato binario compacto (subconjunto de CBOR, RFC 8949) para estado y comandos.
+ *
+ * Un mensaje es un mapa CBOR de claves enteras fijas; los enteros chicos ocupan un byte, así
+ * que el estado completo del portón cabe en ~13 bytes frente a ~100 del JSON. Se publica en el
+ * subtópico "<tópico>/cbor", de modo que los consumidores JSON del tópico base no cambian.
+ *
+ * Solo se manejan: enteros con y sin signo, booleanos, textos y mapas (longitud definida).
+ * Sin heap; sin dependencias de ESP-IDF (se compila también en el host).
+ */
+#pragma once
+
+#include <stdint.h>
+#include <stdbool.h>
+#include <stddef.h>
+
+// Claves fijas (no renumerar: son parte del protocolo)
+typedef enum {
+    GW_K_STATE      = 0,   // uint (código de estado del firmware) o texto
+    GW_K_LSA        = 1,   // bool
+    GW_K_LSC        = 2,   // bool
+    GW_K_MOTOR_OPEN = 3,   // bool
+    GW_K_MOTOR_CLOSE= 4,   // bool
+    GW_K_ERR        = 5,   // int
+    GW_K_CMD        = 6,   // uint (código de comando del firmware)
+    GW_K_GATE       = 7,   // uint, índice de portón
+    GW_K_INFO       = 8,   // texto libre
+    GW_K_ID         = 9,   // uint32, id del comando que puso el emisor
+    GW_K_TS         = 10,  // uint64, marca de tiempo del emisor (se devuelve tal cual)
+    GW_K_RX_ACT     = 11,  // uint, µs de recepción a actuación del motor
+    GW_K_RX_SETTLE  = 12,  // uint, µs de recepción a estado de reposo
+} gw_key_t;
+
+#define GW_SUBTOPIC  "cbor"
+
+// ------------------------------ ESCRITURA ------------------------------------
+typedef struct { uint8_t *p; size_t cap, n; bool ok; } gw_writer_t;
+
+static inline void gw_writer_init(gw_writer_t *w, uint8_t *buf, size_t cap) { w->p = buf; w->cap = cap; w->n = 0; w->ok = buf && cap; }
+
+void gw_map(gw_writer_t *w, unsigned pares);
+void gw_put_uint(gw_writer_t *w, gw_key_t k, uint32_t v);
+void gw_put_u64(gw_writer_t *w, gw_key_t k, uint64_t v);
+void gw_put_int(gw_writer_t *w, gw_key_t k, int32_t v);
+void gw_put_bool(gw_writer_t *w, gw_key_t k, bool v);
+void gw_put_text(gw_writer_t *w, gw_key_t k, const char *s);
+
+/** @brief Bytes escritos, o 0 si en algún momento no alcanzó el buffer. */
+static inline size_t gw_writer_len(const gw_writer_t *w) { return w->ok ? w->n : 0; }
+
+// ------------------------------- LECTURA -------------------------------------
+typedef enum { GW_T_UINT, GW_T_NEG, GW_T_BOOL, GW_T_TEXT, GW_T_OTRO } gw_tipo_t;
+
+typedef struct {
+    gw_tipo_t   tipo;
+    int64_t     i;        // GW_T_UINT / GW_T_NEG / GW_T_BOOL (0/1)
+    const char *s;        // GW_T_TEXT: sin '\0'
+    size_t      n;
+} gw_val_t;
+
+/**
+ * @brief Recorre un mapa de nivel superior y llama a `cb` por cada clave entera.
+ *        Los valores anidados o de tipos no soportados se saltan (tipo GW_T_OTRO).
+ * @return false si el mensaje está truncado o no es un mapa.
+ */
+bool gw_parse(const uint8_t *data, size_t len, void (*cb)(void *ctx, uint32_t clave, const gw_val_t *v), void *ctx);
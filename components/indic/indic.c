@@ -0,0 +1,124 @@
+/**
+ * @file indic.c
+ * @brief Asignación de canales/timers LEDC y traducción de patrones a duty/hpoint.
+ */
+
+#include "indic.h"
+
+#include "freertos/FreeRTOS.h"
+#include "freertos/semphr.h"
+#include "driver/ledc.h"
+#include "esp_log.h"
+
+#if !SOC_LEDC_SUPPORT_REF_TICK
+#error "indic usa el reloj REF_TICK de LEDC (ESP32 / ESP32-S2)"
+#endif
+
+static const char *TAG = "INDIC";
+
+#define MODO      LEDC_LOW_SPEED_MODE
+#define RES_BITS  14
+#define MAX_DUTY  (1u << RES_BITS)
+#define N_TIMERS  LEDC_TIMER_MAX
+#define N_CANALES SOC_LEDC_CHANNEL_NUM
+#define SIN_TIMER -1
+
+typedef struct { uint16_t periodo_ms; uint8_t usos; bool pausado; } indic_timer_t;
+
+static indic_timer_t s_tim[N_TIMERS];
+static int8_t   s_tim_de[N_CANALES];   // timer de cada canal o SIN_TIMER
+static int      s_canales = 0;
+static SemaphoreHandle_t s_mtx = NULL;
+static StaticSemaphore_t s_mtx_buf;
+
+// Divisor Q10.8 para 2^RES_BITS cuentas por periodo a 1 MHz
+static inline uint32_t divisor(uint16_t periodo_ms) { return (uint32_t)periodo_ms * 1000u * 256u / MAX_DUTY; }
+
+static void soltar_timer(int ch) {
+    int t = s_tim_de[ch];
+    if (t == SIN_TIMER) return;
+    if (s_tim[t].usos && --s_tim[t].usos == 0) {
+        s_tim[t].periodo_ms = 0;
+        if (s_tim[t].pausado) { ledc_timer_resume(MODO, t); s_tim[t].pausado = false; }
+    }
+    s_tim_de[ch] = SIN_TIMER;
+}
+
+/** @brief Timer con ese periodo (compartido) o uno libre reprogramado. */
+static int tomar_timer(uint16_t periodo_ms) {
+    int libre = SIN_TIMER;
+    for (int t = 0; t < N_TIMERS; t++) {
+        if (s_tim[t].usos && s_tim[t].periodo_ms == periodo_ms) return t;
+        if (!s_tim[t].usos && libre == SIN_TIMER) libre = t;
+    }
+    if (libre == SIN_TIMER) return SIN_TIMER;
+    if (ledc_timer_set(MODO, libre, divisor(periodo_ms), RES_BITS, LEDC_REF_TICK) != ESP_OK) return SIN_TIMER;
+    s_tim[libre].periodo_ms = periodo_ms;
+    return libre;
+}
+
+int indic_agregar(gpio_num_t pin, bool activo_bajo) {
+    if (!s_mtx) {
+        s_mtx = xSemaphoreCreateMutexStatic(&s_mtx_buf);
+        // Los cuatro timers arrancan con REF_TICK; el periodo real lo fija tomar_timer()
+        for (int t = 0; t < N_TIMERS; t++) {
+            const ledc_timer_config_t tc = { .speed_mode = MODO, .duty_resolution = RES_BITS, .timer_num = t, .freq_hz = 1, .clk_cfg = LEDC_USE_REF_TICK };
+            ESP_ERROR_CHECK(ledc_timer_config(&tc));
+        }
+    }
+    xSemaphoreTake(s_mtx, portMAX_DELAY);
+    int ch = s_canales < N_CANALES ? s_canales++ : -1;
+    xSemaphoreGive(s_mtx);
+    if (ch < 0) { ESP_LOGW(TAG, "Sin canales LEDC para GPIO %d", pin); return -1; }
+
+    s_tim_de[ch] = SIN_TIMER;
+    const ledc_channel_config_t cc = {
+        .gpio_num = pin, .speed_mode = MODO, .channel = ch, .intr_type = LEDC_INTR_DISABLE,
+        .timer_sel = LEDC_TIMER_0, .duty = 0, .hpoint = 0, .flags.output_invert = activo_bajo,
+    };
+    if (ledc_channel_config(&cc) != ESP_OK) return -1;
+    ledc_stop(MODO, ch, 0);
+    return ch;
+}
+
+esp_err_t indic_set(int ind, indic_patron_t p) {
+    if (ind < 0 || ind >= s_canales || p.duty_pct > 100 || p.fase_pct + p.duty_pct > 100) return ESP_ERR_INVALID_ARG;
+    if (p.periodo_ms && (p.periodo_ms < INDIC_PERIODO_MIN_MS || p.periodo_ms > INDIC_PERIODO_MAX_MS)) return ESP_ERR_INVALID_ARG;
+
+    esp_err_t err = ESP_OK;
+    xSemaphoreTake(s_mtx, portMAX_DELAY);
+    // Fijo (o 0 % / 100 %): sin timer, la salida queda en el nivel de reposo
+    if (!p.periodo_ms || p.duty_pct == 0 || p.duty_pct == 100) {
+        soltar_timer(ind);
+        err = ledc_stop(MODO, ind, p.duty_pct ? 1 : 0);
+        goto fin;
+    }
+    int t = s_tim_de[ind];
+    if (t == SIN_TIMER || s_tim[t].periodo_ms != p.periodo_ms) {
+        soltar_timer(ind);
+        if ((t = tomar_timer(p.periodo_ms)) == SIN_TIMER) { err = ESP_ERR_NOT_FOUND; goto fin; }
+        s_tim[t].usos++;
+        s_tim_de[ind] = (int8_t)t;
+        ledc_bind_channel_timer(MODO, ind, t);
+    }
+    uint32_t hpoint = p.fase_pct * MAX_DUTY / 100u;
+    uint32_t duty = p.duty_pct * MAX_DUTY / 100u;
+    if (hpoint + duty >= MAX_DUTY) duty = MAX_DUTY - 1 - hpoint;   // lpoint en el desborde no se alcanzaría
+    err = ledc_set_duty_with_hpoint(MODO, ind, duty, hpoint);
+    if (err == ESP_OK) err = ledc_update_duty(MODO, ind);
+    if (s_tim[t].usos == 1) ledc_timer_rst(MODO, t);
+    if (s_tim[t].pausado) { ledc_timer_resume(MODO, t); s_tim[t].pausado = false; }
+fin:
+    xSemaphoreGive(s_mtx);
+    return err;
+}
+
+esp_err_t indic_congelar(int ind) {
+    if (ind < 0 || ind >= s_canales) return ESP_ERR_INVALID_ARG;
+    xSemaphoreTake(s_mtx, portMAX_DELAY);
+    int t = s_tim_de[ind];
+    esp_err_t err = ESP_OK;
+    if (t != SIN_TIMER && !s_tim[t].pausado) { err = ledc_timer_pause(MODO, t); s_tim[t].pausado = true; }
+    xSemaphoreGive(s_mtx);
+    return err;
+}
@@ -0,0 +1,53 @@
+/**
+ * @file indic.h
+ * @brief Indicadores (LEDs, lámpara) con patrones de parpadeo generados por el periférico LEDC.
+ *
+ * Cada patrón es un PWM muy lento: periodo, porcentaje encendido y fase. El hardware conmuta el
+ * pin solo, así que no hay tareas ni timers de software por indicador y cambiar de patrón son un
+ * par de escrituras de registro. Los canales con el mismo periodo comparten un timer LEDC (hay 4),
+ * de modo que dos LEDs con INDIC_LENTO e INDIC_INVERTIDO alternan exactamente en contrafase.
+ *
+ * Usa REF_TICK (1 MHz), que se mantiene estable con DFS: periodos de INDIC_PERIODO_MIN_MS a
+ * INDIC_PERIODO_MAX_MS. En light sleep LEDC se detiene; los parpadeos deben ir con el sleep bloqueado.
+ */
+#pragma once
+
+#include <stdbool.h>
+#include <stdint.h>
+
+#include "esp_err.h"
+#include "driver/gpio.h"
+
+#define INDIC_PERIODO_MIN_MS  20
+#define INDIC_PERIODO_MAX_MS  16000
+
+/** Patrón: `periodo_ms` 0 = fijo (encendido si duty_pct > 0). fase_pct + duty_pct <= 100. */
+typedef struct {
+    uint16_t periodo_ms;
+    uint8_t  duty_pct;
+    uint8_t  fase_pct;   // retraso del encendido dentro del periodo
+} indic_patron_t;
+
+#define INDIC_APAGADO    ((indic_patron_t){ 0,    0,   0 })
+#define INDIC_FIJO       ((indic_patron_t){ 0,    100, 0 })
+#define INDIC_LENTO      ((indic_patron_t){ 1000, 50,  0 })
+#define INDIC_RAPIDO     ((indic_patron_t){ 200,  50,  0 })
+#define INDIC_INVERTIDO  ((indic_patron_t){ 1000, 50,  50 })   // contrafase de INDIC_LENTO
+#define INDIC_DESTELLO   ((indic_patron_t){ 2000, 5,   0 })    // latido corto
+
+/**
+ * @brief Asigna un canal LEDC al pin y lo deja apagado.
+ * @param activo_bajo  El indicador enciende con nivel 0 (se invierte la salida en el GPIO).
+ * @return índice de indicador (>= 0) o -1 si no quedan canales.
+ */
+int indic_agregar(gpio_num_t pin, bool activo_bajo);
+
+/**
+ * @brief Cambia el patrón. Si el indicador es el único en su timer, el periodo arranca de cero
+ *        (el encendido del patrón se ve enseguida). Seguro entre tareas; no desde ISR.
+ * @return ESP_ERR_INVALID_ARG con un patrón fuera de rango, ESP_ERR_NOT_FOUND sin timers libres.
+ */
+esp_err_t indic_set(int ind, indic_patron_t p);
+
+/** @brief Congela la salida donde esté (pausa su timer: afecta a los que comparten periodo). Se reanuda con indic_set. */
+esp_err_t indic_congelar(int ind);
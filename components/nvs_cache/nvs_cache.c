@@ -0,0 +1,304 @@
+/**
+ * @file nvs_cache.c
+ * @brief Caché RAM con banderas de sucio sobre un handle NVS permanente.
+ */
+
+#include "nvs_cache.h"
+
+#include <string.h>
+
+#include "freertos/FreeRTOS.h"
+#include "freertos/semphr.h"
+#include "freertos/task.h"
+#include "nvs.h"
+#include "esp_timer.h"
+#include "esp_system.h"
+#include "esp_log.h"
+
+static const char *TAG = "NVS_CACHE";
+
+// LIMPIA = igual que en flash; AUSENTE = no existe en flash; BORRAR = borrar en el próximo commit
+typedef enum { E_LIBRE = 0, E_LIMPIA, E_SUCIA, E_AUSENTE, E_BORRAR } est_t;
+
+typedef struct {
+    char     key[NVS_KEY_NAME_MAX_SIZE];
+    uint8_t  tipo;                          // nvs_type_t
+    uint8_t  est;                           // est_t
+    uint16_t len;                           // strings: con '\0'; blobs: bytes
+    union { uint8_t u8; int32_t i32; uint32_t u32; uint8_t b[NVS_CACHE_VAL_MAX]; } v;
+} entrada_t;
+
+static entrada_t          s_e[NVS_CACHE_MAX_KEYS];
+static nvs_handle_t       s_h;
+static bool               s_abierto;
+static SemaphoreHandle_t  s_mtx;
+static StaticSemaphore_t  s_mtx_buf;
+static esp_timer_handle_t s_t_commit;
+static TaskHandle_t       s_task;
+static StaticTask_t       s_task_tcb;
+static StackType_t        s_task_pila[NVS_CACHE_STACK];
+static uint32_t           s_commit_ms;
+static bool               s_armado;
+static nvs_cache_stats_t  s_st;
+
+#define LOCK()   xSemaphoreTake(s_mtx, portMAX_DELAY)
+#define UNLOCK() xSemaphoreGive(s_mtx)
+
+// --------------------------------- CACHÉ -------------------------------------
+/** @brief Busca la clave; con `crear`, reserva una entrada libre (queda en E_LIBRE con la clave puesta). */
+static entrada_t *buscar(const char *key, bool crear) {
+    entrada_t *libre = NULL;
+    for (int i = 0; i < NVS_CACHE_MAX_KEYS; i++) {
+        entrada_t *e = &s_e[i];
+        if (e->est == E_LIBRE) { if (!libre) libre = e; continue; }
+        if (!strcmp(e->key, key)) return e;
+    }
+    if (!crear || !libre) return NULL;
+    strcpy(libre->key, key);   // longitud ya validada por el llamador
+    return libre;
+}
+
+/** @brief Trae la clave de flash a la entrada recién reservada. */
+static esp_err_t cargar(entrada_t *e, uint8_t tipo) {
+    size_t len = sizeof(e->v.b);
+    esp_err_t err;
+    e->tipo = tipo;
+    switch (tipo) {
+        case NVS_TYPE_U8:   err = nvs_get_u8(s_h, e->key, &e->v.u8);   len = 1; break;
+        case NVS_TYPE_I32:  err = nvs_get_i32(s_h, e->key, &e->v.i32); len = 4; break;
+        case NVS_TYPE_U32:  err = nvs_get_u32(s_h, e->key, &e->v.u32); len = 4; break;
+        case NVS_TYPE_STR:  err = nvs_get_str(s_h, e->key, (char *)e->v.b, &len); break;
+        case NVS_TYPE_BLOB: err = nvs_get_blob(s_h, e->key, e->v.b, &len); break;
+        default:            return ESP_ERR_INVALID_ARG;
+    }
+    if (err == ESP_ERR_NVS_NOT_FOUND || err == ESP_ERR_NVS_TYPE_MISMATCH) { e->est = E_AUSENTE; e->len = 0; return ESP_OK; }
+    if (err != ESP_OK) { e->est = E_LIBRE; return err; }   // p.ej. más grande que NVS_CACHE_VAL_MAX
+    e->est = E_LIMPIA; e->len = (uint16_t)len;
+    return ESP_OK;
+}
+
+/** @brief Entrada válida de `tipo` para leer o escribir; la carga de flash si hace falta. */
+static esp_err_t entrada(const char *key, uint8_t tipo, entrada_t **pe) {
+    if (!s_abierto) return ESP_ERR_INVALID_STATE;
+    if (!key || strlen(key) >= NVS_KEY_NAME_MAX_SIZE) return ESP_ERR_INVALID_ARG;
+    entrada_t *e = buscar(key, true);
+    if (!e) { ESP_LOGW(TAG, "Cache llena (%d claves), '%s' va directo a NVS", NVS_CACHE_MAX_KEYS, key); return ESP_ERR_NO_MEM; }
+    if (e->est == E_LIBRE) {
+        esp_err_t err = cargar(e, tipo);
+        if (err != ESP_OK) return err;
+    }
+    *pe = e;
+    return ESP_OK;
+}
+
+// NVS: una entrada de 32 B por primitivo; strings y blobs, cabecera + datos en bloques de 32 B
+static inline uint32_t entradas_de(const entrada_t *e) {
+    switch (e->tipo) {
+        case NVS_TYPE_STR:  return 1 + (e->len + 31u) / 32u;
+        case NVS_TYPE_BLOB: return 2 + (e->len + 31u) / 32u;   // índice + cabecera del trozo
+        default:            return 1;
+    }
+}
+
+// -------------------------------- DIRECTO ------------------------------------
+// Caché llena: la clave se lee y escribe en NVS sin pasar por ella. Con el mutex tomado.
+static esp_err_t leer_directo(const char *key, uint8_t tipo, void *out, size_t *len) {
+    s_st.directos++;
+    switch (tipo) {
+        case NVS_TYPE_U8:   return nvs_get_u8(s_h, key, out);
+        case NVS_TYPE_I32:  return nvs_get_i32(s_h, key, out);
+        case NVS_TYPE_U32:  return nvs_get_u32(s_h, key, out);
+        case NVS_TYPE_STR:  return nvs_get_str(s_h, key, out, len);
+        case NVS_TYPE_BLOB: return nvs_get_blob(s_h, key, out, len);
+        default:            return ESP_ERR_INVALID_ARG;
+    }
+}
+
+static esp_err_t escribir_directo(const char *key, uint8_t tipo, const void *v, size_t len) {
+    esp_err_t err;
+    s_st.directos++;
+    switch (tipo) {
+        case NVS_TYPE_U8:   err = nvs_set_u8(s_h, key, *(const uint8_t *)v);   break;
+        case NVS_TYPE_I32:  err = nvs_set_i32(s_h, key, *(const int32_t *)v);  break;
+        case NVS_TYPE_U32:  err = nvs_set_u32(s_h, key, *(const uint32_t *)v); break;
+        case NVS_TYPE_STR:  err = nvs_set_str(s_h, key, (const char *)v);      break;
+        case NVS_TYPE_BLOB: err = nvs_set_blob(s_h, key, v, len);              break;
+        case NVS_TYPE_ANY:  err = nvs_erase_key(s_h, key); if (err == ESP_ERR_NVS_NOT_FOUND) return ESP_OK; break;
+        default:            return ESP_ERR_INVALID_ARG;
+    }
+    if (err == ESP_OK) err = nvs_commit(s_h);
+    s_st.commits++;
+    if (err != ESP_OK) { s_st.errores++; ESP_LOGE(TAG, "'%s' (directo): %s", key, esp_err_to_name(err)); return err; }
+    entrada_t tmp = { .tipo = tipo, .len = (uint16_t)len };
+    s_st.entradas += tipo == NVS_TYPE_ANY ? 1 : entradas_de(&tmp);
+    s_st.bytes = (uint64_t)s_st.entradas * 32u;
+    return ESP_OK;
+}
+
+// --------------------------------- COMMIT ------------------------------------
+/** @brief Escribe las entradas sucias y hace un único commit. Con el mutex tomado. */
+static esp_err_t volcar(void) {
+    if (s_armado) { esp_timer_stop(s_t_commit); s_armado = false; }
+    esp_err_t res = ESP_OK;
+    int n = 0;
+    for (int i = 0; i < NVS_CACHE_MAX_KEYS; i++) {
+        entrada_t *e = &s_e[i];
+        esp_err_t err = ESP_OK;
+        if (e->est == E_SUCIA) {
+            switch (e->tipo) {
+                case NVS_TYPE_U8:   err = nvs_set_u8(s_h, e->key, e->v.u8);   break;
+                case NVS_TYPE_I32:  err = nvs_set_i32(s_h, e->key, e->v.i32); break;
+                case NVS_TYPE_U32:  err = nvs_set_u32(s_h, e->key, e->v.u32); break;
+                case NVS_TYPE_STR:  err = nvs_set_str(s_h, e->key, (const char *)e->v.b); break;
+                case NVS_TYPE_BLOB: err = nvs_set_blob(s_h, e->key, e->v.b, e->len); break;
+            }
+            if (err == ESP_OK) { e->est = E_LIMPIA; s_st.entradas += entradas_de(e); }
+        } else if (e->est == E_BORRAR) {
+            err = nvs_erase_key(s_h, e->key);
+            if (err == ESP_ERR_NVS_NOT_FOUND) err = ESP_OK;
+            if (err == ESP_OK) e->est = E_AUSENTE;
+        } else {
+            continue;
+        }
+        n++;
+        if (err != ESP_OK) { s_st.errores++; res = err; ESP_LOGE(TAG, "'%s': %s", e->key, esp_err_to_name(err)); }
+    }
+    if (!n) return res;
+    esp_err_t err = nvs_commit(s_h);
+    s_st.commits++;
+    if (err != ESP_OK) { s_st.errores++; return err; }
+    s_st.bytes = (uint64_t)s_st.entradas * 32u;
+    return res;
+}
+
+static void armar_commit(void) {
+    if (s_commit_ms && !s_armado) { esp_timer_start_once(s_t_commit, (uint64_t)s_commit_ms * 1000ULL); s_armado = true; }
+}
+
+// El callback corre en la tarea esp_timer: solo avisa; la escritura la hace commit_task
+static void on_commit(void *arg) { xTaskNotifyGive(s_task); }
+
+static void commit_task(void *arg) {
+    while (1) {
+        ulTaskNotifyTake(pdTRUE, portMAX_DELAY);
+        LOCK(); s_armado = false; volcar(); UNLOCK();
+    }
+}
+
+static void on_shutdown(void) {
+    if (!s_abierto || xSemaphoreTake(s_mtx, pdMS_TO_TICKS(100)) != pdTRUE) return;
+    volcar();
+    UNLOCK();
+}
+
+// ---------------------------------- API --------------------------------------
+esp_err_t nvs_cache_init(const char *ns, uint32_t commit_ms) {
+    if (s_abierto) return ESP_OK;
+    if (!s_mtx) s_mtx = xSemaphoreCreateMutexStatic(&s_mtx_buf);
+
+    const esp_timer_create_args_t ta = { .callback = on_commit, .name = "nvs_commit" };
+    esp_err_t err = esp_timer_create(&ta, &s_t_commit);
+    if (err != ESP_OK) return err;
+    if ((err = nvs_open(ns, NVS_READWRITE, &s_h)) != ESP_OK) { esp_timer_delete(s_t_commit); return err; }
+    if (!s_task) s_task = xTaskCreateStatic(commit_task, "nvs_commit", NVS_CACHE_STACK, NULL, NVS_CACHE_PRIO, s_task_pila, &s_task_tcb);
+
+    s_commit_ms = commit_ms;
+    s_abierto = true;
+    esp_register_shutdown_handler(on_shutdown);
+
+    s_st.brownout = esp_reset_reason() == ESP_RST_BROWNOUT;
+    if (s_st.brownout) ESP_LOGW(TAG, "Reinicio por brownout: los cambios de los ultimos %lu ms pudieron perderse", (unsigned long)commit_ms);
+    ESP_LOGI(TAG, "NVS '%s' abierto, commit cada %lu ms", ns, (unsigned long)commit_ms);
+    return ESP_OK;
+}
+
+static esp_err_t leer(const char *key, uint8_t tipo, void *out, size_t *len) {
+    if (!s_mtx) return ESP_ERR_INVALID_STATE;
+    LOCK();
+    entrada_t *e;
+    esp_err_t err = entrada(key, tipo, &e);
+    if (err == ESP_ERR_NO_MEM) err = leer_directo(key, tipo, out, len);
+    else if (err == ESP_OK) {
+        if (e->est == E_AUSENTE || e->est == E_BORRAR) err = ESP_ERR_NVS_NOT_FOUND;
+        else if (e->tipo != tipo)                     err = ESP_ERR_NVS_TYPE_MISMATCH;
+        else if (!len)                                memcpy(out, &e->v, tipo == NVS_TYPE_U8 ? 1 : 4);
+        else if (*len < e->len)                       { *len = e->len; err = ESP_ERR_NVS_INVALID_LENGTH; }
+        else                                          { memcpy(out, e->v.b, e->len); *len = e->len; }
+    }
+    UNLOCK();
+    return err;
+}
+
+static esp_err_t escribir(const char *key, uint8_t tipo, const void *v, size_t len) {
+    if (len > NVS_CACHE_VAL_MAX) return ESP_ERR_NVS_INVALID_LENGTH;
+    if (!s_mtx) return ESP_ERR_INVALID_STATE;
+    LOCK();
+    entrada_t *e;
+    esp_err_t err = entrada(key, tipo, &e);
+    if (err == ESP_ERR_NO_MEM) { s_st.sets++; err = escribir_directo(key, tipo, v, len); }
+    else if (err == ESP_OK) {
+        s_st.sets++;
+        if ((e->est == E_LIMPIA || e->est == E_SUCIA) && e->tipo == tipo && e->len == len && !memcmp(&e->v, v, len)) {
+            s_st.sin_cambio++;
+        } else {
+            e->tipo = tipo; e->len = (uint16_t)len;
+            memcpy(&e->v, v, len);
+            e->est = E_SUCIA;
+            armar_commit();
+        }
+    }
+    UNLOCK();
+    return err;
+}
+
+esp_err_t nvs_cache_get_u8(const char *key, uint8_t *out)              { return leer(key, NVS_TYPE_U8, out, NULL); }
+esp_err_t nvs_cache_get_i32(const char *key, int32_t *out)             { return leer(key, NVS_TYPE_I32, out, NULL); }
+esp_err_t nvs_cache_get_u32(const char *key, uint32_t *out)            { return leer(key, NVS_TYPE_U32, out, NULL); }
+esp_err_t nvs_cache_get_str(const char *key, char *out, size_t *len)   { return leer(key, NVS_TYPE_STR, out, len); }
+esp_err_t nvs_cache_get_blob(const char *key, void *out, size_t *len)  { return leer(key, NVS_TYPE_BLOB, out, len); }
+
+esp_err_t nvs_cache_set_u8(const char *key, uint8_t v)                 { return escribir(key, NVS_TYPE_U8, &v, 1); }
+esp_err_t nvs_cache_set_i32(const char *key, int32_t v)                { return escribir(key, NVS_TYPE_I32, &v, 4); }
+esp_err_t nvs_cache_set_u32(const char *key, uint32_t v)               { return escribir(key, NVS_TYPE_U32, &v, 4); }
+esp_err_t nvs_cache_set_str(const char *key, const char *v)            { return escribir(key, NVS_TYPE_STR, v, strlen(v) + 1); }
+esp_err_t nvs_cache_set_blob(const char *key, const void *v, size_t n) { return escribir(key, NVS_TYPE_BLOB, v, n); }
+
+esp_err_t nvs_cache_erase(const char *key) {
+    if (!s_abierto) return ESP_ERR_INVALID_STATE;
+    if (!key || strlen(key) >= NVS_KEY_NAME_MAX_SIZE) return ESP_ERR_INVALID_ARG;
+    LOCK();
+    esp_err_t err = ESP_OK;
+    s_st.sets++;
+    entrada_t *e = buscar(key, true);
+    if (!e)                        err = escribir_directo(key, NVS_TYPE_ANY, NULL, 0);
+    else if (e->est == E_AUSENTE || e->est == E_BORRAR) s_st.sin_cambio++;
+    else                           { e->est = E_BORRAR; e->tipo = NVS_TYPE_ANY; e->len = 0; armar_commit(); }
+    UNLOCK();
+    return err;
+}
+
+esp_err_t nvs_cache_flush(void) {
+    if (!s_abierto) return ESP_ERR_INVALID_STATE;
+    LOCK();
+    esp_err_t err = volcar();
+    UNLOCK();
+    return err;
+}
+
+void nvs_cache_get_stats(nvs_cache_stats_t *st) {
+    if (s_mtx) LOCK();
+    *st = s_st;
+    st->sucias = 0;
+    for (int i = 0; i < NVS_CACHE_MAX_KEYS; i++) if (s_e[i].est == E_SUCIA || s_e[i].est == E_BORRAR) st->sucias++;
+    if (s_mtx) UNLOCK();
+
+    // Cada entrada escrita gasta un hueco; al llenarse la partición se borra y reescribe cada página
+    st->vida_dias = 0;
+    nvs_stats_t ns;
+    int64_t up_s = esp_timer_get_time() / 1000000;
+    if (st->entradas && up_s > 0 && nvs_get_stats(NULL, &ns) == ESP_OK) {
+        uint64_t por_dia = (uint64_t)st->entradas * 86400u / (uint64_t)up_s;
+        uint64_t dias = por_dia ? (uint64_t)ns.total_entries * NVS_CACHE_CICLOS_FLASH / por_dia : UINT32_MAX;
+        st->vida_dias = dias > UINT32_MAX ? UINT32_MAX : (uint32_t)dias;
+    }
+}
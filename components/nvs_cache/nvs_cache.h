@@ -0,0 +1,74 @@
+/**
+ * @file nvs_cache.h
+ * @brief Capa de persistencia compartida: un handle NVS abierto, valores en RAM y commits agrupados.
+ *
+ * Los set_* solo tocan la caché y marcan la clave como sucia (si el valor no cambió no se
+ * escribe nada). Las claves sucias se escriben juntas, con un único nvs_commit(), cuando vence
+ * el intervalo `commit_ms` desde el primer cambio pendiente, al llamar a nvs_cache_flush() o en
+ * esp_restart(). Se cuentan commits y entradas escritas para estimar la vida de la flash.
+ * El commit por intervalo no corre en la tarea esp_timer (borrar/escribir flash lleva decenas de
+ * ms y ahí viven el antirrebote y stimer): el timer solo despierta a la tarea "nvs_commit".
+ *
+ * Si la caché se llena, la clave que no entra va directo a NVS (nvs_set_* + nvs_commit en la misma
+ * llamada, y las lecturas de flash): pierde el agrupado pero no se deja de guardar. Se cuenta en
+ * `directos`; la aplicación dimensiona NVS_CACHE_MAX_KEYS con su conjunto de claves.
+ *
+ * Un único espacio de nombres por aplicación. Las funciones son seguras entre tareas.
+ */
+#pragma once
+
+#include <stdint.h>
+#include <stddef.h>
+#include <stdbool.h>
+
+#include "esp_err.h"
+
+#ifndef NVS_CACHE_MAX_KEYS
+#define NVS_CACHE_MAX_KEYS  24    // claves distintas que caben en la caché (las entradas no se liberan)
+#endif
+#ifndef NVS_CACHE_VAL_MAX
+#define NVS_CACHE_VAL_MAX   128   // tamaño máximo de un string (con '\0') o blob
+#endif
+#ifndef NVS_CACHE_PRIO
+#define NVS_CACHE_PRIO      1     // tarea "nvs_commit": por debajo de todo lo demás
+#endif
+#define NVS_CACHE_STACK     3072
+#define NVS_CACHE_CICLOS_FLASH  100000u   // ciclos de borrado garantizados por sector
+
+typedef struct {
+    uint32_t sets;          // llamadas a set_* / erase
+    uint32_t sin_cambio;    // set_* con el mismo valor que ya había (no ensucian)
+    uint32_t commits;       // nvs_commit() realizados
+    uint32_t entradas;      // entradas NVS de 32 B escritas
+    uint64_t bytes;         // = entradas * 32 (lo que realmente consume la flash)
+    uint32_t errores;
+    uint32_t directos;      // operaciones que fueron directo a NVS por caché llena
+    uint32_t sucias;        // claves pendientes de escribir ahora mismo
+    uint32_t vida_dias;     // vida estimada de la partición al ritmo actual (0 = sin escrituras)
+    bool     brownout;      // el último reinicio fue por caída de tensión (pudo perderse lo pendiente)
+} nvs_cache_stats_t;
+
+/**
+ * @brief Abre `ns` (NVS ya inicializado con nvs_flash_init), crea la tarea de commit y registra el flush de apagado.
+ * @param commit_ms  Máximo tiempo que un cambio espera en RAM; 0 = solo con flush/reinicio.
+ */
+esp_err_t nvs_cache_init(const char *ns, uint32_t commit_ms);
+
+esp_err_t nvs_cache_get_u8(const char *key, uint8_t *out);
+esp_err_t nvs_cache_get_i32(const char *key, int32_t *out);
+esp_err_t nvs_cache_get_u32(const char *key, uint32_t *out);
+/** @brief Igual que nvs_get_str(): `*len` entra con la capacidad y sale con la longitud + 1. */
+esp_err_t nvs_cache_get_str(const char *key, char *out, size_t *len);
+esp_err_t nvs_cache_get_blob(const char *key, void *out, size_t *len);
+
+esp_err_t nvs_cache_set_u8(const char *key, uint8_t v);
+esp_err_t nvs_cache_set_i32(const char *key, int32_t v);
+esp_err_t nvs_cache_set_u32(const char *key, uint32_t v);
+esp_err_t nvs_cache_set_str(const char *key, const char *v);
+esp_err_t nvs_cache_set_blob(const char *key, const void *v, size_t len);
+esp_err_t nvs_cache_erase(const char *key);
+
+/** @brief Escribe ya todas las claves sucias con un solo commit. */
+esp_err_t nvs_cache_flush(void);
+
+void nvs_cache_get_stats(nvs_cache_stats_t *st);
@@ -0,0 +1,196 @@
+/**
+ * @file stimer.c
+ * @brief Rueda clásica con cascada: el nivel n guarda plazos a menos de 64^(n+1) ticks y baja sus
+ *        ranuras al nivel inferior cuando el índice de éste da la vuelta.
+ */
+
+#include "stimer.h"
+
+#include "freertos/FreeRTOS.h"
+#include "esp_timer.h"
+#include "esp_log.h"
+
+static const char *TAG = "STIMER";
+
+#define NIVELES   4
+#define BITS      6
+#define RANURAS   (1u << BITS)
+#define MASK      (RANURAS - 1)
+#define TICK_US   ((int64_t)STIMER_TICK_MS * 1000)
+#define MAX_TICKS ((1u << (BITS * NIVELES)) - 1)
+
+static stimer_t  *s_r[NIVELES][RANURAS];
+static uint64_t   s_ocup[NIVELES];        // ranuras no vacías
+static uint32_t   s_ahora;                // próximo tick a procesar
+static uint32_t   s_prox;                 // tick para el que está programado el esp_timer
+static bool       s_programado, s_en_curso;
+static esp_timer_handle_t s_et = NULL;
+static portMUX_TYPE s_mux = portMUX_INITIALIZER_UNLOCKED;
+static stimer_stats_t s_st;
+
+static inline uint32_t tick_ahora(void) { return (uint32_t)(esp_timer_get_time() / TICK_US); }
+static inline uint64_t rotr(uint64_t m, unsigned i) { i &= 63; return i ? (m >> i) | (m << (64 - i)) : m; }
+
+// ------------------------------ LISTAS ----------------------------------------
+static void insertar(stimer_t *t) {
+    int32_t d = (int32_t)(t->vence - s_ahora);
+    uint32_t v = t->vence;
+    if (d < 0) { d = 0; v = s_ahora; }                      // atrasado: en el próximo tick
+    if ((uint32_t)d > MAX_TICKS) { d = MAX_TICKS; v = s_ahora + MAX_TICKS; }   // se reinserta al llegar
+    unsigned n = d < (1 << BITS) ? 0 : d < (1 << 2 * BITS) ? 1 : d < (1 << 3 * BITS) ? 2 : 3;
+    unsigned r = (v >> (BITS * n)) & MASK;
+    stimer_t **h = &s_r[n][r];
+    t->sig = *h;
+    if (*h) (*h)->pant = &t->sig;
+    *h = t;
+    t->pant = h;
+    t->pos = (uint16_t)(n * RANURAS + r);
+    s_ocup[n] |= 1ULL << r;
+}
+
+static void quitar(stimer_t *t) {
+    *t->pant = t->sig;
+    if (t->sig) t->sig->pant = t->pant;
+    unsigned n = t->pos / RANURAS, r = t->pos % RANURAS;
+    if (!s_r[n][r]) s_ocup[n] &= ~(1ULL << r);
+    t->sig = NULL; t->pant = NULL;
+}
+
+static unsigned cascada(unsigned n, unsigned r) {
+    stimer_t *t = s_r[n][r];
+    s_r[n][r] = NULL;
+    s_ocup[n] &= ~(1ULL << r);
+    while (t) {
+        stimer_t *sig = t->sig;
+        insertar(t);
+        s_st.cascadas++;
+        t = sig;
+    }
+    return r;
+}
+
+/** @brief Próximo tick con trabajo: un vencimiento en el nivel 0 o una cascada de un nivel superior. */
+static bool proximo(uint32_t *tick) {
+    bool hay = false;
+    int32_t mejor = 0;
+    if (s_ocup[0]) { mejor = __builtin_ctzll(rotr(s_ocup[0], s_ahora & MASK)); hay = true; }
+    for (unsigned n = 1; n < NIVELES; n++) {
+        if (!s_ocup[n]) continue;
+        unsigned sh = BITS * n;
+        // En un borde de bloque aún sin procesar la cascada de la ranura actual es ahora mismo;
+        // si no, esa ranura recién vuelve a bajar tras una vuelta completa
+        uint32_t desde = (s_ahora >> sh) + ((s_ahora & ((1u << sh) - 1)) ? 1 : 0);
+        uint32_t dd = __builtin_ctzll(rotr(s_ocup[n], desde & MASK));
+        int32_t d = (int32_t)(((desde + dd) << sh) - s_ahora);
+        if (!hay || d < mejor) { mejor = d; hay = true; }
+    }
+    if (hay) *tick = s_ahora + (uint32_t)mejor;
+    return hay;
+}
+
+/** @brief Con el lock tomado: deja el esp_timer en el próximo tick con trabajo (o parado). */
+static void programar(void) {
+    uint32_t p;
+    if (!proximo(&p)) {
+        if (s_programado) { esp_timer_stop(s_et); s_programado = false; }
+        return;
+    }
+    if (s_programado && (int32_t)(p - s_prox) >= 0) return;   // ya despierta antes
+    int64_t us = (int64_t)p * TICK_US - esp_timer_get_time();
+    if (s_programado) esp_timer_stop(s_et);
+    esp_timer_start_once(s_et, us > 0 ? (uint64_t)us : 1);
+    s_prox = p;
+    s_programado = true;
+}
+
+// ------------------------------ MOTOR -----------------------------------------
+static void on_rueda(void *arg) {
+    portENTER_CRITICAL(&s_mux);
+    s_programado = false;
+    s_en_curso = true;
+    s_st.despertares++;
+    uint32_t hasta = tick_ahora();
+    while ((int32_t)(hasta - s_ahora) >= 0) {
+        uint32_t T = s_ahora;
+        if (!(s_ocup[0] | s_ocup[1] | s_ocup[2] | s_ocup[3])) { s_ahora = hasta + 1; break; }
+        // Sin nada en el nivel 0 solo importan los bordes de bloque (cascadas)
+        if (!s_ocup[0] && (T & MASK)) {
+            uint32_t borde = (T | MASK) + 1;
+            s_ahora = (int32_t)(borde - (hasta + 1)) < 0 ? borde : hasta + 1;
+            continue;
+        }
+        if (!(T & MASK)) {
+            for (unsigned n = 1; n < NIVELES; n++) {
+                if (cascada(n, (T >> (BITS * n)) & MASK)) break;
+            }
+        }
+        stimer_t **h = &s_r[0][T & MASK];
+        while (*h) {
+            stimer_t *t = *h;
+            quitar(t);
+            if ((int32_t)(t->vence - T) > 0) { insertar(t); continue; }   // recortado a MAX_TICKS
+            if (t->periodo) {
+                // Misma fase; si se perdieron vueltas se saltan en vez de dispararlas en ráfaga
+                t->vence += ((T - t->vence) / t->periodo + 1) * t->periodo;
+                insertar(t);
+            } else {
+                s_st.armados--;
+            }
+            stimer_cb_t cb = t->cb; void *a = t->arg;
+            s_st.disparos++;
+            portEXIT_CRITICAL(&s_mux);
+            cb(a);
+            portENTER_CRITICAL(&s_mux);
+        }
+        s_ahora = T + 1;
+    }
+    s_en_curso = false;
+    programar();
+    portEXIT_CRITICAL(&s_mux);
+}
+
+// ------------------------------ API -------------------------------------------
+esp_err_t stimer_iniciar(void) {
+    if (s_et) return ESP_OK;
+    const esp_timer_create_args_t ta = { .callback = on_rueda, .dispatch_method = ESP_TIMER_TASK, .name = "stimer" };
+    esp_err_t err = esp_timer_create(&ta, &s_et);
+    if (err != ESP_OK) { ESP_LOGE(TAG, "esp_timer_create: %s", esp_err_to_name(err)); return err; }
+    s_ahora = tick_ahora();
+    return ESP_OK;
+}
+
+void stimer_crear(stimer_t *t, stimer_cb_t cb, void *arg) {
+    *t = (stimer_t){ .cb = cb, .arg = arg };
+}
+
+void stimer_armar(stimer_t *t, uint32_t ms, uint32_t periodo_ms) {
+    if (!s_et && stimer_iniciar() != ESP_OK) return;
+    int64_t vence_us = esp_timer_get_time() + (int64_t)ms * 1000;
+    portENTER_CRITICAL(&s_mux);
+    if (t->pant) quitar(t); else s_st.armados++;
+    uint32_t ahora = tick_ahora();
+    if (s_st.armados == 1 && !s_en_curso && (int32_t)(ahora - s_ahora) > 0) s_ahora = ahora;   // rueda vacía: al día
+    t->vence = (uint32_t)((vence_us + TICK_US - 1) / TICK_US);
+    t->periodo = periodo_ms ? (periodo_ms + STIMER_TICK_MS - 1) / STIMER_TICK_MS : 0;
+    insertar(t);
+    if (!s_en_curso) programar();   // si la rueda está corriendo, programa ella al terminar
+    portEXIT_CRITICAL(&s_mux);
+}
+
+void stimer_cancelar(stimer_t *t) {
+    portENTER_CRITICAL(&s_mux);
+    if (t->pant) {
+        quitar(t);
+        s_st.armados--;
+        if (!s_st.armados && s_programado) { esp_timer_stop(s_et); s_programado = false; }
+    }
+    portEXIT_CRITICAL(&s_mux);
+}
+
+bool stimer_activo(const stimer_t *t) { return t->pant != NULL; }
+
+void stimer_get_stats(stimer_stats_t *st) {
+    portENTER_CRITICAL(&s_mux);
+    *st = s_st;
+    portEXIT_CRITICAL(&s_mux);
+}
@@ -0,0 +1,61 @@
+/**
+ * @file stimer.h
+ * @brief Rueda de timers jerárquica (4 niveles × 64 ranuras) sobre un único esp_timer.
+ *
+ * Para trabajos periódicos o de plazo largo que toleran la resolución de STIMER_TICK_MS:
+ * telemetría, reintentos, timeouts de conexión. Armar y cancelar son O(1) (listas intrusivas,
+ * sin heap). Los plazos se redondean al tick, así que los que vencen juntos se atienden en un
+ * solo despertar; el esp_timer se programa para el próximo vencimiento (o cambio de nivel) y no
+ * corre mientras no hay nada armado, de modo que no impide el light sleep.
+ *
+ * Los callbacks corren en la tarea de esp_timer, uno a la vez y sin el lock tomado: pueden armar
+ * o cancelar (incluido el propio timer) pero no deben bloquear. Lo que tarde (publicar, NVS
+ * lento) se delega por event group/notificación a la tarea dueña.
+ * Seguro entre tareas; no desde ISR.
+ */
+#pragma once
+
+#include <stdbool.h>
+#include <stdint.h>
+
+#include "esp_err.h"
+
+#define STIMER_TICK_MS    10
+#define STIMER_MAX_MS     ((uint32_t)((1u << 24) - 1) * STIMER_TICK_MS)   // ~46 h; más lejos se recorta
+
+typedef void (*stimer_cb_t)(void *arg);
+
+/** Timer de la rueda; lo aloja el usuario (estático). Campos internos. */
+typedef struct stimer {
+    struct stimer *sig, **pant;   // pant == NULL: no armado
+    uint32_t       vence;         // tick absoluto
+    uint32_t       periodo;       // ticks; 0 = una vez
+    uint16_t       pos;           // nivel * 64 + ranura
+    stimer_cb_t    cb;
+    void          *arg;
+} stimer_t;
+
+/** @brief Crea el esp_timer que mueve la rueda. Idempotente; stimer_armar() la llama si hace falta. */
+esp_err_t stimer_iniciar(void);
+
+void stimer_crear(stimer_t *t, stimer_cb_t cb, void *arg);
+
+/**
+ * @brief (Re)arma: vence dentro de `ms` (redondeado hacia arriba al tick) y, si `periodo_ms` > 0,
+ *        se repite con ese periodo manteniendo la fase (los atrasos no acumulan deriva).
+ */
+void stimer_armar(stimer_t *t, uint32_t ms, uint32_t periodo_ms);
+
+static inline void stimer_periodico(stimer_t *t, uint32_t periodo_ms) { stimer_armar(t, periodo_ms, periodo_ms); }
+
+void stimer_cancelar(stimer_t *t);
+bool stimer_activo(const stimer_t *t);
+
+typedef struct {
+    uint32_t armados;      // timers en la rueda ahora
+    uint32_t despertares;  // veces que corrió el esp_timer
+    uint32_t disparos;     // callbacks ejecutados
+    uint32_t cascadas;     // timers bajados de nivel
+} stimer_stats_t;
+
+void stimer_get_stats(stimer_stats_t *st);
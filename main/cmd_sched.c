@@ -0,0 +1,140 @@
+/**
+ * @file cmd_sched.c
+ * @brief Carril prioritario de STOP, fusión de redundantes y contadores para q_cmd.
+ */
+
+#include "cmd_sched.h"
+
+#include <stdatomic.h>
+
+#include "freertos/queue.h"
+#include "alog.h"
+
+static const char *TAG = "SCHED";
+
+static QueueHandle_t      q_cmd;
+static StaticQueue_t      s_q_cmd_ctl;                                // q_cmd sin heap
+static uint8_t            s_q_cmd_buf[CMD_SCHED_DEPTH * sizeof(gate_msg_t)];
+static EventGroupHandle_t s_ev;
+static EventBits_t        s_bit;
+
+static _Atomic uint32_t s_stop_mask;                                  // un bit por portón
+static _Atomic uint32_t s_emerg_mask;                                 // el STOP pendiente es CMD_EMERGENCY
+static _Atomic uint32_t s_stop_epoch[CMD_SCHED_MAX_GATES];
+static int64_t          s_stop_t_rx[CMD_SCHED_MAX_GATES];            // recepción del último STOP
+static gate_ref_t       s_stop_ref[CMD_SCHED_MAX_GATES];             // y su referencia
+static portMUX_TYPE     s_stop_mux = portMUX_INITIALIZER_UNLOCKED;   // t_rx + ref + bits: varios productores
+static _Atomic uint32_t s_lamp[CMD_SCHED_MAX_GATES];                  // último LAMP_* pedido o CMD_NONE
+static _Atomic uint32_t s_pend[CMD_SCHED_MAX_GATES][CMD_TOGGLE + 1];  // movimientos en cola por tipo
+static _Atomic uint32_t s_pend_epoch[CMD_SCHED_MAX_GATES][CMD_TOGGLE + 1];  // época del último encolado
+static _Atomic uint32_t s_ultimo[CMD_SCHED_MAX_GATES];                // último comando pedido (cualquiera)
+
+static _Atomic uint32_t s_recibidos, s_entregados, s_coalescidos, s_llena, s_anulados, s_stop_prio, s_prof_max;
+
+static inline void cnt(_Atomic uint32_t *c) { atomic_fetch_add_explicit(c, 1, memory_order_relaxed); }
+
+esp_err_t cmd_sched_init(EventGroupHandle_t ev, EventBits_t bit) {
+    q_cmd = xQueueCreateStatic(CMD_SCHED_DEPTH, sizeof(gate_msg_t), s_q_cmd_buf, &s_q_cmd_ctl);
+    if (!q_cmd) return ESP_ERR_NO_MEM;
+    s_ev = ev; s_bit = bit;
+    return ESP_OK;
+}
+
+bool cmd_sched_submit(uint8_t gate, gate_cmd_t cmd, int64_t t_rx_us, const gate_ref_t *ref) {
+    if (gate >= CMD_SCHED_MAX_GATES || cmd == CMD_NONE || !q_cmd) return false;
+    cnt(&s_recibidos);
+    const gate_ref_t r = ref ? *ref : (gate_ref_t){ 0 };
+    // Solo se fusiona con el inmediatamente anterior: OPEN, CLOSE, OPEN debe terminar en OPEN
+    uint32_t previo = atomic_exchange(&s_ultimo[gate], (uint32_t)cmd);
+
+    switch (cmd) {
+        case CMD_EMERGENCY:
+        case CMD_STOP: {
+            // Nueva época: lo encolado antes de este STOP queda anulado al sacarlo. MQTT, local_cmd y el
+            // httpd pueden llegar a la vez: el instante de 64 bits y su referencia van juntos con los bits
+            portENTER_CRITICAL(&s_stop_mux);
+            if (cmd == CMD_EMERGENCY) atomic_fetch_or(&s_emerg_mask, 1u << gate);
+            s_stop_t_rx[gate] = t_rx_us;
+            s_stop_ref[gate] = r;
+            atomic_fetch_add(&s_stop_epoch[gate], 1);
+            bool ya = atomic_fetch_or(&s_stop_mask, 1u << gate) & (1u << gate);
+            portEXIT_CRITICAL(&s_stop_mux);
+            if (ya) cnt(&s_coalescidos);
+            break;
+        }
+
+        case CMD_LAMP_ON:
+        case CMD_LAMP_OFF:
+            if (atomic_exchange(&s_lamp[gate], (uint32_t)cmd) != CMD_NONE) cnt(&s_coalescidos);
+            break;
+
+        default: {
+            if (cmd > CMD_TOGGLE) return false;
+            uint32_t epoch = atomic_load(&s_stop_epoch[gate]);
+            // Igual al último pedido, todavía pendiente y de la misma época => redundante.
+            // TOGGLE no es idempotente: nunca se fusiona
+            if (cmd != CMD_TOGGLE && previo == (uint32_t)cmd &&
+                atomic_load(&s_pend[gate][cmd]) > 0 && atomic_load(&s_pend_epoch[gate][cmd]) == epoch) {
+                cnt(&s_coalescidos);
+                return true;
+            }
+            gate_msg_t m = { .gate = gate, .cmd = (uint8_t)cmd, .epoch = (uint8_t)epoch, .t_rx_us = t_rx_us, .ref = r };
+            atomic_store(&s_pend_epoch[gate][cmd], epoch);
+            atomic_fetch_add(&s_pend[gate][cmd], 1);
+            if (xQueueSend(q_cmd, &m, 0) != pdTRUE) {
+                atomic_fetch_sub(&s_pend[gate][cmd], 1);
+                cnt(&s_llena);
+                ALOGW(TAG, "q_cmd llena: descartado cmd=%d (portón %u)", cmd, gate);
+                return false;
+            }
+            uint32_t prof = uxQueueMessagesWaiting(q_cmd), max = atomic_load(&s_prof_max);
+            while (prof > max && !atomic_compare_exchange_weak(&s_prof_max, &max, prof)) { }
+            break;
+        }
+    }
+    if (s_ev) xEventGroupSetBits(s_ev, s_bit);
+    return true;
+}
+
+bool cmd_sched_next(gate_msg_t *out) {
+    // 1) Carril STOP
+    uint32_t mask = atomic_load(&s_stop_mask);
+    if (mask) {
+        uint8_t g = (uint8_t)__builtin_ctz(mask);
+        portENTER_CRITICAL(&s_stop_mux);
+        atomic_fetch_and(&s_stop_mask, ~(1u << g));
+        uint8_t c = (atomic_fetch_and(&s_emerg_mask, ~(1u << g)) & (1u << g)) ? CMD_EMERGENCY : CMD_STOP;
+        *out = (gate_msg_t){ .gate = g, .cmd = c, .t_rx_us = s_stop_t_rx[g], .ref = s_stop_ref[g] };
+        portEXIT_CRITICAL(&s_stop_mux);
+        cnt(&s_stop_prio); cnt(&s_entregados);
+        return true;
+    }
+    // 2) Lámparas (solo el último pedido de cada portón)
+    for (uint8_t g = 0; g < CMD_SCHED_MAX_GATES; g++) {
+        uint32_t c = atomic_exchange(&s_lamp[g], CMD_NONE);
+        if (c != CMD_NONE) { *out = (gate_msg_t){ .gate = g, .cmd = (uint8_t)c }; cnt(&s_entregados); return true; }   // sin medición
+    }
+    // 3) Movimientos en orden de llegada, saltando los anulados por un STOP posterior
+    gate_msg_t m;
+    while (xQueueReceive(q_cmd, &m, 0) == pdTRUE) {
+        atomic_fetch_sub(&s_pend[m.gate][m.cmd], 1);
+        if (m.epoch != (uint8_t)atomic_load(&s_stop_epoch[m.gate])) { cnt(&s_anulados); continue; }
+        *out = m;
+        cnt(&s_entregados);
+        return true;
+    }
+    return false;
+}
+
+void cmd_sched_get_stats(cmd_sched_stats_t *out) {
+    *out = (cmd_sched_stats_t){
+        .recibidos       = atomic_load(&s_recibidos),
+        .entregados      = atomic_load(&s_entregados),
+        .coalescidos     = atomic_load(&s_coalescidos),
+        .descartes_llena = atomic_load(&s_llena),
+        .anulados_stop   = atomic_load(&s_anulados),
+        .stop_prioridad  = atomic_load(&s_stop_prio),
+        .profundidad     = q_cmd ? (uint32_t)uxQueueMessagesWaiting(q_cmd) : 0,
+        .profundidad_max = atomic_load(&s_prof_max),
+    };
+}
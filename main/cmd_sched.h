@@ -0,0 +1,61 @@
+/**
+ * @file cmd_sched.h
+ * @brief Planificador de comandos delante de la FSM.
+ *
+ *  - CMD_STOP va por un carril propio (bit atómico por portón) que se entrega antes que
+ *    cualquier otro comando y anula los movimientos encolados antes que él. CMD_EMERGENCY usa
+ *    el mismo carril y, fusionado con un STOP pendiente, se entrega como CMD_EMERGENCY.
+ *  - LAMP_ON/LAMP_OFF no ocupan la cola: cada portón guarda solo el último pedido.
+ *  - OPEN/CLOSE repetidos mientras uno igual sigue pendiente se fusionan.
+ *  - El resto va a q_cmd (FIFO) en orden de llegada.
+ *
+ * La referencia del emisor (gate_ref_t) viaja con el comando hasta la FSM. Un comando fusionado
+ * con uno pendiente conserva la referencia del primero; un LAMP_* no lleva ninguna.
+ */
+#pragma once
+
+#include <stdint.h>
+#include <stdbool.h>
+
+#include "freertos/FreeRTOS.h"
+#include "freertos/event_groups.h"
+#include "esp_err.h"
+
+#include "gate_fsm.h"
+
+#define CMD_SCHED_MAX_GATES  8
+#define CMD_SCHED_DEPTH      16
+
+typedef struct {
+    uint8_t    gate;      // índice de portón
+    uint8_t    cmd;       // gate_cmd_t
+    uint8_t    epoch;     // época de STOP del portón al encolar
+    int64_t    t_rx_us;   // esp_timer_get_time() al recibirlo
+    gate_ref_t ref;       // id/ts del emisor (ceros = sin referencia)
+} gate_msg_t;
+
+typedef struct {
+    uint32_t recibidos;        // llamadas a cmd_sched_submit
+    uint32_t entregados;       // comandos que llegaron a la FSM
+    uint32_t coalescidos;      // fusionados con uno pendiente equivalente
+    uint32_t descartes_llena;  // q_cmd sin espacio
+    uint32_t anulados_stop;    // movimientos encolados que un STOP posterior dejó sin efecto
+    uint32_t stop_prioridad;   // STOP entregados por el carril prioritario
+    uint32_t profundidad;      // mensajes en q_cmd ahora
+    uint32_t profundidad_max;  // máximo observado
+} cmd_sched_stats_t;
+
+/** @brief Crea q_cmd; `bit` se activa en `ev` cada vez que hay algo que entregar. */
+esp_err_t cmd_sched_init(EventGroupHandle_t ev, EventBits_t bit);
+
+/**
+ * @brief Encola un comando (cualquier tarea). Devuelve false si se descartó por cola llena.
+ * @param t_rx_us  Instante de recepción, se propaga hasta la FSM para medir latencias.
+ * @param ref      Referencia del emisor o NULL.
+ */
+bool cmd_sched_submit(uint8_t gate, gate_cmd_t cmd, int64_t t_rx_us, const gate_ref_t *ref);
+
+/** @brief Siguiente comando a aplicar (solo desde la tarea FSM). */
+bool cmd_sched_next(gate_msg_t *out);
+
+void cmd_sched_get_stats(cmd_sched_stats_t *out);
@@ -0,0 +1,191 @@
+/**
+ * @file gate_fsm.c
+ * @brief FSM del portón dirigida por tabla (estado × evento en flash) y multi-instancia.
+ */
+
+#include "gate_fsm.h"
+
+#include "gate_metrics.h"
+
+// Eventos de entrada a la tabla
+typedef enum {
+    GEV_LS_NINGUNO = 0,   // ni LSA ni LSC
+    GEV_LS_ABIERTO,       // solo LSA
+    GEV_LS_CERRADO,       // solo LSC
+    GEV_LS_AMBOS,         // LSA y LSC a la vez (inconsistente)
+    GEV_CMD_OPEN,
+    GEV_CMD_CLOSE,
+    GEV_CMD_STOP,
+    GEV_CMD_TOGGLE,
+    GEV_TIMEOUT,
+    GEV_COUNT
+} gate_ev_t;
+
+// Celda de la tabla: estado siguiente (QUEDA = sin cambio) y código de error a fijar
+typedef struct { int8_t next; uint8_t err; } gate_tr_t;
+
+#define QUEDA -1
+#define __        { QUEDA, ERR_OK }
+#define A(n)      { (n), ERR_OK }
+#define E(code)   { ESTADO_ERROR, (code) }
+
+#define INI ESTADO_INICIAL
+#define ERR ESTADO_ERROR
+#define ABG ESTADO_ABRIENDO
+#define ABO ESTADO_ABIERTO
+#define CEG ESTADO_CERRANDO
+#define CEO ESTADO_CERRADO
+#define DET ESTADO_DETENIDO
+#define DES ESTADO_DESCONOCIDO
+
+static const gate_tr_t k_tabla[GATE_NUM_ESTADOS][GEV_COUNT] = {
+    //               LS_NINGUNO LS_ABIERTO LS_CERRADO LS_AMBOS                  OPEN    CLOSE   STOP    TOGGLE  TIMEOUT
+    [INI] = {        A(DES),    A(ABO),    A(CEO),    E(ERR_LS_INCONSISTENT),   __,     __,     __,     __,     __                    },
+    [ERR] = {        A(DES),    A(ABO),    A(CEO),    __,                       A(ABG), A(CEG), __,     A(ABG), __                    },
+    [ABG] = {        __,        A(ABO),    __,        E(ERR_LS_INCONSISTENT),   __,     A(CEG), A(DET), A(DET), E(ERR_TIMEOUT_OPEN)   },
+    [ABO] = {        A(DES),    __,        A(CEO),    E(ERR_LS_INCONSISTENT),   __,     A(CEG), A(DET), A(CEG), __                    },
+    [CEG] = {        __,        __,        A(CEO),    E(ERR_LS_INCONSISTENT),   A(ABG), __,     A(DET), A(DET), E(ERR_TIMEOUT_CLOSE)  },
+    [CEO] = {        A(DES),    A(ABO),    __,        E(ERR_LS_INCONSISTENT),   A(ABG), __,     A(DET), A(ABG), __                    },
+    // En DETENIDO ningún final está pisado (si no, ya se habría salido), así que TOGGLE cierra
+    [DET] = {        __,        A(ABO),    A(CEO),    E(ERR_LS_INCONSISTENT),   A(ABG), A(CEG), __,     A(CEG), __                    },
+    [DES] = {        __,        A(ABO),    A(CEO),    E(ERR_LS_INCONSISTENT),   A(ABG), A(CEG), __,     A(ABG), __                    },
+};
+
+const char *estado_str(int e) {
+    switch (e) {
+        case ESTADO_INICIAL:     return "INICIAL";
+        case ESTADO_ERROR:       return "ERROR";
+        case ESTADO_ABRIENDO:    return "ABRIENDO";
+        case ESTADO_ABIERTO:     return "ABIERTO";
+        case ESTADO_CERRANDO:    return "CERRANDO";
+        case ESTADO_CERRADO:     return "CERRADO";
+        case ESTADO_DETENIDO:    return "DETENIDO";
+        case ESTADO_DESCONOCIDO: return "DESCONOCIDO";
+        default:                 return "???";
+    }
+}
+
+// ------------------------------ ACTUADORES ------------------------------------
+static inline void motor_stop(gate_t *g)   { g->hal->motor(g, 0, 0); g->motorA = g->motorC = 0; }
+static inline void motor_abrir(gate_t *g)  { g->hal->motor(g, 1, 0); g->motorA = 1; g->motorC = 0; }
+static inline void motor_cerrar(gate_t *g) { g->hal->motor(g, 0, 1); g->motorA = 0; g->motorC = 1; }
+static inline void lamp_on(gate_t *g, bool on) { g->hal->lamp(g, on); g->lamp = on; }
+
+static void armar_deadline(gate_t *g, int ms) {
+    g->deadline_us = (uint64_t)g->hal->ahora_us() + (uint64_t)ms * 1000ULL;
+    g->hal->deadline(g, (int64_t)ms * 1000);
+}
+static void cancelar_deadline(gate_t *g) { g->hal->deadline(g, 0); g->deadline_us = 0; }
+
+/** @brief Recorrido nuevo: la muestra solo vale si arranca desde el final opuesto. */
+static void arrancar_recorrido(gate_t *g, travel_sentido_t s, bool desde_final, int limite_ms) {
+    g->rec_t0_us = g->hal->ahora_us();
+    g->rec_completo = desde_final;
+    g->rec_timeout_ms = travel_timeout_ms(&g->travel.dir[s], (uint32_t)limite_ms);
+    armar_deadline(g, (int)g->rec_timeout_ms);
+}
+static void aprender(gate_t *g, travel_sentido_t s) {
+    if (!g->rec_completo) return;
+    g->rec_completo = false;
+    if (travel_agregar(&g->travel.dir[s], (uint32_t)((g->hal->ahora_us() - g->rec_t0_us) / 1000))) g->travel_nuevo = true;
+}
+
+// Acciones de entrada a cada estado
+static void gate_entrar(gate_t *g, int estado, int prev) {
+    switch (estado) {
+        case ESTADO_ABRIENDO: motor_abrir(g);  arrancar_recorrido(g, TRAVEL_ABRIR, prev == ESTADO_CERRADO, g->cfg->t_open_ms);  break;
+        case ESTADO_CERRANDO: motor_cerrar(g); arrancar_recorrido(g, TRAVEL_CERRAR, prev == ESTADO_ABIERTO, g->cfg->t_close_ms); break;
+        default:              motor_stop(g);   cancelar_deadline(g); break;
+    }
+    if (g->t_cmd_rx_us) gate_metrics_lat(MET_RX_ACT, g->hal->ahora_us() - g->t_cmd_rx_us);
+    if (g->ref_rx_us && g->ref_act_us < 0) g->ref_act_us = (int32_t)(g->hal->ahora_us() - g->ref_rx_us);
+}
+
+static inline bool en_recorrido(int e) { return e == ESTADO_ABRIENDO || e == ESTADO_CERRANDO; }
+
+void gate_ref_fijar(gate_t *g, const gate_ref_t *ref, int64_t t_rx_us) {
+    g->ref = ref ? *ref : (gate_ref_t){ 0 };
+    g->ref_rx_us = gate_ref_activa(g) ? t_rx_us : 0;
+    g->ref_act_us = g->ref_settle_us = -1;
+}
+
+// ------------------------------ MOTOR DE TABLA --------------------------------
+static inline gate_ev_t evento_sensores(gate_t *g) {
+    uint32_t ls = g->hal->sensores(g);
+    g->lsa = (ls & GATE_LS_LSA) != 0;
+    g->lsc = (ls & GATE_LS_LSC) != 0;
+    if (g->lsa && g->lsc) return GEV_LS_AMBOS;
+    if (g->lsa)           return GEV_LS_ABIERTO;
+    if (g->lsc)           return GEV_LS_CERRADO;
+    return GEV_LS_NINGUNO;
+}
+
+/** @brief Aplica un evento; devuelve true si hubo cambio de estado. */
+static bool gate_aplicar(gate_t *g, gate_ev_t ev) {
+    if (g->estado < 0 || g->estado >= GATE_NUM_ESTADOS) {
+        g->estado = ESTADO_ERROR; g->error_code = ERR_STATE_GUARDRAIL;
+        gate_metrics_error(ERR_STATE_GUARDRAIL);
+        gate_entrar(g, ESTADO_ERROR, ESTADO_ERROR);
+        return true;
+    }
+    const gate_tr_t tr = k_tabla[g->estado][ev];
+    if (tr.next == QUEDA) return false;
+
+    int prev = g->estado;
+    if (tr.err != ERR_OK) { g->error_code = tr.err; gate_metrics_error(tr.err); }
+    g->estado = tr.next;
+    gate_entrar(g, g->estado, prev);
+    if (prev == ESTADO_ABRIENDO && g->estado == ESTADO_ABIERTO) aprender(g, TRAVEL_ABRIR);
+    if (prev == ESTADO_CERRANDO && g->estado == ESTADO_CERRADO) aprender(g, TRAVEL_CERRAR);
+    if (g->ref_rx_us && g->ref_settle_us < 0 && !en_recorrido(g->estado)) g->ref_settle_us = (int32_t)(g->hal->ahora_us() - g->ref_rx_us);
+    if (ev <= GEV_LS_AMBOS && en_recorrido(prev) && !en_recorrido(g->estado)) {
+        int64_t t0 = g->hal->t_flanco_us(g);
+        if (t0) gate_metrics_lat(MET_LS_STOP, g->hal->ahora_us() - t0);
+    }
+    gate_metrics_transicion(prev, g->estado);
+    if (g->on_transicion) g->on_transicion(g, prev);
+    return true;
+}
+
+/** @brief Tras un cambio se vuelven a mirar los sensores, como al entrar a cada estado. */
+static void gate_estabilizar(gate_t *g) {
+    for (int i = 0; i < GATE_NUM_ESTADOS; i++) {
+        if (!gate_aplicar(g, evento_sensores(g))) return;
+    }
+}
+
+void gate_evaluar(gate_t *g) {
+    gate_estabilizar(g);
+    if (g->deadline_us && (uint64_t)g->hal->ahora_us() >= g->deadline_us) {
+        if (gate_aplicar(g, GEV_TIMEOUT)) gate_estabilizar(g);
+    }
+}
+
+void gate_comando(gate_t *g, gate_cmd_t cmd) {
+    gate_ev_t ev;
+    switch (cmd) {
+        case CMD_LAMP_ON:  lamp_on(g, true);  return;
+        case CMD_LAMP_OFF: lamp_on(g, false); return;
+        case CMD_OPEN:     ev = GEV_CMD_OPEN;   break;
+        case CMD_CLOSE:    ev = GEV_CMD_CLOSE;  break;
+        case CMD_STOP:     ev = GEV_CMD_STOP;   break;
+        case CMD_TOGGLE:   ev = GEV_CMD_TOGGLE; break;
+        case CMD_EMERGENCY:
+            if (!g->emergencia) { g->emergencia = true; g->error_code = ERR_EMERGENCIA; gate_metrics_error(ERR_EMERGENCIA); }
+            // Se publica aunque el portón ya estuviera quieto (STOP no cambia de estado)
+            if (!gate_aplicar(g, GEV_CMD_STOP) && g->on_transicion) g->on_transicion(g, g->estado);
+            return;
+        default:           return;
+    }
+    if (g->emergencia && ev != GEV_CMD_STOP) return;   // trabado hasta reiniciar
+    // El estado INICIAL se resuelve solo con sensores; un comando ahí espera a la primera evaluación
+    if (g->estado == ESTADO_INICIAL) gate_estabilizar(g);
+    if (gate_aplicar(g, ev)) gate_estabilizar(g);
+}
+
+// ------------------------------ INICIALIZACIÓN --------------------------------
+void gate_init(gate_t *g, const gate_cfg_t *cfg, uint8_t id, const gate_hal_t *hal, void *hw, gate_transicion_cb_t cb) {
+    *g = (gate_t){ .cfg = cfg, .id = id, .estado = ESTADO_INICIAL, .error_code = ERR_OK, .hal = hal, .hw = hw, .on_transicion = cb,
+                   .ref_act_us = -1, .ref_settle_us = -1, .travel = { .version = TRAVEL_VERSION } };
+    motor_stop(g); lamp_on(g, false);
+}
@@ -0,0 +1,116 @@
+/**
+ * @file gate_fsm.h
+ * @brief Motor de transiciones por tabla para uno o varios portones.
+ *
+ * La tabla estado × evento es constante (vive en flash) y es la misma para todos los
+ * portones; cada portón solo aporta su contexto (`gate_t`): pines, tiempos y estado.
+ * Una sola tarea puede atender N portones llamando a gate_evaluar()/gate_comando().
+ *
+ * El tiempo máximo de cada recorrido sale de travel_model (lo aprendido, acotado por t_open_ms /
+ * t_close_ms), así un portón trabado se detecta poco después de lo que tarda normalmente.
+ *
+ * El motor no toca hardware: pines, reloj, finales de carrera y aviso de deadline llegan por
+ * un `gate_hal_t`. En el firmware lo implementa gate_hal_esp.c; en el host, tools/gate_sim.
+ */
+#pragma once
+
+#include <stdint.h>
+#include <stdbool.h>
+
+#include "gate_cmd.h"
+#include "travel_model.h"
+
+// ------------------------------ ESTADOS ---------------------------------------
+#define ESTADO_INICIAL     0
+#define ESTADO_ERROR       1
+#define ESTADO_ABRIENDO    2
+#define ESTADO_ABIERTO     3
+#define ESTADO_CERRANDO    4
+#define ESTADO_CERRADO     5
+#define ESTADO_DETENIDO    6
+#define ESTADO_DESCONOCIDO 7
+#define GATE_NUM_ESTADOS   8
+
+#define ERR_OK                 0
+#define ERR_TIMEOUT_OPEN       1
+#define ERR_TIMEOUT_CLOSE      2
+#define ERR_LS_INCONSISTENT    3
+#define ERR_EMERGENCIA         4   // CMD_EMERGENCY: trabado hasta reiniciar
+#define ERR_STATE_GUARDRAIL   99
+
+// Bits de la lectura de finales de carrera (mismo formato que la instantánea de ls_debounce)
+#define GATE_LS_LSA  (1u << 0)
+#define GATE_LS_LSC  (1u << 1)
+
+// Configuración fija de un portón
+typedef struct {
+    const char *nombre;
+    int         pin_lsa, pin_lsc;     // gpio_num_t en el firmware
+    int         pin_motor_a, pin_motor_c;
+    int         pin_lamp;
+    int         lm_activo;            // nivel activo de los finales de carrera
+    int         debounce_ms;
+    int         t_open_ms, t_close_ms;
+} gate_cfg_t;
+
+typedef struct gate gate_t;
+typedef void (*gate_transicion_cb_t)(gate_t *g, int estado_prev);
+
+// Acceso al hardware (o a su simulación) de un portón
+typedef struct {
+    void     (*motor)(gate_t *g, int a, int c);   // fija los pines del motor; al arrancar respeta el tiempo muerto sin bloquear
+    void     (*lamp)(gate_t *g, bool on);
+    uint32_t (*sensores)(gate_t *g);              // última pareja confirmada, bits GATE_LS_*
+    int64_t  (*t_flanco_us)(gate_t *g);           // primer flanco de la última ráfaga (0 = desconocido)
+    void     (*deadline)(gate_t *g, int64_t us);  // avisa en `us` µs para llamar a gate_evaluar (0 = cancelar)
+    int64_t  (*ahora_us)(void);
+} gate_hal_t;
+
+// Contexto por portón
+struct gate {
+    const gate_cfg_t    *cfg;
+    uint8_t              id;
+    int                  estado;
+    int                  error_code;
+    int                  motorA, motorC;
+    int                  lsa, lsc;
+    bool                 lamp;
+    bool                 emergencia;      // CMD_EMERGENCY recibido: se ignoran OPEN/CLOSE/TOGGLE
+    uint64_t             deadline_us;     // 0 = sin recorrido en curso
+    int64_t              t_cmd_rx_us;     // recepción del comando en curso (0 = ninguno), para métricas
+    gate_ref_t           ref;             // último comando con referencia, hasta llegar al reposo
+    int64_t              ref_rx_us;       // su recepción (0 = sin medición)
+    int32_t              ref_act_us;      // recepción -> motor actuado (-1 = todavía no)
+    int32_t              ref_settle_us;   // recepción -> estado de reposo (-1 = todavía no)
+    travel_model_t       travel;          // tiempos de recorrido aprendidos (los persiste la aplicación)
+    bool                 travel_nuevo;    // hubo muestra nueva desde que la aplicación lo bajó a false
+    int64_t              rec_t0_us;       // inicio del recorrido en curso
+    bool                 rec_completo;    // salió de un final: al llegar al otro la muestra vale
+    uint32_t             rec_timeout_ms;  // tiempo máximo aplicado al recorrido en curso
+    const gate_hal_t    *hal;
+    void                *hw;              // contexto propio del HAL
+    gate_transicion_cb_t on_transicion;   // se llama tras cada cambio de estado
+};
+
+/** @brief Nombre legible de un ESTADO_*. */
+const char *estado_str(int e);
+
+/** @brief Deja el portón en INICIAL con motor y lámpara apagados. El HAL ya debe estar listo. */
+void gate_init(gate_t *g, const gate_cfg_t *cfg, uint8_t id, const gate_hal_t *hal, void *hw, gate_transicion_cb_t cb);
+
+/**
+ * @brief Asocia al portón la referencia del comando que se va a aplicar (NULL o vacía = ninguna).
+ *        La FSM mide desde `t_rx_us` hasta la primera actuación y hasta el primer estado de reposo.
+ */
+void gate_ref_fijar(gate_t *g, const gate_ref_t *ref, int64_t t_rx_us);
+static inline bool gate_ref_activa(const gate_t *g) { return g->ref.id || g->ref.ts; }
+
+/** @brief Reevalúa finales de carrera y deadline; aplica las transiciones que correspondan. */
+void gate_evaluar(gate_t *g);
+
+/**
+ * @brief Aplica un comando en el estado actual (incluye los de lámpara).
+ *        CMD_EMERGENCY detiene como STOP y deja el portón sin movimiento hasta reiniciar.
+ *        Si `g->t_cmd_rx_us` está fijado se registra la latencia hasta actuar el motor.
+ */
+void gate_comando(gate_t *g, gate_cmd_t cmd);
@@ -0,0 +1,90 @@
+/**
+ * @file gate_hal_esp.c
+ * @brief Implementación de gate_hal_t para el ESP32.
+ */
+
+#include "gate_hal_esp.h"
+
+#include "driver/gpio.h"
+
+#include "gate_pm.h"
+
+_Static_assert(GATE_LS_LSA == LS_BIT_LSA && GATE_LS_LSC == LS_BIT_LSC, "formato de instantánea distinto");
+
+#define HW(g) ((gate_esp_t *)(g)->hw)
+
+static portMUX_TYPE s_mux = portMUX_INITIALIZER_UNLOCKED;   // pin_pend: FSM y tarea esp_timer
+
+/** @brief Patrón de la lámpara según marcha y último pedido; con LEDC no hay nada que refrescar después. */
+static void lamp_aplicar(gate_t *g) {
+    gate_esp_t *hw = HW(g);
+    if (hw->lamp_ind < 0) { gpio_set_level(g->cfg->pin_lamp, hw->lamp_on ? 1 : 0); return; }
+    indic_set(hw->lamp_ind, hw->en_marcha ? GATE_LAMP_RECORRIDO : hw->lamp_on ? INDIC_FIJO : INDIC_APAGADO);
+}
+static void hal_motor(gate_t *g, int a, int c) {
+    // Primero se anula un arranque pendiente y se suelta el sentido contrario; el relé nuevo lo
+    // cierra on_muerto tras GATE_TIEMPO_MUERTO_US, así un portón que invierte no frena a los demás
+    gate_esp_t *hw = HW(g);
+    portENTER_CRITICAL(&s_mux);
+    hw->pin_pend = -1;
+    if (!a) gpio_set_level(g->cfg->pin_motor_a, 0);
+    if (!c) gpio_set_level(g->cfg->pin_motor_c, 0);
+    portEXIT_CRITICAL(&s_mux);
+    esp_timer_stop(hw->t_muerto);
+    bool marcha = a || c;
+    if (marcha != hw->en_marcha) { hw->en_marcha = marcha; lamp_aplicar(g); }
+    if (!marcha) return;
+    portENTER_CRITICAL(&s_mux);
+    hw->pin_pend = a ? g->cfg->pin_motor_a : g->cfg->pin_motor_c;
+    portEXIT_CRITICAL(&s_mux);
+    esp_timer_start_once(hw->t_muerto, GATE_TIEMPO_MUERTO_US);
+}
+static void     hal_lamp(gate_t *g, bool on)   { HW(g)->lamp_on = on; lamp_aplicar(g); }
+static uint32_t hal_sensores(gate_t *g)        { return ls_debounce_snapshot(&HW(g)->ls) & (GATE_LS_LSA | GATE_LS_LSC); }
+static int64_t  hal_t_flanco(gate_t *g)        { return HW(g)->ls.t_flanco_us; }
+static int64_t  hal_ahora(void)                { return esp_timer_get_time(); }
+static void hal_deadline(gate_t *g, int64_t us) {
+    esp_timer_stop(HW(g)->t_deadline);
+    if (us > 0) esp_timer_start_once(HW(g)->t_deadline, (uint64_t)us);
+}
+
+static const gate_hal_t k_hal_esp = {
+    .motor = hal_motor, .lamp = hal_lamp, .sensores = hal_sensores,
+    .t_flanco_us = hal_t_flanco, .deadline = hal_deadline, .ahora_us = hal_ahora,
+};
+
+static void on_ls_edge(uint32_t snap, void *arg) { gate_t *g = arg; xEventGroupSetBits(HW(g)->ev, EV_LS); }
+static void on_deadline(void *arg)               { gate_t *g = arg; xEventGroupSetBits(HW(g)->ev, EV_DEADLINE); }
+static void on_muerto(void *arg) {   // tarea esp_timer; un STOP que llegue antes ya dejó pin_pend en -1
+    gate_esp_t *hw = HW((gate_t *)arg);
+    portENTER_CRITICAL(&s_mux);
+    if (hw->pin_pend >= 0) gpio_set_level(hw->pin_pend, 1);
+    hw->pin_pend = -1;
+    portEXIT_CRITICAL(&s_mux);
+}
+
+esp_err_t gate_esp_init(gate_t *g, gate_esp_t *hw, const gate_cfg_t *cfg, uint8_t id, EventGroupHandle_t ev, gate_transicion_cb_t cb) {
+    *hw = (gate_esp_t){ .ev = ev, .lamp_ind = -1, .pin_pend = -1 };
+
+    gpio_config_t in = { .pin_bit_mask=(1ULL<<cfg->pin_lsa)|(1ULL<<cfg->pin_lsc), .mode=GPIO_MODE_INPUT, .pull_up_en=GPIO_PULLUP_DISABLE, .pull_down_en=GPIO_PULLDOWN_DISABLE, .intr_type=GPIO_INTR_DISABLE };
+    esp_err_t err = gpio_config(&in);
+    if (err != ESP_OK) return err;
+    gpio_config_t out = { .pin_bit_mask=(1ULL<<cfg->pin_motor_a)|(1ULL<<cfg->pin_motor_c)|(1ULL<<cfg->pin_lamp), .mode=GPIO_MODE_OUTPUT, .pull_up_en=GPIO_PULLUP_DISABLE, .pull_down_en=GPIO_PULLDOWN_DISABLE, .intr_type=GPIO_INTR_DISABLE };
+    if ((err = gpio_config(&out)) != ESP_OK) return err;
+
+    const esp_timer_create_args_t dl = { .callback = on_deadline, .arg = g, .name = "gate_deadline" };
+    if ((err = esp_timer_create(&dl, &hw->t_deadline)) != ESP_OK) return err;
+    const esp_timer_create_args_t tm = { .callback = on_muerto, .arg = g, .name = "gate_muerto" };
+    if ((err = esp_timer_create(&tm, &hw->t_muerto)) != ESP_OK) return err;
+
+    hw->lamp_ind = indic_agregar(cfg->pin_lamp, false);   // sin canales libres sigue por GPIO
+    gate_init(g, cfg, id, &k_hal_esp, hw, cb);   // motor y lámpara apagados
+
+    hw->ls = (ls_debounce_t){
+        .pin_lsa = cfg->pin_lsa, .pin_lsc = cfg->pin_lsc, .nivel_activo = cfg->lm_activo,
+        .stable_samples = (cfg->debounce_ms * 1000) / LS_SAMPLE_US,
+        .despertar = GATE_PM_LIGHT_SLEEP,
+        .on_edge = on_ls_edge, .arg = g,
+    };
+    return ls_debounce_init(&hw->ls);
+}
@@ -0,0 +1,51 @@
+/**
+ * @file gate_hal_esp.h
+ * @brief HAL del portón sobre GPIO, ls_debounce y esp_timer (firmware).
+ *
+ * Los finales de carrera y el deadline despiertan a la tarea FSM por el event group;
+ * la tarea es la que llama a gate_evaluar().
+ */
+#pragma once
+
+#include "freertos/FreeRTOS.h"
+#include "freertos/event_groups.h"
+#include "esp_timer.h"
+#include "esp_err.h"
+
+#include "gate_fsm.h"
+#include "ls_debounce.h"
+#include "indic.h"
+
+// Bits del event group que despierta a la tarea FSM
+#define EV_CMD       (1u << 0)   // hay comandos en la cola
+#define EV_LS        (1u << 1)   // flanco confirmado en LSA/LSC de algún portón
+#define EV_DEADLINE  (1u << 2)   // venció el tiempo máximo de recorrido de algún portón
+#define EV_TELE      (1u << 3)   // toca publicar telemetría periódica
+#define EV_PUB       (1u << 4)   // toca vaciar un lote de publicaciones acumuladas offline
+#define EV_SONDA     (1u << 5)   // sonda periódica para medir el retardo de planificación de la FSM
+#define EV_PROG      (1u << 6)   // toca publicar avance/ETA de los portones en recorrido
+#define EV_TRAVEL    (1u << 7)   // se leyeron de NVS los tiempos de recorrido aprendidos
+#define EV_ALL       (EV_CMD | EV_LS | EV_DEADLINE | EV_TELE | EV_PUB | EV_SONDA | EV_PROG | EV_TRAVEL)
+
+// La lámpara va por LEDC: mientras el motor corre parpadea sola, luego vuelve a LAMP_ON/OFF
+#define GATE_LAMP_RECORRIDO  INDIC_LENTO
+// Entre soltar un relé y cerrar el otro; lo cumple un esp_timer, la tarea FSM no espera
+#define GATE_TIEMPO_MUERTO_US  10000
+
+// Contexto de hardware de un portón (gate_t::hw)
+typedef struct {
+    ls_debounce_t      ls;
+    esp_timer_handle_t t_deadline;
+    esp_timer_handle_t t_muerto;   // fin del tiempo muerto: cierra pin_pend
+    int                pin_pend;   // relé a cerrar al vencer t_muerto (-1 = ninguno)
+    EventGroupHandle_t ev;
+    int                lamp_ind;   // indicador LEDC de la lámpara (-1 = GPIO directo)
+    bool               lamp_on;    // último LAMP_ON/OFF pedido
+    bool               en_marcha;
+} gate_esp_t;
+
+/**
+ * @brief Configura GPIO, antirrebote y deadline del portón y lo deja en INICIAL. No mueve el motor.
+ * @param ev  Event group donde se señalan EV_LS / EV_DEADLINE.
+ */
+esp_err_t gate_esp_init(gate_t *g, gate_esp_t *hw, const gate_cfg_t *cfg, uint8_t id, EventGroupHandle_t ev, gate_transicion_cb_t cb);
@@ -0,0 +1,97 @@
+/**
+ * @file gate_json.c
+ * @brief Escritor JSON de buffer fijo para publicar_json().
+ */
+
+#include "gate_json.h"
+
+#include <string.h>
+
+#include "gate_wire.h"
+
+typedef struct { const char *s; size_t n; } frag_t;
+#define FRAG(lit) { lit, sizeof(lit) - 1 }
+
+// Prefijo completo hasta el primer valor variable, uno por estado
+#define PREFIJO(nombre) FRAG("{\"state\":\"" nombre "\",\"lsa_open\":")
+static const frag_t k_prefijo[GATE_NUM_ESTADOS + 1] = {
+    [ESTADO_INICIAL]     = PREFIJO("INICIAL"),
+    [ESTADO_ERROR]       = PREFIJO("ERROR"),
+    [ESTADO_ABRIENDO]    = PREFIJO("ABRIENDO"),
+    [ESTADO_ABIERTO]     = PREFIJO("ABIERTO"),
+    [ESTADO_CERRANDO]    = PREFIJO("CERRANDO"),
+    [ESTADO_CERRADO]     = PREFIJO("CERRADO"),
+    [ESTADO_DETENIDO]    = PREFIJO("DETENIDO"),
+    [ESTADO_DESCONOCIDO] = PREFIJO("DESCONOCIDO"),
+    [GATE_NUM_ESTADOS]   = PREFIJO("???"),
+};
+static const frag_t k_bool[2]    = { FRAG("false"), FRAG("true") };
+static const frag_t k_lsc        = FRAG(",\"lsc_closed\":");
+static const frag_t k_mot_open   = FRAG(",\"motor_open\":");
+static const frag_t k_mot_close  = FRAG(",\"motor_close\":");
+static const frag_t k_err        = FRAG(",\"err\":");
+static const frag_t k_cmd_id     = FRAG(",\"cmd_id\":");
+static const frag_t k_cmd_ts     = FRAG(",\"cmd_ts\":");
+static const frag_t k_rx_act     = FRAG(",\"rx_act_us\":");
+static const frag_t k_rx_settle  = FRAG(",\"rx_settle_us\":");
+
+typedef struct { char *p, *end; } wr_t;
+
+static inline void put(wr_t *w, const frag_t *f) {
+    if (!w->p) return;
+    if ((size_t)(w->end - w->p) < f->n) { w->p = NULL; return; }
+    memcpy(w->p, f->s, f->n); w->p += f->n;
+}
+static inline void put_num(wr_t *w, uint64_t u, bool neg) {
+    char tmp[21]; int n = 0;
+    do { tmp[n++] = (char)('0' + u % 10); u /= 10; } while (u);
+    if (neg) tmp[n++] = '-';
+    if (!w->p || w->end - w->p < n) { w->p = NULL; return; }
+    while (n) *w->p++ = tmp[--n];
+}
+static inline void put_int(wr_t *w, int v) { put_num(w, v < 0 ? 0u - (unsigned)v : (unsigned)v, v < 0); }
+
+size_t gate_json_estado(char *buf, size_t cap, const gate_t *g, bool include_mot, bool include_err) {
+    if (!buf || cap == 0) return 0;
+    wr_t w = { buf, buf + cap - 1 };   // reserva el '\0'
+    int e = (g->estado >= 0 && g->estado < GATE_NUM_ESTADOS) ? g->estado : GATE_NUM_ESTADOS;
+
+    put(&w, &k_prefijo[e]);
+    put(&w, &k_bool[g->lsa != 0]);
+    put(&w, &k_lsc);
+    put(&w, &k_bool[g->lsc != 0]);
+    if (include_mot) {
+        put(&w, &k_mot_open);  put(&w, &k_bool[g->motorA != 0]);
+        put(&w, &k_mot_close); put(&w, &k_bool[g->motorC != 0]);
+    }
+    if (include_err) { put(&w, &k_err); put_int(&w, g->error_code); }
+    if (gate_ref_activa(g)) {
+        if (g->ref.id)              { put(&w, &k_cmd_id);    put_num(&w, g->ref.id, false); }
+        if (g->ref.ts)              { put(&w, &k_cmd_ts);    put_num(&w, g->ref.ts, false); }
+        if (g->ref_act_us >= 0)     { put(&w, &k_rx_act);    put_num(&w, (uint64_t)g->ref_act_us, false); }
+        if (g->ref_settle_us >= 0)  { put(&w, &k_rx_settle); put_num(&w, (uint64_t)g->ref_settle_us, false); }
+    }
+    if (!w.p || w.p == w.end) return 0;
+    *w.p++ = '}';
+    *w.p = '\0';
+    return (size_t)(w.p - buf);
+}
+
+size_t gate_cbor_estado(uint8_t *buf, size_t cap, const gate_t *g, bool include_mot, bool include_err) {
+    gw_writer_t w; gw_writer_init(&w, buf, cap);
+    bool ref = gate_ref_activa(g);
+    unsigned nref = ref ? (unsigned)(g->ref.id != 0) + (g->ref.ts != 0) + (g->ref_act_us >= 0) + (g->ref_settle_us >= 0) : 0;
+    gw_map(&w, 3u + (include_mot ? 2u : 0u) + (include_err ? 1u : 0u) + nref);
+    gw_put_uint(&w, GW_K_STATE, (uint32_t)((g->estado >= 0 && g->estado < GATE_NUM_ESTADOS) ? g->estado : GATE_NUM_ESTADOS));
+    gw_put_bool(&w, GW_K_LSA, g->lsa != 0);
+    gw_put_bool(&w, GW_K_LSC, g->lsc != 0);
+    if (include_mot) { gw_put_bool(&w, GW_K_MOTOR_OPEN, g->motorA != 0); gw_put_bool(&w, GW_K_MOTOR_CLOSE, g->motorC != 0); }
+    if (include_err) gw_put_int(&w, GW_K_ERR, g->error_code);
+    if (ref) {
+        if (g->ref.id)             gw_put_uint(&w, GW_K_ID, g->ref.id);
+        if (g->ref.ts)             gw_put_u64(&w, GW_K_TS, g->ref.ts);
+        if (g->ref_act_us >= 0)    gw_put_uint(&w, GW_K_RX_ACT, (uint32_t)g->ref_act_us);
+        if (g->ref_settle_us >= 0) gw_put_uint(&w, GW_K_RX_SETTLE, (uint32_t)g->ref_settle_us);
+    }
+    return gw_writer_len(&w);
+}
@@ -0,0 +1,35 @@
+/**
+ * @file gate_json.h
+ * @brief Serializador JSON sin heap para el documento de estado/telemetría del portón.
+ *
+ * Produce exactamente el mismo texto que la versión con cJSON_PrintUnformatted():
+ *   {"state":"CERRADO","lsa_open":false,"lsc_closed":true,"motor_open":false,"motor_close":false,"err":0}
+ * Las partes fijas (incluido el prefijo de cada estado) están preformateadas en flash y solo
+ * se copian; lo único que se formatea en cada publicación son los booleanos y el código de error.
+ *
+ * gate_cbor_estado() produce el mismo contenido en CBOR (gate_wire.h) para "<tópico>/cbor":
+ * GW_K_STATE lleva el número ESTADO_*.
+ *
+ * Mientras el portón tiene una referencia de comando (gate_ref_activa()) se agregan al final
+ * "cmd_id", "cmd_ts", "rx_act_us" y "rx_settle_us" (los que ya se conocen).
+ */
+#pragma once
+
+#include <stddef.h>
+#include <stdbool.h>
+
+#include <stdint.h>
+
+#include "gate_fsm.h"
+
+#define GATE_JSON_MAX  240   // cabe el documento más largo (DESCONOCIDO + motor + err + referencia completa)
+#define GATE_CBOR_MAX  56    // mapa de 10 pares con err de hasta 5 bytes y ts de 9
+
+/**
+ * @brief Escribe el documento del portón en `buf` (terminado en '\0').
+ * @return Longitud escrita sin el terminador, o 0 si `cap` no alcanza.
+ */
+size_t gate_json_estado(char *buf, size_t cap, const gate_t *g, bool include_mot, bool include_err);
+
+/** @brief Igual que gate_json_estado() pero en CBOR. @return Bytes escritos, o 0 si no alcanza. */
+size_t gate_cbor_estado(uint8_t *buf, size_t cap, const gate_t *g, bool include_mot, bool include_err);
@@ -0,0 +1,102 @@
+/**
+ * @file gate_metrics.c
+ * @brief Histogramas de latencia y contadores por ERR_* / transición.
+ */
+
+#include "gate_metrics.h"
+
+#include <stdio.h>
+#include <string.h>
+#include <stdarg.h>
+#include <stdbool.h>
+
+#include "gate_fsm.h"
+
+typedef struct {
+    uint32_t n;
+    uint32_t min, max;
+    uint64_t suma;
+    uint32_t b[MET_BUCKETS];
+} hist_t;
+
+static hist_t   s_hist[MET_COUNT];
+static uint32_t s_tr[GATE_NUM_ESTADOS][GATE_NUM_ESTADOS];
+
+// Códigos de error conocidos y su contador
+static const int k_err_codes[] = { ERR_TIMEOUT_OPEN, ERR_TIMEOUT_CLOSE, ERR_LS_INCONSISTENT, ERR_EMERGENCIA, ERR_STATE_GUARDRAIL };
+#define N_ERR (sizeof(k_err_codes) / sizeof(k_err_codes[0]))
+static uint32_t s_err[N_ERR];
+
+static const char *const k_path_name[MET_COUNT] = { "rx_deq", "rx_act", "rx_pub", "ls_stop", "fsm_wake" };
+
+void gate_metrics_lat(gate_met_path_t p, int64_t us) {
+    if (p >= MET_COUNT || us < 0) return;
+    hist_t *h = &s_hist[p];
+    uint32_t v = us > UINT32_MAX ? UINT32_MAX : (uint32_t)us;
+    int b = v ? 31 - __builtin_clz(v) : 0;
+    if (b >= MET_BUCKETS) b = MET_BUCKETS - 1;
+    h->b[b]++;
+    if (h->n == 0 || v < h->min) h->min = v;
+    if (v > h->max) h->max = v;
+    h->suma += v;
+    h->n++;
+}
+
+void gate_metrics_transicion(int desde, int hacia) {
+    if (desde >= 0 && desde < GATE_NUM_ESTADOS && hacia >= 0 && hacia < GATE_NUM_ESTADOS) s_tr[desde][hacia]++;
+}
+
+void gate_metrics_error(int code) {
+    for (size_t i = 0; i < N_ERR; i++) if (k_err_codes[i] == code) { s_err[i]++; return; }
+}
+
+void gate_metrics_reset(void) {
+    memset(s_hist, 0, sizeof(s_hist));
+    memset(s_tr, 0, sizeof(s_tr));
+    memset(s_err, 0, sizeof(s_err));
+}
+
+// --------------------------------- INFORME -----------------------------------
+typedef struct { char *p; size_t left; bool ok; } out_t;
+
+static void emit(out_t *o, const char *fmt, ...) __attribute__((format(printf, 2, 3)));
+static void emit(out_t *o, const char *fmt, ...) {
+    if (!o->ok) return;
+    va_list ap; va_start(ap, fmt);
+    int n = vsnprintf(o->p, o->left, fmt, ap);
+    va_end(ap);
+    if (n < 0 || (size_t)n >= o->left) { o->ok = false; return; }
+    o->p += n; o->left -= (size_t)n;
+}
+
+size_t gate_metrics_report(char *buf, size_t cap, const char *fw, uint32_t up_s) {
+    out_t o = { buf, cap, cap > 0 };
+
+    emit(&o, "{\"fw\":\"%s\",\"up_s\":%lu,\"lat\":{", fw, (unsigned long)up_s);
+    for (int p = 0; p < MET_COUNT; p++) {
+        const hist_t *h = &s_hist[p];
+        emit(&o, "%s\"%s\":{\"n\":%lu", p ? "," : "", k_path_name[p], (unsigned long)h->n);
+        if (h->n) {
+            emit(&o, ",\"min\":%lu,\"avg\":%lu,\"max\":%lu,\"b\":[", (unsigned long)h->min,
+                 (unsigned long)(h->suma / h->n), (unsigned long)h->max);
+            int last = MET_BUCKETS - 1;
+            while (last > 0 && !h->b[last]) last--;
+            for (int i = 0; i <= last; i++) emit(&o, "%s%lu", i ? "," : "", (unsigned long)h->b[i]);
+            emit(&o, "]");
+        }
+        emit(&o, "}");
+    }
+    emit(&o, "},\"err\":{");
+    for (size_t i = 0; i < N_ERR; i++) emit(&o, "%s\"%d\":%lu", i ? "," : "", k_err_codes[i], (unsigned long)s_err[i]);
+    emit(&o, "},\"tr\":[");
+    bool first = true;
+    for (int a = 0; a < GATE_NUM_ESTADOS; a++) {
+        for (int b = 0; b < GATE_NUM_ESTADOS; b++) {
+            if (!s_tr[a][b]) continue;
+            emit(&o, "%s[%d,%d,%lu]", first ? "" : ",", a, b, (unsigned long)s_tr[a][b]);
+            first = false;
+        }
+    }
+    emit(&o, "]}");
+    return o.ok ? (size_t)(o.p - buf) : 0;
+}
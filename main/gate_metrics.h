@@ -0,0 +1,38 @@
+/**
+ * @file gate_metrics.h
+ * @brief Instrumentación ligera de los caminos críticos (histogramas de latencia y contadores).
+ *
+ * Los tiempos salen del reloj del HAL (esp_timer_get_time() en el firmware). Cada camino tiene un histograma log2 de buckets
+ * fijos en µs (bucket i = [2^i, 2^(i+1)) µs), más n/min/max/suma. Se registra desde la tarea
+ * FSM; el informe se arma bajo demanda y no asigna memoria.
+ */
+#pragma once
+
+#include <stdint.h>
+#include <stddef.h>
+
+// Caminos medidos
+typedef enum {
+    MET_RX_DEQ = 0,   // comando recibido (MQTT) -> sacado de q_cmd por la FSM
+    MET_RX_ACT,       // comando recibido -> pines del motor actuados
+    MET_RX_PUB,       // comando recibido -> estado publicado
+    MET_LS_STOP,      // primer flanco del final de carrera -> motor detenido
+    MET_FSM_WAKE,     // bit puesto por un esp_timer -> tarea FSM corriendo (retardo de planificación)
+    MET_COUNT
+} gate_met_path_t;
+
+#define MET_BUCKETS  22   // 1 µs .. >2 s
+
+void gate_metrics_lat(gate_met_path_t p, int64_t us);
+void gate_metrics_transicion(int desde, int hacia);
+void gate_metrics_error(int code);
+void gate_metrics_reset(void);
+
+/**
+ * @brief Informe JSON compacto: versión de firmware, latencias (solo buckets hasta el último
+ *        no vacío), errores por código y transiciones no nulas.
+ * @param fw    Versión a incluir (esp_app_get_description()->version en el firmware).
+ * @param up_s  Segundos desde el arranque.
+ * @return Longitud escrita, o 0 si `cap` no alcanza.
+ */
+size_t gate_metrics_report(char *buf, size_t cap, const char *fw, uint32_t up_s);
@@ -0,0 +1,162 @@
+/**
+ * @file gate_ota.c
+ * @brief Descarga por bloques con esp_https_ota, espera de reposo y guardia de rollback.
+ */
+
+#include "gate_ota.h"
+
+#include <stdarg.h>
+#include <stdio.h>
+#include <string.h>
+
+#include "sdkconfig.h"
+#include "freertos/FreeRTOS.h"
+#include "freertos/task.h"
+#include "esp_crt_bundle.h"
+#include "esp_https_ota.h"
+#include "esp_log.h"
+#include "esp_ota_ops.h"
+#include "esp_system.h"
+#include "esp_timer.h"
+
+#include "stimer.h"
+
+static const char *TAG = "OTA";
+
+#ifdef CONFIG_SECURE_SIGNED_ON_UPDATE
+#define OTA_FIRMADA  1
+#else
+#define OTA_FIRMADA  0   // sin verificación de firma una URL basta para cambiar el firmware
+#endif
+
+static gate_ota_reposo_t s_reposo = NULL;
+static gate_ota_info_t   s_info = NULL;
+static char              s_url[OTA_URL_MAX];
+static volatile TaskHandle_t s_task = NULL;
+static bool              s_ocupado;        // pedido aceptado hasta que la tarea termina
+static stimer_t          s_t_rollback;
+static gate_ota_stats_t  s_st;
+
+static void informar(const char *fmt, ...) __attribute__((format(printf, 1, 2)));
+static void informar(const char *fmt, ...) {
+    char js[192];
+    va_list ap; va_start(ap, fmt);
+    int n = vsnprintf(js, sizeof(js), fmt, ap);
+    va_end(ap);
+    if (n > 0 && n < (int)sizeof(js) && s_info) s_info(js, (size_t)n);
+}
+
+// ------------------------------ ROLLBACK --------------------------------------
+/** @brief Venció el plazo sin broker: vuelve a la imagen anterior en cuanto los portones estén quietos. */
+static void on_rollback(void *arg) {
+    if (s_reposo && !s_reposo()) { stimer_armar(&s_t_rollback, OTA_REPOSO_POLL_MS, 0); return; }
+    ESP_LOGE(TAG, "La imagen nueva no llego al broker en %d s: rollback", OTA_VERIFICAR_MS / 1000);
+    esp_ota_mark_app_invalid_rollback_and_reboot();
+}
+
+void gate_ota_init(gate_ota_reposo_t reposo, gate_ota_info_t info) {
+    s_reposo = reposo; s_info = info;
+    esp_ota_img_states_t e;
+    const esp_partition_t *p = esp_ota_get_running_partition();
+    if (p && esp_ota_get_state_partition(p, &e) == ESP_OK && e == ESP_OTA_IMG_PENDING_VERIFY) {
+        s_st.pendiente = true;
+        stimer_crear(&s_t_rollback, on_rollback, NULL);
+        stimer_armar(&s_t_rollback, OTA_VERIFICAR_MS, 0);
+        ESP_LOGW(TAG, "Imagen '%s' a prueba en %s: %d s para conectar al broker", esp_app_get_description()->version, p->label, OTA_VERIFICAR_MS / 1000);
+    }
+}
+
+void gate_ota_confirmar(int64_t t_control_us, int64_t t_mqtt_us) {
+    if (!s_st.pendiente) return;
+    if (esp_ota_mark_app_valid_cancel_rollback() != ESP_OK) return;
+    stimer_cancelar(&s_t_rollback);
+    s_st.pendiente = false;
+    ESP_LOGI(TAG, "Imagen confirmada");
+    informar("{\"event\":\"confirmed\",\"version\":\"%s\",\"boot_to_control_ms\":%lu,\"boot_to_mqtt_ms\":%lu}",
+             esp_app_get_description()->version, (unsigned long)(t_control_us / 1000), (unsigned long)(t_mqtt_us / 1000));
+}
+
+// ------------------------------ DESCARGA --------------------------------------
+bool gate_ota_pedir(const char *url, size_t len) {
+    if (!OTA_FIRMADA) { ESP_LOGW(TAG, "OTA rechazada: firmware sin verificacion de firma (CONFIG_SECURE_SIGNED_ON_UPDATE)"); return false; }
+    if (!url || len < 9 || len >= sizeof(s_url) || strncmp(url, "https://", 8)) return false;
+    if (__atomic_exchange_n(&s_ocupado, true, __ATOMIC_ACQ_REL)) return false;
+    memcpy(s_url, url, len); s_url[len] = '\0';
+    TaskHandle_t t = s_task;
+    if (t) xTaskNotifyGive(t);   // si la tarea todavía no corrió, ve s_url al empezar
+    return true;
+}
+
+/** @brief Baja la imagen a la partición libre; ESP_OK si quedó lista para arrancar. */
+static esp_err_t descargar(void) {
+    esp_http_client_config_t http = {
+        .url = s_url, .crt_bundle_attach = esp_crt_bundle_attach, .timeout_ms = 15000,
+        .buffer_size = OTA_BLOQUE, .keep_alive_enable = true,
+    };
+    esp_https_ota_config_t cfg = { .http_config = &http };
+    esp_https_ota_handle_t h = NULL;
+    s_st.bytes = s_st.kbps = 0;
+    int64_t t0 = esp_timer_get_time();
+    esp_err_t err = esp_https_ota_begin(&cfg, &h);
+    if (err != ESP_OK) return err;
+
+    esp_app_desc_t d;
+    if (esp_https_ota_get_img_desc(h, &d) == ESP_OK) {
+        int total = esp_https_ota_get_image_size(h);
+        ESP_LOGI(TAG, "Bajando '%s' (%d bytes) desde %s", d.version, total, s_url);
+        informar("{\"event\":\"start\",\"version\":\"%s\",\"size\":%d}", d.version, total);
+    }
+    int siguiente = OTA_INFORME_BYTES;
+    while ((err = esp_https_ota_perform(h)) == ESP_ERR_HTTPS_OTA_IN_PROGRESS) {
+        int leidos = esp_https_ota_get_image_len_read(h);
+        if (leidos >= siguiente) {
+            siguiente = leidos + OTA_INFORME_BYTES;
+            int64_t dt = esp_timer_get_time() - t0;
+            informar("{\"event\":\"progress\",\"bytes\":%d,\"kbps\":%lu}", leidos, (unsigned long)(dt > 0 ? (int64_t)leidos * 1000 / dt : 0));
+        }
+    }
+    s_st.bytes = (uint32_t)esp_https_ota_get_image_len_read(h);
+    int64_t dt = esp_timer_get_time() - t0;
+    s_st.kbps = (uint32_t)(dt > 0 ? (int64_t)s_st.bytes * 1000 / dt : 0);
+    if (err != ESP_OK || !esp_https_ota_is_complete_data_received(h)) {
+        esp_https_ota_abort(h);
+        return err != ESP_OK ? err : ESP_FAIL;
+    }
+    err = esp_https_ota_finish(h);   // valida la imagen (y su firma) y la deja como partición de arranque
+    if (err == ESP_OK)
+        informar("{\"event\":\"ready\",\"bytes\":%lu,\"kbps\":%lu,\"ms\":%lu}", (unsigned long)s_st.bytes, (unsigned long)s_st.kbps, (unsigned long)(dt / 1000));
+    return err;
+}
+
+void gate_ota_task(void *arg) {
+    s_task = xTaskGetCurrentTaskHandle();
+    while (1) {
+        if (!s_url[0]) ulTaskNotifyTake(pdTRUE, portMAX_DELAY);
+        if (!s_url[0]) continue;
+        s_st.intentos++;
+        esp_err_t err = descargar();
+        s_url[0] = '\0';
+        if (err != ESP_OK) {
+            s_st.fallidos++;
+            ESP_LOGE(TAG, "OTA fallida: %s", esp_err_to_name(err));
+            informar("{\"event\":\"failed\",\"err\":\"%s\",\"bytes\":%lu}", esp_err_to_name(err), (unsigned long)s_st.bytes);
+            __atomic_store_n(&s_ocupado, false, __ATOMIC_RELEASE);
+            continue;
+        }
+        // El cambio de imagen espera a que ningún portón esté en recorrido
+        bool avisado = false;
+        while (1) {
+            while (s_reposo && !s_reposo()) {
+                if (!avisado) { informar("{\"event\":\"waiting_rest\"}"); avisado = true; }
+                vTaskDelay(pdMS_TO_TICKS(OTA_REPOSO_POLL_MS));
+            }
+            informar("{\"event\":\"rebooting\"}");
+            vTaskDelay(pdMS_TO_TICKS(200));   // deja salir el informe
+            if (!s_reposo || s_reposo()) break;  // un comando pudo arrancar el motor mientras tanto
+        }
+        ESP_LOGW(TAG, "Reiniciando en la imagen nueva");
+        esp_restart();
+    }
+}
+
+void gate_ota_get_stats(gate_ota_stats_t *st) { *st = s_st; }
@@ -0,0 +1,60 @@
+/**
+ * @file gate_ota.h
+ * @brief Actualización por HTTPS a la partición OTA libre, con cambio solo en reposo y rollback.
+ *
+ * La imagen se baja con esp_https_ota en bloques de OTA_BLOQUE bytes que se escriben directo en
+ * la partición inactiva (nunca está entera en RAM). La tarea OTA tiene menos prioridad que la FSM,
+ * MQTT y el portal, así que el control del portón sigue igual durante la descarga.
+ * Terminada y verificada la imagen, el reinicio espera a que ningún portón tenga el motor en marcha.
+ *
+ * La imagen nueva arranca "pendiente de verificar" (CONFIG_BOOTLOADER_APP_ROLLBACK_ENABLE): si en
+ * OTA_VERIFICAR_MS no llega a MQTT_EVENT_CONNECTED, se vuelve a la anterior (también en reposo).
+ * Se pide publicando la URL https en "<cmd>/ota"; los informes salen en "<tele>/ota".
+ * El que puede publicar en el tópico de comandos no debe poder instalar cualquier cosa: sin
+ * CONFIG_SECURE_SIGNED_ON_UPDATE (ver sdkconfig.defaults) todo pedido se rechaza; con él,
+ * esp_https_ota_finish() solo acepta imágenes firmadas con la clave del proyecto.
+ *
+ * Informes (JSON, por el callback): progreso y caudal de descarga, resultado y, tras el cambio,
+ * arranque -> control local y arranque -> MQTT de la imagen nueva.
+ */
+#pragma once
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+
+#define OTA_URL_MAX          256
+#define OTA_BLOQUE           4096                // bloque de descarga/escritura (un sector de flash)
+#define OTA_INFORME_BYTES    (64 * 1024)         // progreso cada tanto bajado
+#define OTA_VERIFICAR_MS     (3 * 60 * 1000)     // la imagen nueva tiene este tiempo para llegar al broker
+#define OTA_REPOSO_POLL_MS   500
+
+/** @brief true si se puede reiniciar ya (ningún motor en marcha). Cualquier tarea. */
+typedef bool (*gate_ota_reposo_t)(void);
+/** @brief Publica un informe JSON (corre en la tarea OTA o en la esp_timer). */
+typedef void (*gate_ota_info_t)(const char *json, size_t len);
+
+typedef struct {
+    uint32_t intentos;
+    uint32_t fallidos;
+    uint32_t bytes;          // del último intento
+    uint32_t kbps;           // caudal medio del último intento (kB/s)
+    bool     pendiente;      // esta imagen todavía no se confirmó
+} gate_ota_stats_t;
+
+/** @brief Al arrancar (con stimer ya iniciado): si la imagen está a prueba arma el rollback. */
+void gate_ota_init(gate_ota_reposo_t reposo, gate_ota_info_t info);
+
+/** @brief Copia la URL y despierta a la tarea. false si ya hay una actualización en curso. */
+bool gate_ota_pedir(const char *url, size_t len);
+
+/** @brief Tarea OTA: espera pedidos. Crear una vez (ver STACK_OTA / PRIO_OTA). */
+void gate_ota_task(void *arg);
+
+/**
+ * @brief Llamar en MQTT_EVENT_CONNECTED: confirma la imagen a prueba y cancela el rollback.
+ * @param t_control_us  arranque -> FSM activa; @param t_mqtt_us arranque -> broker.
+ */
+void gate_ota_confirmar(int64_t t_control_us, int64_t t_mqtt_us);
+
+void gate_ota_get_stats(gate_ota_stats_t *st);
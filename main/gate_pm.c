@@ -0,0 +1,139 @@
+/**
+ * @file gate_pm.c
+ * @brief Locks de esp_pm según el estado del portón y contabilidad de tiempo/corriente por estado.
+ */
+
+#include "gate_pm.h"
+
+#include <stdint.h>
+#include <stdio.h>
+
+#include "esp_log.h"
+#include "esp_timer.h"
+#include "esp_wifi.h"
+#include "freertos/FreeRTOS.h"
+
+#include "gate_fsm.h"
+
+#if GATE_PM_LIGHT_SLEEP
+#include "esp_pm.h"
+#include "esp_sleep.h"
+#endif
+#if PM_ISENSE_CANAL >= 0
+#include "esp_adc/adc_oneshot.h"
+#include "stimer.h"
+#endif
+
+static const char *TAG = "GATE_PM";
+
+typedef struct {
+    uint64_t t_us;        // tiempo acumulado en el estado
+    uint64_t ua_suma;     // suma de muestras de corriente (µA)
+    uint32_t muestras;
+} pm_acum_t;
+
+static pm_acum_t s_acum[GATE_NUM_ESTADOS];
+static portMUX_TYPE s_mux = portMUX_INITIALIZER_UNLOCKED;   // el muestreo corre en la tarea de esp_timer
+static int s_estado = ESTADO_INICIAL;
+static int64_t s_t_desde_us = 0;
+static bool s_despierto = false;
+
+#if GATE_PM_LIGHT_SLEEP
+static esp_pm_lock_handle_t s_lock_cpu = NULL, s_lock_sleep = NULL;
+#endif
+
+static inline bool en_recorrido(int e) { return e == ESTADO_ABRIENDO || e == ESTADO_CERRANDO; }
+
+// ------------------------------ CORRIENTE -------------------------------------
+#if PM_ISENSE_CANAL >= 0
+static adc_oneshot_unit_handle_t s_adc = NULL;
+static stimer_t s_t_isense;
+
+static void on_isense(void *arg) {
+    int raw;
+    if (adc_oneshot_read(s_adc, PM_ISENSE_CANAL, &raw) != ESP_OK) return;
+    // 12 bits sobre ~3,1 V a 12 dB; sin calibración alcanza para comparar estados
+    uint64_t ua = (uint64_t)raw * 3100000ULL / 4095ULL * 1000ULL / PM_ISENSE_UV_POR_MA;
+    portENTER_CRITICAL(&s_mux);
+    s_acum[s_estado].ua_suma += ua;
+    s_acum[s_estado].muestras++;
+    portEXIT_CRITICAL(&s_mux);
+}
+
+static void isense_init(void) {
+    const adc_oneshot_unit_init_cfg_t ucfg = { .unit_id = ADC_UNIT_1 };
+    const adc_oneshot_chan_cfg_t ccfg = { .atten = ADC_ATTEN_DB_12, .bitwidth = ADC_BITWIDTH_12 };
+    if (adc_oneshot_new_unit(&ucfg, &s_adc) != ESP_OK || adc_oneshot_config_channel(s_adc, PM_ISENSE_CANAL, &ccfg) != ESP_OK) {
+        ESP_LOGW(TAG, "ADC de corriente no disponible");
+        return;
+    }
+    stimer_crear(&s_t_isense, on_isense, NULL);
+    stimer_periodico(&s_t_isense, PM_ISENSE_MS);
+}
+#endif
+
+// ------------------------------ API -------------------------------------------
+void gate_pm_init(void) {
+    s_t_desde_us = esp_timer_get_time();
+#if GATE_PM_LIGHT_SLEEP
+    const esp_pm_config_t cfg = { .max_freq_mhz = GATE_PM_MHZ_MAX, .min_freq_mhz = GATE_PM_MHZ_MIN, .light_sleep_enable = true };
+    esp_err_t err = esp_pm_configure(&cfg);
+    if (err == ESP_OK) err = esp_pm_lock_create(ESP_PM_CPU_FREQ_MAX, 0, "gate_cpu", &s_lock_cpu);
+    if (err == ESP_OK) err = esp_pm_lock_create(ESP_PM_NO_LIGHT_SLEEP, 0, "gate_mov", &s_lock_sleep);
+    if (err == ESP_OK) err = esp_sleep_enable_gpio_wakeup();
+    if (err != ESP_OK) ESP_LOGE(TAG, "esp_pm: %s", esp_err_to_name(err));
+    else               ESP_LOGI(TAG, "Light sleep automático (%d-%d MHz)", GATE_PM_MHZ_MIN, GATE_PM_MHZ_MAX);
+#endif
+#if PM_ISENSE_CANAL >= 0
+    isense_init();
+#endif
+}
+
+void gate_pm_wifi(void) {
+#if GATE_PM_LIGHT_SLEEP
+    // MIN_MODEM: la radio se enciende en cada DTIM del AP, sin listen_interval extra
+    esp_err_t err = esp_wifi_set_ps(WIFI_PS_MIN_MODEM);
+    if (err == ESP_OK) err = esp_sleep_enable_wifi_wakeup();
+    if (err != ESP_OK) ESP_LOGW(TAG, "modem sleep: %s", esp_err_to_name(err));
+#endif
+}
+
+void gate_pm_estado(int estado) {
+    if (estado < 0 || estado >= GATE_NUM_ESTADOS) estado = ESTADO_ERROR;
+    int64_t t = esp_timer_get_time();
+    portENTER_CRITICAL(&s_mux);
+    s_acum[s_estado].t_us += (uint64_t)(t - s_t_desde_us);
+    s_t_desde_us = t;
+    s_estado = estado;
+    portEXIT_CRITICAL(&s_mux);
+
+    bool despierto = en_recorrido(estado);
+    if (despierto == s_despierto) return;
+    s_despierto = despierto;
+#if GATE_PM_LIGHT_SLEEP
+    if (!s_lock_cpu || !s_lock_sleep) return;
+    if (despierto) { esp_pm_lock_acquire(s_lock_cpu); esp_pm_lock_acquire(s_lock_sleep); }
+    else           { esp_pm_lock_release(s_lock_sleep); esp_pm_lock_release(s_lock_cpu); }
+#endif
+}
+
+size_t gate_pm_json(char *buf, size_t cap) {
+    pm_acum_t a[GATE_NUM_ESTADOS];
+    int64_t t = esp_timer_get_time();
+    portENTER_CRITICAL(&s_mux);
+    for (int i = 0; i < GATE_NUM_ESTADOS; i++) a[i] = s_acum[i];
+    a[s_estado].t_us += (uint64_t)(t - s_t_desde_us);
+    portEXIT_CRITICAL(&s_mux);
+
+    int n = snprintf(buf, cap, "{\"sleep\":%s,\"awake\":%s,\"states\":{", GATE_PM_LIGHT_SLEEP ? "true" : "false", s_despierto ? "true" : "false");
+    for (int i = 0; i < GATE_NUM_ESTADOS && n > 0 && (size_t)n < cap; i++) {
+        if (!a[i].t_us) continue;
+        n += snprintf(buf + n, cap - n, "%s\"%s\":{\"t_s\":%lu", buf[n - 1] == '{' ? "" : ",", estado_str(i), (unsigned long)(a[i].t_us / 1000000ULL));
+        if ((size_t)n >= cap) break;
+        if (a[i].muestras) n += snprintf(buf + n, cap - n, ",\"ma\":%lu.%01lu", (unsigned long)(a[i].ua_suma / a[i].muestras / 1000ULL),
+                                         (unsigned long)(a[i].ua_suma / a[i].muestras % 1000ULL / 100ULL));
+        if ((size_t)n < cap) n += snprintf(buf + n, cap - n, "}");
+    }
+    if (n > 0 && (size_t)n < cap) n += snprintf(buf + n, cap - n, "}}");
+    return (n > 0 && (size_t)n < cap) ? (size_t)n : 0;
+}
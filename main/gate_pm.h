@@ -0,0 +1,48 @@
+/**
+ * @file gate_pm.h
+ * @brief Bajo consumo: light sleep automático en reposo, CPU al máximo solo durante el recorrido.
+ *
+ * Con CONFIG_PM_ENABLE y CONFIG_FREERTOS_USE_TICKLESS_IDLE el idle entra solo en light sleep
+ * mientras ningún portón se mueve. Despiertan los finales de carrera (GPIO, ver ls_debounce) y
+ * el WiFi en modem sleep, que escucha cada DTIM del AP: un comando MQTT entrante o el keepalive
+ * llegan sin perder la sesión. Durante un recorrido se toman un lock de CPU al máximo y otro que
+ * impide el sleep, así la FSM y el deadline corren con la latencia de siempre.
+ *
+ * Opcionalmente se mide la corriente con un shunt + amplificador a un canal ADC y se reporta el
+ * promedio por estado. Sin PM todo esto queda en no-ops salvo la contabilidad de tiempo.
+ */
+#pragma once
+
+#include <stdbool.h>
+#include <stddef.h>
+
+#include "sdkconfig.h"
+
+#if defined(CONFIG_PM_ENABLE) && defined(CONFIG_FREERTOS_USE_TICKLESS_IDLE)
+#define GATE_PM_LIGHT_SLEEP  1
+#else
+#define GATE_PM_LIGHT_SLEEP  0
+#endif
+
+#define GATE_PM_MHZ_MAX      240
+#define GATE_PM_MHZ_MIN      80     // APB a 80 MHz: el WiFi no admite menos
+
+// Medición de corriente (ADC1). -1 = sin sensor.
+#define PM_ISENSE_CANAL      -1
+#define PM_ISENSE_UV_POR_MA  500    // salida del amplificador: µV por mA (shunt 0,1 Ω × ganancia 5)
+#define PM_ISENSE_MS         1000   // periodo de muestreo; el filtro RC del amplificador promedia los ciclos de sleep
+
+/** @brief Configura DFS/light sleep, crea los locks y el despertar por GPIO. Antes de crear tareas de red. */
+void gate_pm_init(void);
+
+/** @brief Modem sleep con despertar en cada DTIM. Llamar después de esp_wifi_start() en modo STA. */
+void gate_pm_wifi(void);
+
+/**
+ * @brief Estado agregado del equipo (el de un portón en recorrido, si hay, o el del primero).
+ *        En recorrido toma los locks; al volver a reposo los suelta. Solo desde la tarea de la FSM.
+ */
+void gate_pm_estado(int estado);
+
+/** @brief JSON con tiempo y corriente media por estado desde el arranque; devuelve la longitud o 0. */
+size_t gate_pm_json(char *buf, size_t cap);
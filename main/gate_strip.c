@@ -0,0 +1,178 @@
+/**
+ * @file gate_strip.c
+ * @brief Cuadros por tabla, doble búfer y envío solo de lo que cambió (ver gate_strip.h).
+ */
+
+#include "gate_strip.h"
+
+#include <string.h>
+
+#include "freertos/FreeRTOS.h"
+#include "freertos/task.h"
+#include "esp_log.h"
+#include "esp_timer.h"
+#include "led_strip.h"
+
+#include "travel_model.h"
+
+static const char *TAG = "STRIP";
+
+#define STRIP_MAX_SEG  8
+
+typedef struct { uint8_t r, g, b; } rgb_t;
+
+// Color de cada estado a brillo máximo
+#define C(r, g, b) { (r) * GATE_STRIP_BRILLO / 255, (g) * GATE_STRIP_BRILLO / 255, (b) * GATE_STRIP_BRILLO / 255 }
+static const rgb_t k_color[GATE_NUM_ESTADOS] = {
+    [ESTADO_INICIAL]     = C(255, 255, 255),
+    [ESTADO_ERROR]       = C(255,   0,   0),
+    [ESTADO_ABRIENDO]    = C(255, 160,   0),
+    [ESTADO_ABIERTO]     = C(  0, 255,   0),
+    [ESTADO_CERRANDO]    = C(255, 160,   0),
+    [ESTADO_CERRADO]     = C(  0,  40, 255),
+    [ESTADO_DETENIDO]    = C(255, 255,   0),
+    [ESTADO_DESCONOCIDO] = C(255, 255, 255),
+};
+static const rgb_t k_emergencia = C(255, 0, 0);
+#undef C
+
+// Respiración: ((1 - cos) / 2)^2,2 de 16 a 255, factor de 8 bits sobre el color
+static const uint8_t k_respira[GATE_STRIP_FASES] = {
+     16,  16,  16,  16,  16,  16,  17,  18,  19,  22,  25,  29,  34,  40,  48,  57,
+     68,  80,  93, 107, 122, 138, 153, 169, 185, 199, 213, 225, 235, 244, 250, 254,
+    255, 254, 250, 244, 235, 225, 213, 199, 185, 169, 153, 138, 122, 107,  93,  80,
+     68,  57,  48,  40,  34,  29,  25,  22,  19,  18,  17,  16,  16,  16,  16,  16,
+};
+#define FONDO  24   // factor del resto de la barra durante un recorrido
+
+// Lo que la FSM publicó de cada portón
+typedef struct {
+    uint8_t      estado;
+    bool         emergencia;
+    int64_t      t0_us;      // inicio del recorrido en curso
+    travel_dir_t dir;        // modelo del sentido en curso (copia)
+} seg_t;
+
+static portMUX_TYPE s_mux = portMUX_INITIALIZER_UNLOCKED;   // s_seg: lo escribe la FSM, lo lee la tarea
+static seg_t s_seg[STRIP_MAX_SEG];
+static led_strip_handle_t s_strip = NULL;
+static size_t s_n, s_n_gates, s_largo;
+static uint8_t s_frame[2][GATE_STRIP_MAX_LEDS * 3];   // r, g, b por píxel (led_strip lo pasa a GRB)
+static uint8_t s_frente;                               // búfer que está en la tira
+static volatile TaskHandle_t s_task = NULL;
+static gate_strip_stats_t s_st;
+
+esp_err_t gate_strip_iniciar(int pin, size_t n_leds, size_t n_gates) {
+    if (!n_gates || n_gates > STRIP_MAX_SEG || n_leds < n_gates || n_leds > GATE_STRIP_MAX_LEDS) return ESP_ERR_INVALID_ARG;
+    led_strip_config_t sc = { .strip_gpio_num = pin, .max_leds = n_leds, .led_pixel_format = LED_PIXEL_FORMAT_GRB, .led_model = LED_MODEL_WS2812 };
+    led_strip_rmt_config_t rc = { .clk_src = RMT_CLK_SRC_DEFAULT, .resolution_hz = GATE_STRIP_RMT_HZ, .flags.with_dma = true };
+    esp_err_t err = led_strip_new_rmt_device(&sc, &rc, &s_strip);
+    s_st.dma = err == ESP_OK;
+    if (err != ESP_OK) {   // RMT sin DMA (p.ej. ESP32): el driver recarga los símbolos por interrupción
+        rc.flags.with_dma = false;
+        if ((err = led_strip_new_rmt_device(&sc, &rc, &s_strip)) != ESP_OK) { s_strip = NULL; return err; }
+    }
+    s_n = n_leds; s_n_gates = n_gates; s_largo = n_leds / n_gates;
+    for (size_t k = 0; k < n_gates; k++) s_seg[k] = (seg_t){ .estado = ESTADO_INICIAL };
+    led_strip_clear(s_strip);   // la tira queda como los dos búferes: apagada
+    ESP_LOGI(TAG, "%u LEDs en GPIO %d, %u por porton (%s)", (unsigned)n_leds, pin, (unsigned)s_largo, s_st.dma ? "RMT+DMA" : "RMT");
+    return ESP_OK;
+}
+
+void gate_strip_estado(const gate_t *g) {
+    if (!s_strip || g->id >= s_n_gates) return;
+    seg_t s = { .estado = (uint8_t)g->estado, .emergencia = g->emergencia, .t0_us = g->rec_t0_us };
+    if (g->estado == ESTADO_ABRIENDO || g->estado == ESTADO_CERRANDO)
+        s.dir = g->travel.dir[g->estado == ESTADO_ABRIENDO ? TRAVEL_ABRIR : TRAVEL_CERRAR];
+    portENTER_CRITICAL(&s_mux);
+    s_seg[g->id] = s;
+    portEXIT_CRITICAL(&s_mux);
+    TaskHandle_t t = s_task;
+    if (t) xTaskNotifyGive(t);
+}
+
+// ------------------------------ CUADRO ----------------------------------------
+static inline rgb_t escalar(rgb_t c, uint8_t k) { return (rgb_t){ (uint8_t)(c.r * k >> 8), (uint8_t)(c.g * k >> 8), (uint8_t)(c.b * k >> 8) }; }
+static inline void pintar(uint8_t *px, size_t desde, size_t hasta, rgb_t c) {
+    for (size_t i = desde; i < hasta; i++) { px[3 * i] = c.r; px[3 * i + 1] = c.g; px[3 * i + 2] = c.b; }
+}
+
+/** @brief Arma el segmento de un portón; true si está animado (hace falta otro cuadro). */
+static bool segmento(uint8_t *px, size_t largo, const seg_t *s, uint32_t fase, int64_t ahora) {
+    rgb_t c = k_color[s->estado < GATE_NUM_ESTADOS ? s->estado : ESTADO_DESCONOCIDO];
+    if (s->emergencia) {   // rojo alternado que avanza: no se confunde con ERROR
+        rgb_t a = k_emergencia, b = escalar(k_emergencia, FONDO);
+        size_t corr = fase / (GATE_STRIP_FASES / 8);
+        for (size_t i = 0; i < largo; i++) pintar(px, i, i + 1, ((i + corr) & 1) ? a : b);
+        return true;
+    }
+    switch (s->estado) {
+        case ESTADO_ERROR:
+            pintar(px, 0, largo, fase < GATE_STRIP_FASES / 2 ? c : (rgb_t){ 0 });
+            return true;
+        case ESTADO_INICIAL:
+        case ESTADO_DESCONOCIDO:
+            pintar(px, 0, largo, escalar(c, k_respira[fase]));
+            return true;
+        case ESTADO_ABRIENDO:
+        case ESTADO_CERRANDO: {
+            bool abre = s->estado == ESTADO_ABRIENDO;
+            pintar(px, 0, largo, escalar(c, FONDO));
+            int pct = travel_progreso(&s->dir, (uint32_t)((ahora - s->t0_us) / 1000), NULL);
+            if (pct < 0) {   // sin modelo todavía: un cometa en el sentido del recorrido
+                size_t cab = fase * largo / GATE_STRIP_FASES;
+                if (!abre) cab = largo - 1 - cab;
+                pintar(px, cab, cab + 1, c);
+                return true;
+            }
+            // Se llena al abrir y se vacía al cerrar; el borde late
+            size_t lleno = (size_t)pct * largo / 100;
+            if (!abre) lleno = largo - lleno;
+            pintar(px, 0, lleno, c);
+            if (lleno < largo) pintar(px, lleno, lleno + 1, escalar(c, k_respira[fase]));
+            return true;
+        }
+        default:
+            pintar(px, 0, largo, c);
+            return false;
+    }
+}
+
+/** @brief Pasa a led_strip solo los píxeles distintos del frente y transmite si hubo alguno. */
+static bool enviar(const uint8_t *atras, const uint8_t *frente) {
+    uint32_t cambios = 0;
+    for (size_t i = 0; i < s_n; i++) {
+        const uint8_t *p = atras + 3 * i;
+        if (!memcmp(p, frente + 3 * i, 3)) continue;
+        led_strip_set_pixel(s_strip, i, p[0], p[1], p[2]);
+        cambios++;
+    }
+    if (!cambios) { s_st.iguales++; return false; }
+    s_st.pixeles += cambios;
+    if (led_strip_refresh(s_strip) != ESP_OK) return false;   // el próximo cuadro vuelve a cargar lo que falte
+    s_st.enviados++;
+    return true;
+}
+
+void gate_strip_task(void *arg) {
+    s_task = xTaskGetCurrentTaskHandle();
+    uint32_t fase = 0;
+    while (1) {
+        seg_t seg[STRIP_MAX_SEG];
+        portENTER_CRITICAL(&s_mux);
+        memcpy(seg, s_seg, s_n_gates * sizeof(seg_t));
+        portEXIT_CRITICAL(&s_mux);
+
+        uint8_t *atras = s_frame[s_frente ^ 1];
+        int64_t ahora = esp_timer_get_time();
+        bool anima = false;
+        for (size_t k = 0; k < s_n_gates; k++) anima |= segmento(atras + 3 * k * s_largo, s_largo, &seg[k], fase, ahora);
+        s_st.cuadros++;
+        if (enviar(atras, s_frame[s_frente])) s_frente ^= 1;
+        fase = (fase + 1) % GATE_STRIP_FASES;
+        // Quieto: solo una transición despierta; animado: cuadro siguiente (o antes, si cambió algo)
+        ulTaskNotifyTake(pdTRUE, anima ? pdMS_TO_TICKS(GATE_STRIP_MS) : portMAX_DELAY);
+    }
+}
+
+void gate_strip_get_stats(gate_strip_stats_t *st) { *st = s_st; }
@@ -0,0 +1,48 @@
+/**
+ * @file gate_strip.h
+ * @brief Barra de estado WS2812 (varios píxeles por portón) por RMT con DMA y refresco por diferencia.
+ *
+ * La tira se reparte en partes iguales entre los portones. Cada segmento muestra el estado; en
+ * recorrido, el avance que estima travel_model como barra (se llena al abrir, se vacía al cerrar) y,
+ * sin modelo todavía, un cometa. ERROR parpadea y la emergencia queda en rojo alternado.
+ *
+ * Se arma cada cuadro en el búfer trasero y se compara con el que está en la tira: solo los píxeles
+ * distintos se pasan a led_strip y solo se transmite si hubo alguno. Las animaciones salen de una
+ * tabla precalculada (GATE_STRIP_FASES pasos): por cuadro se escala un color por segmento, no por
+ * píxel. Sin nada animado la tarea duerme hasta la próxima transición.
+ *
+ * Con DMA si el RMT del chip lo tiene (ESP32-S3 y posteriores); si no, RMT sin DMA con más símbolos.
+ */
+#pragma once
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+
+#include "esp_err.h"
+#include "gate_fsm.h"
+
+#define GATE_STRIP_MAX_LEDS  64
+#define GATE_STRIP_MS        20     // periodo mientras algo se anima (50 cuadros/s)
+#define GATE_STRIP_FASES     64     // pasos de la tabla de animación (un ciclo = 1,28 s)
+#define GATE_STRIP_BRILLO    64     // brillo máximo por canal (de 255): una barra entera a pleno consume mucho
+#define GATE_STRIP_RMT_HZ    (10 * 1000 * 1000)
+
+typedef struct {
+    uint32_t cuadros;        // cuadros armados
+    uint32_t enviados;       // transmitidos a la tira
+    uint32_t iguales;        // omitidos: sin píxeles distintos
+    uint32_t pixeles;        // píxeles cambiados en total
+    bool     dma;
+} gate_strip_stats_t;
+
+/** @brief Crea el canal RMT para `n_leds` píxeles en `pin`, repartidos entre `n_gates` portones. */
+esp_err_t gate_strip_iniciar(int pin, size_t n_leds, size_t n_gates);
+
+/** @brief Toma el estado del portón (llamar en cada transición, desde la tarea FSM). */
+void gate_strip_estado(const gate_t *g);
+
+/** @brief Tarea de la barra. Crear una vez tras gate_strip_iniciar() (ver STACK_STRIP / PRIO_STRIP). */
+void gate_strip_task(void *arg);
+
+void gate_strip_get_stats(gate_strip_stats_t *st);
@@ -0,0 +1,203 @@
+/**
+ * @file local_cmd.c
+ * @brief Socket UDP, verificación HMAC/secuencia, tabla de pares y ecos de estado.
+ */
+
+#include "local_cmd.h"
+
+#include <string.h>
+
+#include "freertos/FreeRTOS.h"
+#include "freertos/task.h"
+#include "esp_log.h"
+#include "esp_random.h"
+#include "esp_timer.h"
+#include "lwip/sockets.h"
+#include "mbedtls/md.h"
+
+#include "gate_wire.h"
+#include "nvs_cache.h"
+
+static const char *TAG = "LOCAL_CMD";
+
+#define NVS_KEY_LOCAL_CLAVE  "local_key"
+#define NVS_KEY_LOCAL_SEQ    "local_seq"
+#define CAB_LEN              6   // 'G', versión/tipo, seq
+
+typedef struct { struct sockaddr_in dir; int64_t visto_us; } par_t;
+
+static char s_clave[LOCAL_CLAVE_MAX];
+static uint32_t s_seq_rx;             // última secuencia aceptada
+static uint32_t s_seq_tx;
+static local_cmd_rx_t s_rx = NULL;
+static volatile int s_sock = -1;
+static par_t s_pares[LOCAL_PEERS];
+static portMUX_TYPE s_mux = portMUX_INITIALIZER_UNLOCKED;   // clave, pares y contadores
+static local_cmd_stats_t s_st;
+
+// ------------------------------ FIRMA -----------------------------------------
+static void hmac(const char *clave, const uint8_t *d, size_t n, uint8_t tag[LOCAL_TAG_LEN]) {
+    uint8_t full[32];
+    mbedtls_md_hmac(mbedtls_md_info_from_type(MBEDTLS_MD_SHA256), (const unsigned char *)clave, strlen(clave), d, n, full);
+    memcpy(tag, full, LOCAL_TAG_LEN);
+}
+
+/** @brief Comparación en tiempo constante. */
+static bool tag_igual(const uint8_t *a, const uint8_t *b) {
+    uint8_t x = 0;
+    for (int i = 0; i < LOCAL_TAG_LEN; i++) x |= a[i] ^ b[i];
+    return x == 0;
+}
+
+static inline void put_u32(uint8_t *p, uint32_t v) { p[0] = v; p[1] = v >> 8; p[2] = v >> 16; p[3] = v >> 24; }
+static inline uint32_t get_u32(const uint8_t *p) { return p[0] | (uint32_t)p[1] << 8 | (uint32_t)p[2] << 16 | (uint32_t)p[3] << 24; }
+
+/** @brief Arma cabecera + cuerpo (ya en pkt + CAB_LEN) + firma; devuelve la longitud total o 0. */
+static size_t sellar(uint8_t *pkt, local_tipo_t tipo, size_t cuerpo) {
+    char clave[LOCAL_CLAVE_MAX];
+    portENTER_CRITICAL(&s_mux);
+    memcpy(clave, s_clave, sizeof(clave));
+    uint32_t seq = ++s_seq_tx;
+    portEXIT_CRITICAL(&s_mux);
+    if (!clave[0] || !cuerpo || CAB_LEN + cuerpo + LOCAL_TAG_LEN > LOCAL_PKT_MAX) return 0;
+    pkt[0] = 'G';
+    pkt[1] = (uint8_t)(LOCAL_VERSION << 4 | tipo);
+    put_u32(pkt + 2, seq);
+    hmac(clave, pkt, CAB_LEN + cuerpo, pkt + CAB_LEN + cuerpo);
+    return CAB_LEN + cuerpo + LOCAL_TAG_LEN;
+}
+
+// ------------------------------ PARES -----------------------------------------
+static void par_visto(const struct sockaddr_in *d, int64_t t) {
+    portENTER_CRITICAL(&s_mux);
+    int libre = 0;
+    for (int i = 0; i < LOCAL_PEERS; i++) {
+        par_t *p = &s_pares[i];
+        if (p->visto_us && p->dir.sin_addr.s_addr == d->sin_addr.s_addr && p->dir.sin_port == d->sin_port) { libre = i; break; }
+        if (p->visto_us < s_pares[libre].visto_us) libre = i;   // si no está, reemplaza al más viejo
+    }
+    s_pares[libre].dir = *d;
+    s_pares[libre].visto_us = t;
+    portEXIT_CRITICAL(&s_mux);
+}
+
+// ------------------------------ API -------------------------------------------
+void local_cmd_init(local_cmd_rx_t rx) {
+    s_rx = rx;
+    size_t len = sizeof(s_clave);
+    if (nvs_cache_get_str(NVS_KEY_LOCAL_CLAVE, s_clave, &len) != ESP_OK) s_clave[0] = '\0';
+    if (nvs_cache_get_u32(NVS_KEY_LOCAL_SEQ, &s_seq_rx) != ESP_OK) s_seq_rx = 0;
+    s_seq_tx = esp_random();   // los pares deduplican por secuencia; no hace falta continuidad entre arranques
+}
+
+void local_cmd_set_clave(const char *clave) {
+    portENTER_CRITICAL(&s_mux);
+    strncpy(s_clave, clave, sizeof(s_clave) - 1);
+    s_clave[sizeof(s_clave) - 1] = '\0';
+    s_seq_rx = 0;
+    memset(s_pares, 0, sizeof(s_pares));
+    portEXIT_CRITICAL(&s_mux);
+    nvs_cache_set_str(NVS_KEY_LOCAL_CLAVE, s_clave);
+    nvs_cache_set_u32(NVS_KEY_LOCAL_SEQ, 0);
+}
+
+bool local_cmd_activo(void) { return s_clave[0] != '\0'; }
+
+/** @brief Valida un datagrama de comando; devuelve la longitud del cuerpo o -1. */
+static int verificar(const uint8_t *pkt, int n, uint32_t *seq) {
+    if (n < CAB_LEN + 1 + LOCAL_TAG_LEN || pkt[0] != 'G' || pkt[1] != (LOCAL_VERSION << 4 | LOCAL_T_CMD)) return -1;
+    char clave[LOCAL_CLAVE_MAX];
+    portENTER_CRITICAL(&s_mux);
+    memcpy(clave, s_clave, sizeof(clave));
+    portEXIT_CRITICAL(&s_mux);
+    if (!clave[0]) return -1;
+    uint8_t tag[LOCAL_TAG_LEN];
+    hmac(clave, pkt, (size_t)n - LOCAL_TAG_LEN, tag);
+    if (!tag_igual(tag, pkt + n - LOCAL_TAG_LEN)) return -1;
+    *seq = get_u32(pkt + 2);
+    return n - CAB_LEN - LOCAL_TAG_LEN;
+}
+
+static void responder_ack(const struct sockaddr_in *d, uint32_t seq_cmd, bool ok) {
+    uint8_t pkt[LOCAL_PKT_MAX];
+    gw_writer_t w; gw_writer_init(&w, pkt + CAB_LEN, sizeof(pkt) - CAB_LEN - LOCAL_TAG_LEN);
+    gw_map(&w, 2);
+    gw_put_int(&w, GW_K_ERR, ok ? 0 : 1);
+    gw_put_uint(&w, GW_K_CMD, seq_cmd);   // secuencia del comando que se contesta
+    size_t n = sellar(pkt, LOCAL_T_ACK, gw_writer_len(&w));
+    if (n) sendto(s_sock, pkt, n, MSG_DONTWAIT, (const struct sockaddr *)d, sizeof(*d));
+}
+
+void local_cmd_task(void *arg) {
+    int s = socket(AF_INET, SOCK_DGRAM, IPPROTO_UDP);
+    struct sockaddr_in a = { .sin_family = AF_INET, .sin_port = htons(LOCAL_CMD_PORT), .sin_addr.s_addr = htonl(INADDR_ANY) };
+    if (s < 0 || bind(s, (struct sockaddr *)&a, sizeof(a)) < 0) {
+        ESP_LOGE(TAG, "No se pudo abrir UDP %d", LOCAL_CMD_PORT);
+        if (s >= 0) close(s);
+        vTaskDelete(NULL);
+        return;
+    }
+    s_sock = s;
+    ESP_LOGI(TAG, "Comandos locales en UDP %d (%s)", LOCAL_CMD_PORT, local_cmd_activo() ? "con clave" : "sin clave: apagado");
+
+    static uint8_t pkt[LOCAL_PKT_MAX];
+    while (1) {
+        struct sockaddr_in de; socklen_t dl = sizeof(de);
+        int n = (int)recvfrom(s, pkt, sizeof(pkt), 0, (struct sockaddr *)&de, &dl);
+        if (n <= 0) continue;
+        int64_t t = esp_timer_get_time();
+        uint32_t seq;
+        int cuerpo = verificar(pkt, n, &seq);
+
+        portENTER_CRITICAL(&s_mux);
+        s_st.recibidos++;
+        bool nuevo = cuerpo > 0 && (int32_t)(seq - s_seq_rx) > 0;
+        if (cuerpo <= 0)  s_st.firma_mala++;
+        else if (!nuevo)  s_st.repetidos++;
+        else              { s_seq_rx = seq; s_st.aceptados++; }
+        portEXIT_CRITICAL(&s_mux);
+        if (!nuevo) continue;   // sin respuesta: no se le confirma nada a quien no tiene la clave
+
+        // A flash antes de ejecutar: con el commit diferido, un corte de luz dejaba repetir lo último
+        nvs_cache_set_u32(NVS_KEY_LOCAL_SEQ, seq);
+        nvs_cache_flush();
+        par_visto(&de, t);
+        bool ok = s_rx && s_rx(pkt + CAB_LEN, (size_t)cuerpo, t);
+        responder_ack(&de, seq, ok);
+    }
+}
+
+void local_cmd_estado(const gate_t *g) {
+    if (s_sock < 0 || !local_cmd_activo()) return;
+    uint8_t pkt[LOCAL_PKT_MAX];
+    // Mismo contenido que gate_cbor_estado() más el índice de portón (los pares ven todos)
+    gw_writer_t w; gw_writer_init(&w, pkt + CAB_LEN, sizeof(pkt) - CAB_LEN - LOCAL_TAG_LEN);
+    gw_map(&w, 7);
+    gw_put_uint(&w, GW_K_GATE, g->id);
+    gw_put_uint(&w, GW_K_STATE, (uint32_t)((g->estado >= 0 && g->estado < GATE_NUM_ESTADOS) ? g->estado : GATE_NUM_ESTADOS));
+    gw_put_bool(&w, GW_K_LSA, g->lsa != 0);
+    gw_put_bool(&w, GW_K_LSC, g->lsc != 0);
+    gw_put_bool(&w, GW_K_MOTOR_OPEN, g->motorA != 0);
+    gw_put_bool(&w, GW_K_MOTOR_CLOSE, g->motorC != 0);
+    gw_put_int(&w, GW_K_ERR, g->error_code);
+    size_t n = sellar(pkt, LOCAL_T_ESTADO, gw_writer_len(&w));
+    if (!n) return;
+
+    par_t pares[LOCAL_PEERS];
+    int64_t t = esp_timer_get_time();
+    portENTER_CRITICAL(&s_mux);
+    memcpy(pares, s_pares, sizeof(pares));
+    portEXIT_CRITICAL(&s_mux);
+    for (int i = 0; i < LOCAL_PEERS; i++) {
+        if (!pares[i].visto_us || t - pares[i].visto_us > (int64_t)LOCAL_PEER_TTL_MS * 1000) continue;
+        if (sendto(s_sock, pkt, n, MSG_DONTWAIT, (const struct sockaddr *)&pares[i].dir, sizeof(pares[i].dir)) > 0) {
+            portENTER_CRITICAL(&s_mux); s_st.ecos++; portEXIT_CRITICAL(&s_mux);
+        }
+    }
+}
+
+void local_cmd_get_stats(local_cmd_stats_t *st) {
+    portENTER_CRITICAL(&s_mux);
+    *st = s_st;
+    portEXIT_CRITICAL(&s_mux);
+}
@@ -0,0 +1,61 @@
+/**
+ * @file local_cmd.h
+ * @brief Canal de comandos en la LAN (UDP autenticado) que no pasa por el broker.
+ *
+ * Un control o teclado en la misma red manda datagramas a LOCAL_CMD_PORT; cada uno lleva un
+ * número de secuencia creciente y un HMAC-SHA256 (truncado a LOCAL_TAG_LEN) con la clave
+ * compartida que se carga en el portal. El cuerpo es el mismo CBOR de gate_wire que acepta
+ * "<cmd>/cbor", así que entra a cmd_sched por el mismo camino que un comando MQTT, sin depender
+ * de internet. El que manda un comando válido queda como par durante LOCAL_PEER_TTL_MS y recibe,
+ * también firmados, el ACK y cada cambio de estado. MQTT sigue publicando aparte (pub_ring).
+ *
+ * Datagrama: 'G' | versión<<4 | tipo | seq (u32 LE) | cuerpo CBOR | HMAC[LOCAL_TAG_LEN]
+ * La secuencia aceptada se escribe en NVS (nvs_cache_flush, antes de ejecutar el comando): tras
+ * reiniciar, aun por un corte de luz, no se aceptan repeticiones.
+ */
+#pragma once
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+
+#include "gate_fsm.h"
+
+#define LOCAL_CMD_PORT      3334
+#define LOCAL_CLAVE_MAX     64          // con '\0'; vacía = canal apagado
+#define LOCAL_TAG_LEN       16
+#define LOCAL_PKT_MAX       128
+#define LOCAL_PEERS         4
+#define LOCAL_PEER_TTL_MS   (10 * 60 * 1000)
+
+#define LOCAL_VERSION       1
+typedef enum { LOCAL_T_CMD = 0, LOCAL_T_ACK = 1, LOCAL_T_ESTADO = 2 } local_tipo_t;
+
+/**
+ * @brief Recibe el cuerpo CBOR ya autenticado. Devuelve true si se aceptó (va en el ACK).
+ * @note Corre en la tarea local_cmd.
+ */
+typedef bool (*local_cmd_rx_t)(const uint8_t *cbor, size_t len, int64_t t_rx_us);
+
+typedef struct {
+    uint32_t recibidos;     // datagramas leídos
+    uint32_t aceptados;
+    uint32_t firma_mala;    // HMAC incorrecto o formato inválido
+    uint32_t repetidos;     // secuencia no mayor a la última aceptada
+    uint32_t ecos;          // estados enviados a pares
+} local_cmd_stats_t;
+
+/** @brief Carga clave y última secuencia de NVS. Antes de crear la tarea. */
+void local_cmd_init(local_cmd_rx_t rx);
+
+/** @brief Cambia la clave (portal) y la guarda; "" apaga el canal. La secuencia vuelve a empezar. */
+void local_cmd_set_clave(const char *clave);
+bool local_cmd_activo(void);
+
+/** @brief Tarea: socket UDP y lazo de recepción. Crear una vez, con la red ya inicializada. */
+void local_cmd_task(void *arg);
+
+/** @brief Manda el estado del portón a los pares vigentes (tarea FSM, no bloquea). */
+void local_cmd_estado(const gate_t *g);
+
+void local_cmd_get_stats(local_cmd_stats_t *st);
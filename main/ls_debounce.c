@@ -0,0 +1,121 @@
+/**
+ * @file ls_debounce.c
+ * @brief Motor de antirrebote ISR + esp_timer para los finales de carrera.
+ */
+
+#include "ls_debounce.h"
+
+#include "esp_log.h"
+#include "esp_rom_sys.h"
+
+static const char *TAG = "LS";
+
+static inline uint32_t ls_muestrear(const ls_debounce_t *ls) {
+    // Ambos pines en la misma pasada: la pareja siempre corresponde al mismo instante
+    uint32_t b = 0;
+    if (gpio_get_level(ls->pin_lsa) == ls->nivel_activo) b |= LS_BIT_LSA;
+    if (gpio_get_level(ls->pin_lsc) == ls->nivel_activo) b |= LS_BIT_LSC;
+    return b;
+}
+
+static void IRAM_ATTR ls_arrancar(ls_debounce_t *ls) {
+    if (atomic_exchange(&ls->muestreando, 1)) return;   // ya hay muestreo en curso
+    ls->t_flanco_us = esp_timer_get_time();
+    esp_timer_start_periodic(ls->timer, LS_SAMPLE_US);
+}
+
+/**
+ * @brief Modo `despertar`: cada pin interrumpe (y despierta) al dejar el nivel confirmado en `snap`.
+ *        Se arma contra lo confirmado y no contra lo que lee ahora, así un cambio ocurrido tras la
+ *        última muestra dispara enseguida en vez de perderse.
+ */
+static void ls_armar_nivel(ls_debounce_t *ls) {
+    uint32_t s = atomic_load(&ls->snap);
+    int lsa = LS_SNAP_LSA(s) ? ls->nivel_activo : !ls->nivel_activo;
+    int lsc = LS_SNAP_LSC(s) ? ls->nivel_activo : !ls->nivel_activo;
+    gpio_wakeup_enable(ls->pin_lsa, lsa ? GPIO_INTR_LOW_LEVEL : GPIO_INTR_HIGH_LEVEL);
+    gpio_wakeup_enable(ls->pin_lsc, lsc ? GPIO_INTR_LOW_LEVEL : GPIO_INTR_HIGH_LEVEL);
+    gpio_intr_enable(ls->pin_lsa);
+    gpio_intr_enable(ls->pin_lsc);
+}
+
+static void IRAM_ATTR ls_isr(void *arg) {
+    ls_debounce_t *ls = (ls_debounce_t *)arg;
+    if (ls->despertar) { gpio_intr_disable(ls->pin_lsa); gpio_intr_disable(ls->pin_lsc); }   // por nivel: se repetiría
+    atomic_fetch_add(&ls->flancos_isr, 1);
+    ls_arrancar(ls);
+}
+
+static void ls_timer_cb(void *arg) {
+    ls_debounce_t *ls = (ls_debounce_t *)arg;
+    uint32_t muestra = ls_muestrear(ls);
+    uint32_t flancos = atomic_load(&ls->flancos_isr);
+
+    // Cualquier diferencia (o un rebote entre dos muestras) reinicia la ventana de estabilidad
+    if (muestra != ls->candidato || flancos != ls->flancos_vistos) {
+        ls->candidato = muestra;
+        ls->flancos_vistos = flancos;
+        ls->cuenta = 1;
+        return;
+    }
+    if (++ls->cuenta < ls->stable_samples) return;
+
+    esp_timer_stop(ls->timer);
+    atomic_store(&ls->muestreando, 0);
+
+    uint32_t prev = atomic_load(&ls->snap);
+    if ((prev & (LS_BIT_LSA | LS_BIT_LSC)) != muestra) {
+        uint32_t nuevo = ((LS_SNAP_SEQ(prev) + 1) << LS_SEQ_SHIFT) | muestra;
+        atomic_store(&ls->snap, nuevo);
+        if (ls->on_edge) ls->on_edge(nuevo, ls->arg);
+    }
+
+    // Un flanco llegado mientras se detenía el timer no debe perderse
+    if (atomic_load(&ls->flancos_isr) != flancos) ls_arrancar(ls);
+    else if (ls->despertar) ls_armar_nivel(ls);
+}
+
+esp_err_t ls_debounce_init(ls_debounce_t *ls) {
+    if (!ls || ls->stable_samples == 0) return ESP_ERR_INVALID_ARG;
+
+    const esp_timer_create_args_t targs = {
+        .callback = ls_timer_cb,
+        .arg = ls,
+        .dispatch_method = ESP_TIMER_TASK,
+        .name = "ls_debounce",
+    };
+    esp_err_t err = esp_timer_create(&targs, &ls->timer);
+    if (err != ESP_OK) return err;
+
+    // Estado inicial: mismo criterio de estabilidad, pero síncrono (solo en el arranque)
+    uint32_t cand = ls_muestrear(ls), cuenta = 1;
+    for (int i = 0; i < 200 && cuenta < ls->stable_samples; i++) {
+        esp_rom_delay_us(LS_SAMPLE_US);
+        uint32_t m = ls_muestrear(ls);
+        if (m == cand) cuenta++; else { cand = m; cuenta = 1; }
+    }
+    atomic_store(&ls->snap, cand);
+    atomic_store(&ls->muestreando, 0);
+    atomic_store(&ls->flancos_isr, 0);
+    ls->flancos_vistos = 0;
+    ls->candidato = cand;
+    ls->cuenta = 0;
+
+    err = gpio_install_isr_service(0);
+    if (err != ESP_OK && err != ESP_ERR_INVALID_STATE) return err;   // ya instalado: OK
+
+    if ((err = gpio_isr_handler_add(ls->pin_lsa, ls_isr, ls)) != ESP_OK) return err;
+    if ((err = gpio_isr_handler_add(ls->pin_lsc, ls_isr, ls)) != ESP_OK) return err;
+    if (ls->despertar) {
+        ls_armar_nivel(ls);
+    } else {
+        gpio_set_intr_type(ls->pin_lsa, GPIO_INTR_ANYEDGE);
+        gpio_set_intr_type(ls->pin_lsc, GPIO_INTR_ANYEDGE);
+        gpio_intr_enable(ls->pin_lsa);
+        gpio_intr_enable(ls->pin_lsc);
+    }
+
+    ESP_LOGI(TAG, "Antirrebote listo (LSA=%d LSC=%d, %u muestras de %d us%s)",
+             LS_SNAP_LSA(cand), LS_SNAP_LSC(cand), (unsigned)ls->stable_samples, LS_SAMPLE_US, ls->despertar ? ", despierta del sleep" : "");
+    return ESP_OK;
+}
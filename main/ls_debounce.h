@@ -0,0 +1,65 @@
+/**
+ * @file ls_debounce.h
+ * @brief Antirrebote por interrupción de los finales de carrera (LSA/LSC).
+ *
+ * Un flanco en cualquiera de los dos pines arranca un muestreo periódico con esp_timer.
+ * Ambos pines se leen en la misma pasada; cuando la pareja permanece igual durante
+ * `stable_samples` muestras seguidas se publica en una instantánea atómica y, si cambió,
+ * se llama a `on_edge`. Sin actividad en los pines no hay timer corriendo.
+ *
+ * Con `despertar` los pines además sacan al chip del light sleep. Como el despertar por GPIO
+ * solo existe por nivel (y gpio_wakeup_enable() pasa la interrupción a nivel), cada pin se arma
+ * para el nivel contrario al confirmado; la ISR apaga ambas interrupciones y se vuelven a armar al
+ * terminar el muestreo. En ese modo un rebote entre dos muestras no lo ve la ISR, solo el muestreo.
+ */
+#pragma once
+
+#include <stdint.h>
+#include <stdbool.h>
+#include <stdatomic.h>
+
+#include "driver/gpio.h"
+#include "esp_timer.h"
+#include "esp_err.h"
+
+#define LS_SAMPLE_US   1000          // periodo de muestreo mientras hay actividad en los pines
+
+// Formato de la instantánea: bits 0-1 = LSA/LSC activos, bits 8..31 = nº de flancos confirmados
+#define LS_BIT_LSA     (1u << 0)
+#define LS_BIT_LSC     (1u << 1)
+#define LS_SEQ_SHIFT   8
+#define LS_SNAP_LSA(s) (((s) & LS_BIT_LSA) != 0)
+#define LS_SNAP_LSC(s) (((s) & LS_BIT_LSC) != 0)
+#define LS_SNAP_SEQ(s) ((s) >> LS_SEQ_SHIFT)
+
+typedef void (*ls_edge_cb_t)(uint32_t snap, void *arg);
+
+typedef struct {
+    // Configuración (rellenar antes de ls_debounce_init)
+    gpio_num_t   pin_lsa;
+    gpio_num_t   pin_lsc;
+    int          nivel_activo;        // nivel eléctrico que significa "final de carrera pisado"
+    uint32_t     stable_samples;      // muestras iguales consecutivas para confirmar
+    bool         despertar;           // interrupción por nivel que despierta del light sleep
+    ls_edge_cb_t on_edge;             // se invoca desde la tarea de esp_timer
+    void        *arg;
+
+    // Estado interno
+    esp_timer_handle_t timer;
+    _Atomic uint32_t   muestreando;
+    _Atomic uint32_t   flancos_isr;   // flancos vistos por la ISR (para detectar rebotes entre muestras)
+    uint32_t           flancos_vistos;
+    uint32_t           candidato;
+    uint32_t           cuenta;
+    _Atomic uint32_t   snap;
+    volatile int64_t   t_flanco_us;   // primer flanco de la ráfaga en curso (para medir latencias)
+} ls_debounce_t;
+
+/**
+ * @brief Configura la interrupción de ambos pines, toma el estado inicial (bloquea unos ms)
+ *        y deja el motor de antirrebote armado.
+ */
+esp_err_t ls_debounce_init(ls_debounce_t *ls);
+
+/** @brief Última pareja LSA/LSC confirmada (lectura atómica, no bloquea). */
+static inline uint32_t ls_debounce_snapshot(ls_debounce_t *ls) { return atomic_load(&ls->snap); }
@@ -17,12 +17,12 @@
 #include "freertos/FreeRTOS.h"
 #include "freertos/task.h"
 #include "freertos/queue.h"
+#include "freertos/event_groups.h"
 
 #include "driver/gpio.h"
 
 #include "esp_log.h"
 #include "esp_event.h"
-#include "nvs.h"
 #include "nvs_flash.h"
 #include "esp_netif.h"
 #include "esp_netif_ip_addr.h"
@@ -30,24 +30,32 @@
 #include "mqtt_client.h"
 #include "esp_timer.h"
 #include "esp_system.h"
-#include "cJSON.h"
 #include "esp_http_server.h"
-
-// ------------------------------ ESTADOS ---------------------------------------
-#define ESTADO_INICIAL     0
-#define ESTADO_ERROR       1
-#define ESTADO_ABRIENDO    2
-#define ESTADO_ABIERTO     3
-#define ESTADO_CERRANDO    4
-#define ESTADO_CERRADO     5
-#define ESTADO_DETENIDO    6
-#define ESTADO_DESCONOCIDO 7
-
-#define ERR_OK                 0
-#define ERR_TIMEOUT_OPEN       1
-#define ERR_TIMEOUT_CLOSE      2
-#define ERR_LS_INCONSISTENT    3
-#define ERR_STATE_GUARDRAIL   99
+#include "esp_app_desc.h"
+#include "esp_heap_caps.h"
+
+#include "gate_fsm.h"
+#include "gate_hal_esp.h"
+#include "gate_json.h"
+#include "gate_cmd.h"
+#include "cmd_sched.h"
+#include "gate_metrics.h"
+#include "nvs_cache.h"
+#include "portal_tpl.h"
+#include "wifi_fast.h"
+#include "wifi_scan.h"
+#include "pub_ring.h"
+#include "tele_batch.h"
+#include "gate_wire.h"
+#include "task_plan.h"
+#include "task_report.h"
+#include "gate_pm.h"
+#include "stimer.h"
+#include "local_cmd.h"
+#include "portal_api.h"
+#include "gate_ota.h"
+#include "gate_strip.h"
+#include "alog.h"
 
 // ----------------------- CONFIGURACIÓN AJUSTABLE ------------------------------
 #define PIN_LSC        GPIO_NUM_35
@@ -55,22 +63,39 @@
 #define PIN_MOTOR_A    GPIO_NUM_13
 #define PIN_MOTOR_C    GPIO_NUM_12
 #define PIN_LAMP       GPIO_NUM_2
+#define PIN_STRIP      GPIO_NUM_4    // datos de la barra WS2812 (se reparte entre los portones)
+#define STRIP_LEDS     30            // 0 = sin barra
 
 #define LM_ACTIVO      0
 #define LM_NOACTIVO    (!LM_ACTIVO)
 
 #define T_OPEN_MS      15000
 #define T_CLOSE_MS     15000
-#define DEBOUNCE_MS    20
-#define PUB_PERIOD_MS  30000
+#define DEBOUNCE_MS    20            // ventana de estabilidad de LSA/LSC (muestreo cada LS_SAMPLE_US); el rebote mecánico dura ms
+#define PUB_PERIOD_MS  30000        // telemetría por defecto (configurable desde el portal)
+#define PUB_REPLAY_MS  50            // ritmo de vaciado del buffer offline tras reconectar
+#define PUB_REPLAY_LOTE 2            // registros por tick (=> 40 msg/s como máximo)
+#define MQTT_OUTBOX_MAX 8192        // bytes encolados sin enviar; lleno => lo siguiente va a pub_ring
+#define PROG_MS        500           // avance/ETA en "<tele>/progress" mientras hay recorrido
+#define SONDA_MS       100           // periodo de la sonda de retardo de la FSM (0 = sin sonda; con light sleep solo en recorrido)
+
+// Portones atendidos por esta placa (el índice 0 usa los tópicos tal cual, el resto "<topico>/<nombre>")
+#define GATE_COUNT     1
+static const gate_cfg_t k_gate_cfg[GATE_COUNT] = {
+    { .nombre = "porton1", .pin_lsa = PIN_LSA, .pin_lsc = PIN_LSC, .pin_motor_a = PIN_MOTOR_A, .pin_motor_c = PIN_MOTOR_C,
+      .pin_lamp = PIN_LAMP, .lm_activo = LM_ACTIVO, .debounce_ms = DEBOUNCE_MS, .t_open_ms = T_OPEN_MS, .t_close_ms = T_CLOSE_MS },
+};
 
 // ===================== Portal WiFi AP/STA + MQTT (sin defaults) =====================
 #define AP_SSID      "ESP_CONFIG_AP"
 #define AP_PASS      "12345678"
 #define AP_MAX_CONN  4
+#define FAST_IP_ESTATICA  0   // 1 = si el DHCP no responde tras asociar, reutilizar el último lease
+#define WIRE_CBOR         0   // estado/tele: 0 = JSON, 1 = JSON + CBOR en "<tópico>/cbor", 2 = solo CBOR
 
 // NVS keys
 #define NVS_NAMESPACE       "config"
+#define NVS_COMMIT_MS       5000     // máximo que un cambio no crítico espera en RAM
 #define NVS_KEY_WIFI_SSID   "wifi_ssid"
 #define NVS_KEY_WIFI_PASS   "wifi_pass"
 #define NVS_KEY_BOOTMODE    "boot_mode"
@@ -78,12 +103,22 @@
 #define NVS_KEY_TOPIC1      "topic1"   // CMD (suscripción)
 #define NVS_KEY_TOPIC2      "topic2"   // STATUS (publicación)
 #define NVS_KEY_TOPIC3      "topic3"   // TELE (publicación)
+#define NVS_KEY_TELE_MS     "tele_ms"  // periodo de telemetría / muestreo
+#define NVS_KEY_TELE_LOTE   "tele_lote"// muestras por lote (0 = documento completo)
+#define NVS_KEY_TELE_QOS    "tele_qos"
+#define NVS_KEY_TRAVEL      "travel%u" // travel_model_t por portón
+// Claves fijas: las 10 de arriba + NVS_KEY_FAST (wifi_fast.c) + clave y secuencia de local_cmd.c;
+// la caché no libera entradas, así que tiene que caber una travel%u por portón
+#define NVS_KEYS_FIJAS      13
+_Static_assert(NVS_KEYS_FIJAS + GATE_COUNT <= NVS_CACHE_MAX_KEYS, "NVS_CACHE_MAX_KEYS no alcanza para las claves de config");
+#define SUBTOPIC_OTA        "ota"      // "<cmd>/ota": URL https de la imagen nueva
 
 #define BOOTMODE_CONFIG_AP  0
 #define BOOTMODE_STA_ONLY   1
 
 static const char *TAG = "GATE";
 static esp_mqtt_client_handle_t g_client = NULL;
+static volatile bool g_mqtt_ok = false;   // lo escribe solo la tarea MQTT; la FSM no publica hasta que sea true
 
 // WiFi (variables configurables, SIN defaults)
 static char g_wifi_ssid_cfg[33] = "";
@@ -101,36 +136,81 @@ static char g_topic_cmd[96]    = "";   // suscripción
 static char g_topic_status[96] = "";   // publicación estado
 static char g_topic_tele[96]   = "";   // publicación tele
 
+// Telemetría: con lote 0 se publica el documento completo cada periodo (modo clásico);
+// con lote N se muestrea cada periodo y se manda un mensaje "<tele>/batch" cada N muestras
+#define TELE_MS_MIN  100
+#define TELE_MS_MAX  3600000
+static volatile uint32_t g_tele_ms   = PUB_PERIOD_MS;
+static volatile uint8_t  g_tele_lote = 0;
+static volatile uint8_t  g_tele_qos  = 1;
+
 // FSM/cola
-typedef enum {
-    CMD_NONE = 0,
-    CMD_OPEN,
-    CMD_CLOSE,
-    CMD_STOP,
-    CMD_TOGGLE,
-    CMD_LAMP_ON,
-    CMD_LAMP_OFF
-} gate_cmd_t;
-
-static QueueHandle_t q_cmd;
-static uint64_t g_last_pub_us = 0;
-static volatile int g_estado = ESTADO_INICIAL;
-static int g_estado_prev = -1;
-static int g_motorA = 0, g_motorC = 0;
-static int g_lsa = 0, g_lsc = 0;
-static int g_error_code = ERR_OK;
+static gate_t g_gates[GATE_COUNT];
+static gate_esp_t g_gates_hw[GATE_COUNT];   // GPIO/antirrebote/deadline de cada portón
+_Static_assert(GATE_COUNT <= CMD_SCHED_MAX_GATES, "GATE_COUNT excede CMD_SCHED_MAX_GATES");
+_Static_assert(GATE_COUNT <= PUB_RING_MAX_GATES, "GATE_COUNT excede PUB_RING_MAX_GATES");
+static TaskHandle_t g_fsm_task = NULL;
+static EventGroupHandle_t g_ev = NULL;
+static StaticEventGroup_t s_ev_buf;
+// Trabajos periódicos en la rueda compartida (components/stimer): solo ponen bits en g_ev
+static stimer_t g_t_tele;
+static stimer_t g_t_pub;                    // vaciado pausado de pub_ring
+static tele_batch_t s_tele_b[GATE_COUNT];   // solo la tarea FSM
+static stimer_t g_t_sonda;
+static volatile int64_t s_t_sonda_us = 0;   // cuándo la sonda puso EV_SONDA
+static stimer_t g_t_prog;
+static travel_model_t s_travel_nvs[GATE_COUNT];   // lo leído de NVS, hasta que la FSM lo toma
+static volatile uint32_t s_travel_nvs_ok = 0;     // portones con modelo leído
 
 static httpd_handle_t g_httpd = NULL;
 
-// Timeout conexión
-static TickType_t g_connect_start_tick = 0;
-static bool g_connect_timer_active = false;
+// Timeout conexión: sin IP en CONNECT_TO_MS se vuelve al AP de configuración
+#define CONNECT_TO_MS  30000
+static stimer_t g_t_conexion;
+
+// Credenciales nuevas del portal: se prueban en APSTA y solo con IP se guardan y se reinicia
+#define WIFI_PRUEBA_MS    15000
+#define WIFI_REINICIO_MS  1500    // deja responder al portal antes de reiniciar
+static char g_wifi_ssid_prueba[33], g_wifi_pass_prueba[65];
+static volatile bool g_wifi_probando = false;
+static stimer_t g_t_prueba, g_t_reinicio;
+static int64_t g_t_safe_us = 0;                      // arranque -> FSM evaluando finales de carrera
+static int64_t g_t_got_ip_us = 0, g_t_mqtt_us = 0;   // arranque -> IP / -> MQTT (primera vez)
+
+// Tareas propias (pila/TCB estáticos con TASK_PLAN_ESTATICO)
+#if TASK_PLAN_ESTATICO
+#define PILA_ESTATICA(n, bytes)  static StackType_t n##_pila[bytes]; static StaticTask_t n##_tcb
+#define PILA(n)                  n##_pila, &n##_tcb
+#else
+#define PILA_ESTATICA(n, bytes)
+#define PILA(n)                  NULL, NULL
+#endif
+PILA_ESTATICA(s_fsm, STACK_FSM);
+PILA_ESTATICA(s_net_boot, STACK_NET_BOOT);
+PILA_ESTATICA(s_local, STACK_LOCAL);
+PILA_ESTATICA(s_ota, STACK_OTA);
+PILA_ESTATICA(s_strip, STACK_STRIP);
+static TaskHandle_t g_ota_task = NULL;
+static TaskHandle_t g_strip_task = NULL;
+static TaskHandle_t g_local_task = NULL;
+static uint32_t s_mqtt_reinicios = 0;   // mqtt_restart() desde el arranque
+static TaskHandle_t crear_tarea(TaskFunction_t fn, const char *nombre, uint32_t pila, void *arg, UBaseType_t prio,
+                                BaseType_t core, StackType_t *buf, StaticTask_t *tcb) {
+#if TASK_PLAN_ESTATICO
+    return xTaskCreateStaticPinnedToCore(fn, nombre, pila, arg, prio, buf, tcb, core);
+#else
+    TaskHandle_t h = NULL;
+    xTaskCreatePinnedToCore(fn, nombre, pila, arg, prio, &h, core);
+    return h;
+#endif
+}
 
 // ---------- Prototipos ----------
 static void mqtt_init(void);
 static void mqtt_restart(void);
-static inline bool fetch_cmd(gate_cmd_t *out_cmd);
-static inline void tick_telemetria(void);
+static void gates_init(void);
+static void local_arrancar(void);
+static bool encolar_cmd(const char *data, size_t len, bool cbor, int64_t t_rx_us);
 static httpd_handle_t start_webserver(void);
 static esp_err_t root_get_handler(httpd_req_t *req);
 static esp_err_t root_post_handler(httpd_req_t *req);
@@ -173,60 +253,125 @@ static void url_decode_inplace(char *s) {
 }
 
 // ---------- NVS helpers ----------
+// Todo pasa por nvs_cache (un handle abierto; un set con el mismo valor no escribe flash).
+// La configuración se confirma al momento: puede cortarse la energía justo después del portal.
 static void save_boot_mode_to_nvs(uint8_t mode) {
-    nvs_handle_t h; if (nvs_open(NVS_NAMESPACE, NVS_READWRITE, &h) != ESP_OK) return;
-    nvs_set_u8(h, NVS_KEY_BOOTMODE, mode); nvs_commit(h); nvs_close(h);
+    nvs_cache_set_u8(NVS_KEY_BOOTMODE, mode); nvs_cache_flush();
     ESP_LOGI(TAG, "Boot mode -> %u", mode);
 }
 static void load_boot_mode_from_nvs(void) {
-    nvs_handle_t h; if (nvs_open(NVS_NAMESPACE, NVS_READONLY, &h) != ESP_OK) { g_boot_mode = BOOTMODE_CONFIG_AP; return; }
-    uint8_t m; if (nvs_get_u8(h, NVS_KEY_BOOTMODE, &m) == ESP_OK) g_boot_mode = m; else g_boot_mode = BOOTMODE_CONFIG_AP;
-    nvs_close(h); ESP_LOGI(TAG, "Boot mode NVS = %u", g_boot_mode);
+    uint8_t m; g_boot_mode = (nvs_cache_get_u8(NVS_KEY_BOOTMODE, &m) == ESP_OK) ? m : BOOTMODE_CONFIG_AP;
+    ESP_LOGI(TAG, "Boot mode NVS = %u", g_boot_mode);
 }
 static void save_wifi_creds_to_nvs(void) {
-    nvs_handle_t h; if (nvs_open(NVS_NAMESPACE, NVS_READWRITE, &h) != ESP_OK) return;
-    nvs_set_str(h, NVS_KEY_WIFI_SSID, g_wifi_ssid_cfg);
-    nvs_set_str(h, NVS_KEY_WIFI_PASS, g_wifi_pass_cfg);
-    nvs_commit(h); nvs_close(h); ESP_LOGI(TAG, "WiFi creds guardadas en NVS");
+    nvs_cache_set_str(NVS_KEY_WIFI_SSID, g_wifi_ssid_cfg);
+    nvs_cache_set_str(NVS_KEY_WIFI_PASS, g_wifi_pass_cfg);
+    nvs_cache_flush(); ESP_LOGI(TAG, "WiFi creds guardadas en NVS");
 }
 static void load_wifi_creds_from_nvs(void) {
-    nvs_handle_t h; if (nvs_open(NVS_NAMESPACE, NVS_READONLY, &h) != ESP_OK) { g_have_creds=false; return; }
-    size_t len=sizeof(g_wifi_ssid_cfg); if (nvs_get_str(h, NVS_KEY_WIFI_SSID, g_wifi_ssid_cfg, &len) != ESP_OK) g_wifi_ssid_cfg[0]=0;
-    len=sizeof(g_wifi_pass_cfg); if (nvs_get_str(h, NVS_KEY_WIFI_PASS, g_wifi_pass_cfg, &len) != ESP_OK) g_wifi_pass_cfg[0]=0;
-    nvs_close(h); g_have_creds = (g_wifi_ssid_cfg[0] != 0);
+    size_t len=sizeof(g_wifi_ssid_cfg); if (nvs_cache_get_str(NVS_KEY_WIFI_SSID, g_wifi_ssid_cfg, &len) != ESP_OK) g_wifi_ssid_cfg[0]=0;
+    len=sizeof(g_wifi_pass_cfg); if (nvs_cache_get_str(NVS_KEY_WIFI_PASS, g_wifi_pass_cfg, &len) != ESP_OK) g_wifi_pass_cfg[0]=0;
+    g_have_creds = (g_wifi_ssid_cfg[0] != 0);
 }
 static void save_mqtt_to_nvs(void) {
-    nvs_handle_t h; if (nvs_open(NVS_NAMESPACE, NVS_READWRITE, &h) != ESP_OK) return;
-    nvs_set_str(h, NVS_KEY_MQTT_URI, g_mqtt_uri);
-    nvs_set_str(h, NVS_KEY_TOPIC1,   g_topic_cmd);
-    nvs_set_str(h, NVS_KEY_TOPIC2,   g_topic_status);
-    nvs_set_str(h, NVS_KEY_TOPIC3,   g_topic_tele);
-    nvs_commit(h); nvs_close(h); ESP_LOGI(TAG, "MQTT (URI y topicos) guardados en NVS");
+    nvs_cache_set_str(NVS_KEY_MQTT_URI, g_mqtt_uri);
+    nvs_cache_set_str(NVS_KEY_TOPIC1,   g_topic_cmd);
+    nvs_cache_set_str(NVS_KEY_TOPIC2,   g_topic_status);
+    nvs_cache_set_str(NVS_KEY_TOPIC3,   g_topic_tele);
+    nvs_cache_flush(); ESP_LOGI(TAG, "MQTT (URI y topicos) guardados en NVS");
 }
 static void load_mqtt_from_nvs(void) {
-    nvs_handle_t h; if (nvs_open(NVS_NAMESPACE, NVS_READONLY, &h) != ESP_OK) return;
     size_t len;
-    len=sizeof(g_mqtt_uri);    nvs_get_str(h, NVS_KEY_MQTT_URI, g_mqtt_uri, &len);
-    len=sizeof(g_topic_cmd);   nvs_get_str(h, NVS_KEY_TOPIC1,   g_topic_cmd, &len);
-    len=sizeof(g_topic_status);nvs_get_str(h, NVS_KEY_TOPIC2,   g_topic_status, &len);
-    len=sizeof(g_topic_tele);  nvs_get_str(h, NVS_KEY_TOPIC3,   g_topic_tele, &len);
-    nvs_close(h);
+    len=sizeof(g_mqtt_uri);    nvs_cache_get_str(NVS_KEY_MQTT_URI, g_mqtt_uri, &len);
+    len=sizeof(g_topic_cmd);   nvs_cache_get_str(NVS_KEY_TOPIC1,   g_topic_cmd, &len);
+    len=sizeof(g_topic_status);nvs_cache_get_str(NVS_KEY_TOPIC2,   g_topic_status, &len);
+    len=sizeof(g_topic_tele);  nvs_cache_get_str(NVS_KEY_TOPIC3,   g_topic_tele, &len);
 }
+static void save_tele_to_nvs(void) {
+    nvs_cache_set_u32(NVS_KEY_TELE_MS, g_tele_ms);
+    nvs_cache_set_u8(NVS_KEY_TELE_LOTE, g_tele_lote);
+    nvs_cache_set_u8(NVS_KEY_TELE_QOS, g_tele_qos);
+    nvs_cache_flush(); ESP_LOGI(TAG, "Telemetria: %lu ms, lote %u, QoS %u", (unsigned long)g_tele_ms, g_tele_lote, g_tele_qos);
+}
+static void load_tele_from_nvs(void) {
+    uint32_t ms; uint8_t v;
+    if (nvs_cache_get_u32(NVS_KEY_TELE_MS, &ms) == ESP_OK && ms >= TELE_MS_MIN && ms <= TELE_MS_MAX) g_tele_ms = ms;
+    if (nvs_cache_get_u8(NVS_KEY_TELE_LOTE, &v) == ESP_OK && v <= TELE_LOTE_MAX) g_tele_lote = v;
+    if (nvs_cache_get_u8(NVS_KEY_TELE_QOS, &v) == ESP_OK && v <= 2) g_tele_qos = v;
+}
+/** @brief (Re)arranca el timer de telemetría con el periodo vigente (cualquier tarea). */
+static void tele_reprogramar(void) { stimer_periodico(&g_t_tele, g_tele_ms); }
 static void erase_all_creds_nvs(void) {
-    nvs_handle_t h; if (nvs_open(NVS_NAMESPACE, NVS_READWRITE, &h) != ESP_OK) return;
-    nvs_erase_key(h, NVS_KEY_WIFI_SSID);
-    nvs_erase_key(h, NVS_KEY_WIFI_PASS);
-    nvs_erase_key(h, NVS_KEY_MQTT_URI);
-    nvs_erase_key(h, NVS_KEY_TOPIC1);
-    nvs_erase_key(h, NVS_KEY_TOPIC2);
-    nvs_erase_key(h, NVS_KEY_TOPIC3);
-    nvs_set_u8(h, NVS_KEY_BOOTMODE, BOOTMODE_CONFIG_AP);
-    nvs_commit(h); nvs_close(h);
+    nvs_cache_erase(NVS_KEY_WIFI_SSID);
+    nvs_cache_erase(NVS_KEY_WIFI_PASS);
+    local_cmd_set_clave("");
+    nvs_cache_erase(NVS_KEY_MQTT_URI);
+    nvs_cache_erase(NVS_KEY_TOPIC1);
+    nvs_cache_erase(NVS_KEY_TOPIC2);
+    nvs_cache_erase(NVS_KEY_TOPIC3);
+    nvs_cache_set_u8(NVS_KEY_BOOTMODE, BOOTMODE_CONFIG_AP);
+    nvs_cache_flush();
     g_wifi_ssid_cfg[0]=0; g_wifi_pass_cfg[0]=0; g_have_creds=false;
     g_mqtt_uri[0]=0; g_topic_cmd[0]=0; g_topic_status[0]=0; g_topic_tele[0]=0;
     ESP_LOGW(TAG, "Credenciales WiFi/MQTT borradas de NVS.");
 }
 
+// ---------- Prueba de credenciales ----------
+static void sta_config_aplicar(const char *ssid, const char *pass, const wifi_scan_ap_t *ap) {
+    wifi_config_t sta_cfg = (wifi_config_t){0};
+    strncpy((char*)sta_cfg.sta.ssid, ssid, sizeof(sta_cfg.sta.ssid));
+    strncpy((char*)sta_cfg.sta.password, pass, sizeof(sta_cfg.sta.password));
+    sta_cfg.sta.threshold.authmode = strlen(pass) ? WIFI_AUTH_WPA2_PSK : WIFI_AUTH_OPEN;
+    if (ap) {   // visto en el barrido: directo a ese BSSID/canal, sin volver a barrer
+        sta_cfg.sta.bssid_set = true;
+        memcpy(sta_cfg.sta.bssid, ap->bssid, sizeof(ap->bssid));
+        sta_cfg.sta.channel = ap->canal;
+        sta_cfg.sta.scan_method = WIFI_FAST_SCAN;
+    }
+    esp_wifi_set_config(WIFI_IF_STA, &sta_cfg);
+}
+static void on_reinicio(void *arg) { esp_restart(); }
+static void wifi_prueba_iniciar(const char *ssid, const char *pass) {
+    strncpy(g_wifi_ssid_prueba, ssid, sizeof(g_wifi_ssid_prueba)-1);
+    strncpy(g_wifi_pass_prueba, pass, sizeof(g_wifi_pass_prueba)-1);
+    wifi_scan_ap_t ap; bool visto = wifi_scan_buscar(g_wifi_ssid_prueba, &ap);
+    g_wifi_probando = true;
+    stimer_cancelar(&g_t_conexion);   // la prueba tiene su propio plazo y no reinicia
+    wifi_scan_pausar(true);
+    esp_wifi_disconnect();
+    wifi_fast_on_disconnected();      // lo que dependa de la conexión anterior, ya (el evento se ignora)
+    sta_config_aplicar(g_wifi_ssid_prueba, g_wifi_pass_prueba, visto ? &ap : NULL);
+    esp_wifi_connect();
+    stimer_armar(&g_t_prueba, WIFI_PRUEBA_MS, 0);
+    if (visto) snprintf(g_status_msg, sizeof(g_status_msg), "Probando '%s' (canal %u, %d dBm)...", g_wifi_ssid_prueba, ap.canal, ap.rssi);
+    else       snprintf(g_status_msg, sizeof(g_status_msg), "Probando '%s' (no visto en el barrido)...", g_wifi_ssid_prueba);
+    ESP_LOGI(TAG, "Probando credenciales para '%s' (%s)", g_wifi_ssid_prueba, visto ? "dirigida" : "barrido");
+}
+/** @brief Cierra la prueba. Con IP: guarda y reinicia en STA. Si no, vuelve a lo que había. */
+static void wifi_prueba_fin(bool ok, const char *motivo) {
+    if (!__atomic_exchange_n(&g_wifi_probando, false, __ATOMIC_ACQ_REL)) return;   // evento WiFi y timeout pueden cruzarse
+    stimer_cancelar(&g_t_prueba);
+    wifi_scan_pausar(false);
+    if (ok) {
+        strncpy(g_wifi_ssid_cfg, g_wifi_ssid_prueba, sizeof(g_wifi_ssid_cfg)-1);
+        strncpy(g_wifi_pass_cfg, g_wifi_pass_prueba, sizeof(g_wifi_pass_cfg)-1);
+        g_have_creds = true;
+        save_wifi_creds_to_nvs();
+        save_boot_mode_to_nvs(BOOTMODE_STA_ONLY);
+        snprintf(g_status_msg, sizeof(g_status_msg), "'%s' OK (IP %s). Guardado; reiniciando...", g_wifi_ssid_cfg, g_sta_ip);
+        stimer_armar(&g_t_reinicio, WIFI_REINICIO_MS, 0);
+        return;
+    }
+    ESP_LOGW(TAG, "Prueba de '%s' fallida: %s", g_wifi_ssid_prueba, motivo);
+    snprintf(g_status_msg, sizeof(g_status_msg), "No se pudo conectar a '%s': %s. Nada se guardo.", g_wifi_ssid_prueba, motivo);
+    esp_wifi_disconnect();
+    if (g_have_creds) {   // la red anterior sigue siendo la configurada
+        sta_config_aplicar(g_wifi_ssid_cfg, g_wifi_pass_cfg, NULL);
+        esp_wifi_connect();
+    }
+}
+static void on_prueba_timeout(void *arg) { wifi_prueba_fin(false, "sin IP a tiempo"); }
+
 // ---------- Apl. de parámetros (reutilizable para GET y POST) ----------
 static void apply_wifi_from_kvstring(const char *kv) {
     char ssid[64]={0}, pass[64]={0};
@@ -239,24 +384,10 @@ static void apply_wifi_from_kvstring(const char *kv) {
 
         if (ssid[0] == '\0') {
             snprintf(g_status_msg, sizeof(g_status_msg), "SSID vacio. Ingrese un SSID valido.");
+        } else if (g_wifi_probando) {
+            snprintf(g_status_msg, sizeof(g_status_msg), "Ya se esta probando '%s'; espere el resultado.", g_wifi_ssid_prueba);
         } else {
-            strncpy(g_wifi_ssid_cfg, ssid, sizeof(g_wifi_ssid_cfg)-1);
-            strncpy(g_wifi_pass_cfg, pass, sizeof(g_wifi_pass_cfg)-1);
-            g_have_creds = true;
-            save_wifi_creds_to_nvs();
-
-            wifi_config_t sta_cfg = (wifi_config_t){0};
-            strncpy((char*)sta_cfg.sta.ssid, g_wifi_ssid_cfg, sizeof(sta_cfg.sta.ssid));
-            strncpy((char*)sta_cfg.sta.password, g_wifi_pass_cfg, sizeof(sta_cfg.sta.password));
-            sta_cfg.sta.threshold.authmode = strlen(g_wifi_pass_cfg) ? WIFI_AUTH_WPA2_PSK : WIFI_AUTH_OPEN;
-            esp_wifi_set_config(WIFI_IF_STA, &sta_cfg);
-
-            snprintf(g_status_msg, sizeof(g_status_msg), "Guardado WiFi. Conectando a '%s'...", g_wifi_ssid_cfg);
-            esp_wifi_disconnect();
-            esp_wifi_connect();
-            g_connect_start_tick = xTaskGetTickCount();
-            g_connect_timer_active = true;
-            save_boot_mode_to_nvs(BOOTMODE_CONFIG_AP); // Mantener AP hasta obtener IP
+            wifi_prueba_iniciar(ssid, pass);   // nada va a NVS hasta tener IP
         }
     } else {
         snprintf(g_status_msg, sizeof(g_status_msg), "Falta el parametro SSID.");
@@ -288,7 +419,128 @@ static void apply_mqtt_from_kvstring(const char *kv) {
     snprintf(g_status_msg, sizeof(g_status_msg), "Parametros MQTT actualizados.");
 }
 
+static void apply_local_from_kvstring(const char *kv) {
+    char k[LOCAL_CLAVE_MAX * 3] = {0};   // url-encoded
+    if (httpd_query_key_value(kv, "lk", k, sizeof(k)) != ESP_OK) return;
+    url_decode_inplace(k);
+    if (!k[0]) return;                   // vacío = sin cambios (la clave no se muestra)
+    if (!strcmp(k, "-")) k[0] = '\0';    // "-" apaga el canal
+    local_cmd_set_clave(k);
+    local_arrancar();
+    snprintf(g_status_msg, sizeof(g_status_msg), "Comandos locales: %s.", k[0] ? "clave actualizada" : "apagados");
+}
+
+static void apply_tele_from_kvstring(const char *kv) {
+    char v[16];
+    if (httpd_query_key_value(kv, "tp", v, sizeof(v)) == ESP_OK && v[0]) {
+        long ms = strtol(v, NULL, 10);
+        if (ms >= TELE_MS_MIN && ms <= TELE_MS_MAX) g_tele_ms = (uint32_t)ms;
+    }
+    if (httpd_query_key_value(kv, "tn", v, sizeof(v)) == ESP_OK && v[0]) {
+        long n = strtol(v, NULL, 10);
+        if (n >= 0 && n <= TELE_LOTE_MAX) g_tele_lote = (uint8_t)n;
+    }
+    if (httpd_query_key_value(kv, "tq", v, sizeof(v)) == ESP_OK && v[0]) {
+        long q = strtol(v, NULL, 10);
+        if (q >= 0 && q <= 2) g_tele_qos = (uint8_t)q;
+    }
+    save_tele_to_nvs();
+    tele_reprogramar();
+    snprintf(g_status_msg, sizeof(g_status_msg), "Telemetria: %lu ms, lote %u, QoS %u.", (unsigned long)g_tele_ms, g_tele_lote, g_tele_qos);
+}
+
 // ---------- HTTP portal (GET) ----------
+// Página en flash; los {{marcadores}} se rellenan (escapados) al enviar
+static const char k_portal_html[] =
+    "<!DOCTYPE html><html><head><meta charset='UTF-8'><title>Config ESP32</title></head><body>"
+    "<h2>Porton Automatico</h2>"
+    "<p><b>Mensaje:</b> {{msg}}</p>"
+    "<hr><h3>WiFi (STA)</h3>"
+    "<p>SSID actual: {{ssid_txt}}</p>"
+    "<p>Conectado: {{conectado}}</p>"
+    "<p>IP STA: {{ip}}</p>"
+    // -------- ESTADO EN VIVO (/ws, comandos por /api/cmd) --------
+    "<hr><h3>Estado</h3><div id='gs'>(sin datos)</div>"
+    "<script>"
+    "var S=[];"
+    "function pinta(){var h='';S.forEach(function(s){if(!s)return;"
+    "h+='<p><b>'+s.name+'</b>: '+s.state+' LSA='+s.lsa_open+' LSC='+s.lsc_closed+' err='+s.err+' ';"
+    "['OPEN','CLOSE','STOP'].forEach(function(c){h+='<button onclick=\"cmd('+s.gate+',&quot;'+c+'&quot;)\">'+c+'</button> '});"
+    "h+='</p>'});document.getElementById('gs').innerHTML=h||'(sin datos)'}"
+    "function cmd(g,c){fetch('/api/cmd',{method:'POST',body:JSON.stringify({cmd:c,gate:g})}).then(function(r){if(r.status==403)alert('Comandos solo con el AP de configuracion')})}"
+    "function ws(){var w=new WebSocket('ws://'+location.host+'/ws');"
+    "w.onmessage=function(e){var s=JSON.parse(e.data);S[s.gate]=s;pinta()};"
+    "w.onclose=function(){setTimeout(ws,2000)}}"
+    "fetch('/api/status').then(function(r){return r.json()}).then(function(a){a.forEach(function(s){S[s.gate]=s});pinta()});ws();"
+    "fetch('/api/scan').then(function(r){return r.json()}).then(function(s){var d=document.getElementById('aps');"
+    "s.aps.forEach(function(a){var o=document.createElement('option');o.value=a.ssid;o.label=a.rssi+' dBm, canal '+a.ch;d.appendChild(o)});"
+    "document.getElementById('apn').textContent=s.aps.length+' redes cerca'});"
+    "</script>"
+    // -------- FORM SOLO WIFI (act=wifi) -> POST --------
+    "<form action='/' method='POST'>"
+    "<input type='hidden' name='act' value='wifi'>"
+    "<fieldset><legend>Red WiFi</legend>"
+    "SSID: <input name='ssid' value='{{ssid}}' list='aps' required>"
+    "<datalist id='aps'></datalist> <span id='apn'></span><br><br>"
+    "Password: <input type='password' name='pass'><br>"
+    "</fieldset><br>"
+    "<button type='submit'>Guardar WiFi</button>"
+    "</form>"
+    // -------- FORM SOLO MQTT (act=mqtt) -> POST --------
+    "<br><form action='/' method='POST'>"
+    "<input type='hidden' name='act' value='mqtt'>"
+    "<fieldset><legend>MQTT</legend>"
+    "Broker (URI): <input name='broker' value='{{broker}}' placeholder='mqtt://host:1883' style='width:360px'><br><br>"
+    "Topico 1 (CMD - suscripcion): <input name='t1' value='{{t1}}' style='width:360px'><br><br>"
+    "Topico 2 (STATUS - publicacion): <input name='t2' value='{{t2}}' style='width:360px'><br><br>"
+    "Topico 3 (TELE - publicacion): <input name='t3' value='{{t3}}' style='width:360px'><br>"
+    "</fieldset><br>"
+    "<button type='submit'>Guardar MQTT</button>"
+    "</form>"
+    // -------- FORM TELEMETRIA (act=tele) -> POST --------
+    "<br><form action='/' method='POST'>"
+    "<input type='hidden' name='act' value='tele'>"
+    "<fieldset><legend>Telemetria</legend>"
+    "Periodo / muestreo (ms): <input name='tp' type='number' min='{{tp_min}}' max='{{tp_max}}' value='{{tp}}'><br><br>"
+    "Muestras por lote (0 = documento completo): <input name='tn' type='number' min='0' max='{{tn_max}}' value='{{tn}}'><br><br>"
+    "QoS: <input name='tq' type='number' min='0' max='2' value='{{tq}}'><br>"
+    "</fieldset><br>"
+    "<button type='submit'>Guardar telemetria</button>"
+    "</form>"
+    // -------- FORM COMANDOS LOCALES (act=local) -> POST --------
+    "<br><form action='/' method='POST'>"
+    "<input type='hidden' name='act' value='local'>"
+    "<fieldset><legend>Comandos locales (UDP {{lport}})</legend>"
+    "Activos: {{lk_on}}<br><br>"
+    "Clave compartida (\"-\" = apagar): <input type='password' name='lk' maxlength='{{lk_max}}'><br>"
+    "</fieldset><br>"
+    "<button type='submit'>Guardar clave</button>"
+    "</form>"
+    // -------- BOTON BORRAR --------
+    "<hr><form action='/' method='GET'>"
+    "<input type='hidden' name='wipe' value='1'>"
+    "<button type='submit' style='background:#c00;color:#fff;padding:8px 12px;border:0;border-radius:6px;'>Borrar credenciales y volver a AP</button>"
+    "</form>"
+    "<p>AP de configuracion: SSID '{{ap_ssid}}' / pass '{{ap_pass}}' (activo solo si no hay conexion).</p>"
+    "</body></html>";
+
+// Bloques del tamaño de un segmento TCP
+#ifdef CONFIG_LWIP_TCP_MSS
+#define PORTAL_BLK CONFIG_LWIP_TCP_MSS
+#else
+#define PORTAL_BLK 1440
+#endif
+static char s_portal_blk[PORTAL_BLK];   // el servidor HTTP atiende de a una petición
+
+static int portal_out(void *ctx, const char *d, size_t n) {
+    while (n) {
+        int r = httpd_send((httpd_req_t *)ctx, d, n);
+        if (r <= 0) return -1;
+        d += r; n -= (size_t)r;
+    }
+    return 0;
+}
+
 static esp_err_t root_get_handler(httpd_req_t *req) {
     char query[512]; int qlen = httpd_req_get_url_query_len(req);
 
@@ -303,8 +555,7 @@ static esp_err_t root_get_handler(httpd_req_t *req) {
                 esp_wifi_restore();          // limpia config del driver
                 save_boot_mode_to_nvs(BOOTMODE_CONFIG_AP);
                 httpd_resp_set_type(req, "text/html");
-                httpd_resp_sendstr_chunk(req, "<html><body><h3>Credenciales borradas.</h3><p>Reiniciando...</p></body></html>");
-                httpd_resp_sendstr_chunk(req, NULL);
+                httpd_resp_sendstr(req, "<html><body><h3>Credenciales borradas.</h3><p>Reiniciando...</p></body></html>");
                 vTaskDelay(pdMS_TO_TICKS(250));
                 esp_restart();
                 return ESP_OK;
@@ -317,57 +568,59 @@ static esp_err_t root_get_handler(httpd_req_t *req) {
                     apply_wifi_from_kvstring(query);
                 } else if (!strcmp(act,"mqtt")) {
                     apply_mqtt_from_kvstring(query);
+                } else if (!strcmp(act,"tele")) {
+                    apply_tele_from_kvstring(query);
+                } else if (!strcmp(act,"local")) {
+                    apply_local_from_kvstring(query);
                 }
             }
         }
     }
 
-    // ------------------- HTML (chunked) -------------------
-    httpd_resp_set_type(req, "text/html");
-    httpd_resp_sendstr_chunk(req, "<!DOCTYPE html><html><head><meta charset='UTF-8'><title>Config ESP32</title></head><body>");
-    httpd_resp_sendstr_chunk(req, "<h2>Porton Automatico</h2>");
-
-    char buf[512];
-    snprintf(buf, sizeof(buf), "<p><b>Mensaje:</b> %s</p>", g_status_msg); httpd_resp_sendstr_chunk(req, buf);
-
-    const char *connected = g_wifi_connected ? "SI" : "NO";
-    httpd_resp_sendstr_chunk(req, "<hr><h3>WiFi (STA)</h3>");
-    snprintf(buf, sizeof(buf), "<p>SSID actual: %s</p>", g_wifi_ssid_cfg[0] ? g_wifi_ssid_cfg : "(no configurado)"); httpd_resp_sendstr_chunk(req, buf);
-    snprintf(buf, sizeof(buf), "<p>Conectado: %s</p>", connected); httpd_resp_sendstr_chunk(req, buf);
-    snprintf(buf, sizeof(buf), "<p>IP STA: %s</p>", g_wifi_connected ? g_sta_ip : "0.0.0.0"); httpd_resp_sendstr_chunk(req, buf);
-
-    // -------- FORM SOLO WIFI (act=wifi) -> POST --------
-    httpd_resp_sendstr_chunk(req, "<form action='/' method='POST'>");
-    httpd_resp_sendstr_chunk(req, "<input type='hidden' name='act' value='wifi'>");
-    httpd_resp_sendstr_chunk(req, "<fieldset><legend>Red WiFi</legend>");
-    snprintf(buf, sizeof(buf), "SSID: <input name='ssid' value='%s' required><br><br>", g_wifi_ssid_cfg); httpd_resp_sendstr_chunk(req, buf);
-    httpd_resp_sendstr_chunk(req, "Password: <input type='password' name='pass'><br>");
-    httpd_resp_sendstr_chunk(req, "</fieldset><br>");
-    httpd_resp_sendstr_chunk(req, "<button type='submit'>Guardar WiFi</button>");
-    httpd_resp_sendstr_chunk(req, "</form>");
-
-    // -------- FORM SOLO MQTT (act=mqtt) -> POST --------
-    httpd_resp_sendstr_chunk(req, "<br><form action='/' method='POST'>");
-    httpd_resp_sendstr_chunk(req, "<input type='hidden' name='act' value='mqtt'>");
-    httpd_resp_sendstr_chunk(req, "<fieldset><legend>MQTT</legend>");
-    snprintf(buf, sizeof(buf), "Broker (URI): <input name='broker' value='%s' placeholder='mqtt://host:1883' style='width:360px'><br><br>", g_mqtt_uri); httpd_resp_sendstr_chunk(req, buf);
-    snprintf(buf, sizeof(buf), "Topico 1 (CMD - suscripcion): <input name='t1' value='%s' style='width:360px'><br><br>", g_topic_cmd); httpd_resp_sendstr_chunk(req, buf);
-    snprintf(buf, sizeof(buf), "Topico 2 (STATUS - publicacion): <input name='t2' value='%s' style='width:360px'><br><br>", g_topic_status); httpd_resp_sendstr_chunk(req, buf);
-    snprintf(buf, sizeof(buf), "Topico 3 (TELE - publicacion): <input name='t3' value='%s' style='width:360px'><br>", g_topic_tele); httpd_resp_sendstr_chunk(req, buf);
-    httpd_resp_sendstr_chunk(req, "</fieldset><br>");
-    httpd_resp_sendstr_chunk(req, "<button type='submit'>Guardar MQTT</button>");
-    httpd_resp_sendstr_chunk(req, "</form>");
-
-    // -------- BOTON BORRAR --------
-    httpd_resp_sendstr_chunk(req, "<hr><form action='/' method='GET'>");
-    httpd_resp_sendstr_chunk(req, "<input type='hidden' name='wipe' value='1'>");
-    httpd_resp_sendstr_chunk(req, "<button type='submit' style='background:#c00;color:#fff;padding:8px 12px;border:0;border-radius:6px;'>Borrar credenciales y volver a AP</button>");
-    httpd_resp_sendstr_chunk(req, "</form>");
-
-    snprintf(buf, sizeof(buf), "<p>AP de configuracion: SSID '%s' / pass '%s' (activo solo si no hay conexion).</p>", AP_SSID, AP_PASS); httpd_resp_sendstr_chunk(req, buf);
-    httpd_resp_sendstr_chunk(req, "</body></html>");
-    httpd_resp_sendstr_chunk(req, NULL);
-
+    // ------------------- HTML (plantilla, una pasada) -------------------
+    char tp[12], tn[4], tq[2], tp_min[8], tp_max[12], tn_max[4], lport[8], lk_max[4];
+    snprintf(lport, sizeof(lport), "%d", LOCAL_CMD_PORT);
+    snprintf(lk_max, sizeof(lk_max), "%d", LOCAL_CLAVE_MAX - 1);
+    snprintf(tp, sizeof(tp), "%lu", (unsigned long)g_tele_ms);
+    snprintf(tn, sizeof(tn), "%u", g_tele_lote);
+    snprintf(tq, sizeof(tq), "%u", g_tele_qos);
+    snprintf(tp_min, sizeof(tp_min), "%d", TELE_MS_MIN);
+    snprintf(tp_max, sizeof(tp_max), "%d", TELE_MS_MAX);
+    snprintf(tn_max, sizeof(tn_max), "%d", TELE_LOTE_MAX);
+    const tpl_var_t vars[] = {
+        { "msg",      g_status_msg },
+        { "ssid_txt", g_wifi_ssid_cfg[0] ? g_wifi_ssid_cfg : "(no configurado)" },
+        { "conectado",g_wifi_connected ? "SI" : "NO" },
+        { "ip",       g_wifi_connected ? g_sta_ip : "0.0.0.0" },
+        { "ssid",     g_wifi_ssid_cfg },
+        { "broker",   g_mqtt_uri },
+        { "t1",       g_topic_cmd },
+        { "t2",       g_topic_status },
+        { "t3",       g_topic_tele },
+        { "tp",       tp },
+        { "tp_min",   tp_min },
+        { "tp_max",   tp_max },
+        { "tn",       tn },
+        { "tn_max",   tn_max },
+        { "tq",       tq },
+        { "lport",    lport },
+        { "lk_on",    local_cmd_activo() ? "SI" : "NO" },
+        { "lk_max",   lk_max },
+        { "ap_ssid",  AP_SSID },
+        { "ap_pass",  AP_PASS },
+    };
+    const size_t nv = sizeof(vars) / sizeof(vars[0]);
+
+    // Respuesta armada a mano: Content-Length exacto y la cabecera sale en el mismo segmento que el HTML
+    tpl_buf_t b = { s_portal_blk, sizeof(s_portal_blk), 0 };
+    int h = snprintf(b.p, b.cap, "HTTP/1.1 200 OK\r\nContent-Type: text/html; charset=UTF-8\r\n"
+                                 "Content-Length: %u\r\nCache-Control: no-store\r\n\r\n",
+                     (unsigned)tpl_longitud(k_portal_html, vars, nv));
+    b.n = (size_t)h;
+    if (tpl_render(k_portal_html, vars, nv, &b, portal_out, req) != 0) {
+        ESP_LOGW(TAG, "Portal: envio interrumpido");
+        return ESP_FAIL;   // cierra el socket
+    }
     return ESP_OK;
 }
 
@@ -397,6 +650,10 @@ static esp_err_t root_post_handler(httpd_req_t *req) {
             apply_wifi_from_kvstring(body);
         } else if (!strcmp(act, "mqtt")) {
             apply_mqtt_from_kvstring(body);
+        } else if (!strcmp(act, "tele")) {
+            apply_tele_from_kvstring(body);
+        } else if (!strcmp(act, "local")) {
+            apply_local_from_kvstring(body);
         }
     }
 
@@ -409,14 +666,21 @@ static esp_err_t root_post_handler(httpd_req_t *req) {
     return ESP_OK;
 }
 
+/** @brief Comandos sin firma por /api/cmd y /ws: solo con el AP de configuración (su clave WPA2 es la llave). */
+static bool portal_con_ap(void) { return g_ap_enabled; }
+
 static httpd_handle_t start_webserver(void) {
     httpd_config_t config = HTTPD_DEFAULT_CONFIG();
+    config.core_id       = CORE_NET;
+    config.task_priority = PRIO_HTTPD;
     httpd_handle_t server = NULL;
     if (httpd_start(&server, &config) == ESP_OK) {
         httpd_uri_t root_get = { .uri = "/", .method = HTTP_GET,  .handler = root_get_handler,  .user_ctx = NULL };
         httpd_uri_t root_post= { .uri = "/", .method = HTTP_POST, .handler = root_post_handler, .user_ctx = NULL };
         httpd_register_uri_handler(server, &root_get);
         httpd_register_uri_handler(server, &root_post);
+        portal_api_registrar(server, g_gates, GATE_COUNT, encolar_cmd, portal_con_ap);
+        wifi_scan_registrar(server);
         ESP_LOGI(TAG, "HTTP server en puerto %d", config.server_port);
     } else {
         ESP_LOGE(TAG, "No se pudo iniciar HTTP server");
@@ -432,14 +696,30 @@ static void wifi_event_handler(void* arg, esp_event_base_t base, int32_t id, voi
             if (g_have_creds) {
                 snprintf(g_status_msg, sizeof(g_status_msg), "Intentando conectar a '%s'...", g_wifi_ssid_cfg);
                 esp_wifi_connect();
-                g_connect_start_tick = xTaskGetTickCount();
-                g_connect_timer_active = true;
+                stimer_armar(&g_t_conexion, CONNECT_TO_MS, 0);
             }
             break;
+        case WIFI_EVENT_STA_CONNECTED:
+            wifi_fast_on_connected((wifi_event_sta_connected_t *)data);
+            break;
+        case WIFI_EVENT_SCAN_DONE:
+            wifi_scan_on_done();
+            break;
         case WIFI_EVENT_STA_DISCONNECTED: {
             wifi_event_sta_disconnected_t *disc = (wifi_event_sta_disconnected_t *)data;
             g_wifi_connected = false;
+            if (g_wifi_probando) {
+                switch (disc->reason) {
+                case WIFI_REASON_ASSOC_LEAVE: break;   // el esp_wifi_disconnect() que abrió la prueba
+                case WIFI_REASON_AUTH_FAIL: case WIFI_REASON_AUTH_EXPIRE:
+                case WIFI_REASON_4WAY_HANDSHAKE_TIMEOUT: case WIFI_REASON_HANDSHAKE_TIMEOUT:
+                    wifi_prueba_fin(false, "clave rechazada"); break;
+                default: esp_wifi_connect(); break;    // AP no visto, etc.: reintenta hasta el plazo
+                }
+                break;
+            }
             snprintf(g_status_msg, sizeof(g_status_msg), "Desconectado (razon %d). Reintentando...", disc->reason);
+            wifi_fast_on_disconnected();
             if (g_have_creds) esp_wifi_connect();
             break;
         }
@@ -449,40 +729,46 @@ static void wifi_event_handler(void* arg, esp_event_base_t base, int32_t id, voi
         ip_event_got_ip_t *ev = (ip_event_got_ip_t *)data;
         snprintf(g_sta_ip, sizeof(g_sta_ip), IPSTR, IP2STR(&ev->ip_info.ip));
         g_wifi_connected = true;
-        g_connect_timer_active = false;
+        stimer_cancelar(&g_t_conexion);
         snprintf(g_status_msg, sizeof(g_status_msg), "Conectado a '%s'. IP: %s", g_wifi_ssid_cfg, g_sta_ip);
+        wifi_fast_on_got_ip(&ev->ip_info);
+        if (!g_t_got_ip_us) {
+            g_t_got_ip_us = esp_timer_get_time();
+            ESP_LOGI(TAG, "IP a los %lu ms (%s%s)", (unsigned long)(g_t_got_ip_us / 1000), wifi_fast_dirigido() ? "dirigida" : "barrido",
+                     wifi_fast_ip_estatica() ? ", lease guardado" : "");
+        }
 
-        if (g_ap_enabled) { esp_wifi_set_mode(WIFI_MODE_STA); g_ap_enabled = false; }
+        if (g_wifi_probando) { wifi_prueba_fin(true, NULL); return; }   // el AP sigue hasta el reinicio
+        if (g_ap_enabled) { esp_wifi_set_mode(WIFI_MODE_STA); g_ap_enabled = false; wifi_scan_detener(); }
         save_boot_mode_to_nvs(BOOTMODE_STA_ONLY);
     }
 }
 
 // ---------- Timeout 30s ----------
-static void connect_timeout_task(void *arg) {
-    const TickType_t TO = pdMS_TO_TICKS(30000);
-    while (1) {
-        if (g_connect_timer_active && !g_wifi_connected) {
-            if ((xTaskGetTickCount() - g_connect_start_tick) > TO) {
-                ESP_LOGW(TAG, "Timeout 30s sin IP. Volviendo a modo configuracion...");
-                save_boot_mode_to_nvs(BOOTMODE_CONFIG_AP);
-                vTaskDelay(pdMS_TO_TICKS(200));
-                esp_restart();
-            }
-        }
-        vTaskDelay(pdMS_TO_TICKS(500));
-    }
+// Corre en la tarea de esp_timer; el modo queda en la caché NVS y esp_restart() la vacía
+static void on_connect_timeout(void *arg) {
+    if (g_wifi_connected || g_wifi_probando) return;
+    ESP_LOGW(TAG, "Timeout %ds sin IP. Volviendo a modo configuracion...", CONNECT_TO_MS / 1000);
+    save_boot_mode_to_nvs(BOOTMODE_CONFIG_AP);
+    esp_restart();
 }
 
 // ---------- Inicialización WiFi ----------
 static void wifi_init_sta(void) {
+    stimer_crear(&g_t_conexion, on_connect_timeout, NULL);
+    stimer_crear(&g_t_prueba, on_prueba_timeout, NULL);
+    stimer_crear(&g_t_reinicio, on_reinicio, NULL);
     ESP_ERROR_CHECK(esp_netif_init());
     ESP_ERROR_CHECK(esp_event_loop_create_default());
 
     load_wifi_creds_from_nvs();
     load_mqtt_from_nvs();
     load_boot_mode_from_nvs();
+    load_tele_from_nvs();
+    tele_reprogramar();
 
-    esp_netif_create_default_wifi_sta();
+    esp_netif_t *sta = esp_netif_create_default_wifi_sta();
+    wifi_fast_init(sta, g_wifi_ssid_cfg, FAST_IP_ESTATICA);
     if (g_boot_mode == BOOTMODE_CONFIG_AP || !g_have_creds) esp_netif_create_default_wifi_ap();
 
     wifi_init_config_t cfg = WIFI_INIT_CONFIG_DEFAULT();
@@ -506,131 +792,476 @@ static void wifi_init_sta(void) {
         ESP_ERROR_CHECK(esp_wifi_set_config(WIFI_IF_AP, &ap_cfg));
         g_ap_enabled = true;
         ESP_ERROR_CHECK(esp_wifi_start());
+        wifi_scan_iniciar();   // lista de redes para el portal, en segundo plano
         snprintf(g_status_msg, sizeof(g_status_msg), "Ingrese SSID, pass y parametros MQTT; luego Guardar.");
         ESP_LOGI(TAG, "AP de config: '%s' pass '%s' (http://192.168.4.1/)", AP_SSID, AP_PASS);
     } else {
         ESP_ERROR_CHECK(esp_wifi_set_mode(WIFI_MODE_STA));
         g_ap_enabled = false;
         ESP_ERROR_CHECK(esp_wifi_start());
+        gate_pm_wifi();   // modem sleep: solo en STA, el AP de config necesita la radio encendida
 
         if (g_have_creds) {
             wifi_config_t sta_cfg = { 0 };
             strncpy((char*)sta_cfg.sta.ssid, g_wifi_ssid_cfg, sizeof(sta_cfg.sta.ssid));
             strncpy((char*)sta_cfg.sta.password, g_wifi_pass_cfg, sizeof(sta_cfg.sta.password));
             sta_cfg.sta.threshold.authmode = strlen(g_wifi_pass_cfg) ? WIFI_AUTH_WPA2_PSK : WIFI_AUTH_OPEN;
+            wifi_fast_config(&sta_cfg);   // BSSID/canal de la última vez, si los hay
             ESP_ERROR_CHECK(esp_wifi_set_config(WIFI_IF_STA, &sta_cfg));
             snprintf(g_status_msg, sizeof(g_status_msg), "Intentando conectar a '%s' (desde NVS)...", g_wifi_ssid_cfg);
             esp_wifi_connect();
-            g_connect_start_tick = xTaskGetTickCount();
-            g_connect_timer_active = true;
+            stimer_armar(&g_t_conexion, CONNECT_TO_MS, 0);
         }
     }
 
     g_httpd = start_webserver();
-    xTaskCreate(connect_timeout_task, "connect_timeout_task", 4096, NULL, 5, NULL);
 }
 
 // ------------------------------ UTILIDADES / FSM ------------------------------
-static int debounce_read(gpio_num_t pin, int ms) {
-    const int step = 5;
-    int stable = gpio_get_level(pin);
-    int elapsed = 0;
-    while (elapsed < ms) {
-        vTaskDelay(pdMS_TO_TICKS(step));
-        int now = gpio_get_level(pin);
-        if (now != stable) { stable = now; elapsed = 0; } else { elapsed += step; }
-    }
-    return stable;
-}
-static inline void leer_sensores(void) {
-    g_lsa = (debounce_read(PIN_LSA, DEBOUNCE_MS) == LM_ACTIVO);
-    g_lsc = (debounce_read(PIN_LSC, DEBOUNCE_MS) == LM_ACTIVO);
-}
-static const char* estado_str(int e) {
-    switch (e) {
-        case ESTADO_INICIAL:     return "INICIAL";
-        case ESTADO_ERROR:       return "ERROR";
-        case ESTADO_ABRIENDO:    return "ABRIENDO";
-        case ESTADO_ABIERTO:     return "ABIERTO";
-        case ESTADO_CERRANDO:    return "CERRANDO";
-        case ESTADO_CERRADO:     return "CERRADO";
-        case ESTADO_DETENIDO:    return "DETENIDO";
-        case ESTADO_DESCONOCIDO: return "DESCONOCIDO";
-        default:                 return "???";
-    }
-}
-static inline void motor_stop(void)   { gpio_set_level(PIN_MOTOR_A, 0); gpio_set_level(PIN_MOTOR_C, 0); g_motorA=g_motorC=0; }
-static inline void motor_abrir(void)  { gpio_set_level(PIN_MOTOR_C, 0); vTaskDelay(pdMS_TO_TICKS(10)); gpio_set_level(PIN_MOTOR_A, 1); g_motorA=1; g_motorC=0; }
-static inline void motor_cerrar(void) { gpio_set_level(PIN_MOTOR_A, 0); vTaskDelay(pdMS_TO_TICKS(10)); gpio_set_level(PIN_MOTOR_C, 1); g_motorA=0; g_motorC=1; }
-static inline void lamp_on(bool on)   { gpio_set_level(PIN_LAMP, on ? 1 : 0); }
-
-static void publicar_json(const char *topic, bool include_mot, bool include_err) {
-    if (!g_client || !topic || !topic[0]) return;
-    cJSON *root = cJSON_CreateObject();
-    cJSON_AddStringToObject(root, "state", estado_str(g_estado));
-    cJSON_AddBoolToObject(root, "lsa_open", g_lsa);
-    cJSON_AddBoolToObject(root, "lsc_closed", g_lsc);
-    if (include_mot) {
-        cJSON_AddBoolToObject(root, "motor_open", g_motorA);
-        cJSON_AddBoolToObject(root, "motor_close", g_motorC);
-    }
-    if (include_err) cJSON_AddNumberToObject(root, "err", g_error_code);
-    char *js = cJSON_PrintUnformatted(root);
-    if (js) { esp_mqtt_client_publish(g_client, topic, js, 0, 1, 1); free(js); }
-    cJSON_Delete(root);
-}
-static inline void publicar_estado_si_cambia(void) {
-    if (g_estado != g_estado_prev) {
-        g_estado_prev = g_estado;
-        publicar_json(g_topic_status, true, true);
-        ESP_LOGI(TAG, "Estado => %s", estado_str(g_estado));
+static void on_timer_event(void *arg) { xEventGroupSetBits(g_ev, (EventBits_t)(uintptr_t)arg); }
+static void on_sonda(void *arg) { s_t_sonda_us = esp_timer_get_time(); xEventGroupSetBits(g_ev, EV_SONDA); }
+
+/**
+ * @brief Deja el mensaje en el outbox de esp-mqtt, que lo manda desde su propia tarea: la FSM nunca
+ *        espera al socket. Con el outbox lleno (MQTT_OUTBOX_MAX) devuelve < 0, igual que sin conexión.
+ */
+static inline int mqtt_pub(const char *topic, const char *data, int len, int qos, int retain) {
+    return esp_mqtt_client_enqueue(g_client, topic, data, len, qos, retain, true);
+}
+static const char *topic_gate(char *out, size_t n, const char *base, const gate_t *g) {
+    if (g->id == 0) return base;
+    snprintf(out, n, "%s/%s", base, g->cfg->nombre);
+    return out;
+}
+/**
+ * @brief Publica el documento del portón; `age_ms` >= 0 lo marca como repetido desde pub_ring.
+ * @return false si no quedó en el outbox (sin conexión, sin tópico u outbox lleno).
+ */
+static bool publicar_doc(const gate_t *g, const char *base, bool include_mot, bool include_err, int qos, long age_ms) {
+    if (!g_mqtt_ok || !base || !base[0]) return false;
+    char tbuf[128]; const char *topic = topic_gate(tbuf, sizeof(tbuf), base, g);
+#if WIRE_CBOR
+    uint8_t cb[GATE_CBOR_MAX]; char tc[136];
+    size_t nc = gate_cbor_estado(cb, sizeof(cb), g, include_mot, include_err);
+    snprintf(tc, sizeof(tc), "%s/" GW_SUBTOPIC, topic);
+    bool ok_cbor = nc && mqtt_pub(tc, (const char *)cb, (int)nc, qos, 1) >= 0;
+    if (WIRE_CBOR == 2) return ok_cbor;
+#endif
+    char js[GATE_JSON_MAX + 32];   // + ",\"age_ms\":<long>"
+    size_t n = gate_json_estado(js, GATE_JSON_MAX, g, include_mot, include_err);
+    if (!n) return false;
+    if (age_ms >= 0) n = (size_t)(n - 1) + (size_t)snprintf(js + n - 1, sizeof(js) - (n - 1), ",\"age_ms\":%ld}", age_ms);
+    return mqtt_pub(topic, js, (int)n, qos, 1) >= 0;
+}
+static inline bool publicar_json(const gate_t *g, const char *base, bool include_mot, bool include_err) {
+    return publicar_doc(g, base, include_mot, include_err, base == g_topic_tele ? g_tele_qos : 1, -1);
+}
+/**
+ * @brief Publica en vivo o, si no hay broker o aún se está vaciando lo acumulado, guarda la foto
+ *        en pub_ring para no adelantar a lo anterior.
+ */
+static void publicar_o_guardar(const gate_t *g, pub_rec_tipo_t tipo) {
+    const char *base = (tipo == PUB_REC_ESTADO) ? g_topic_status : g_topic_tele;
+    if (!pub_ring_pendiente() && publicar_json(g, base, true, true)) return;
+    pub_ring_push(g, tipo, esp_timer_get_time());
+}
+/** @brief Un tick de vaciado (tarea FSM). Al terminar se republica el estado vigente, retenido. */
+static void vaciar_pendientes(void) {
+    pub_rec_t r;
+    if (!g_mqtt_ok) { stimer_cancelar(&g_t_pub); return; }
+    for (int k = 0; k < PUB_REPLAY_LOTE; k++) {
+        if (!pub_ring_peek(&r)) break;
+        if (r.gate >= GATE_COUNT) { pub_ring_pop(); continue; }
+        gate_t foto; pub_ring_a_gate(&r, &g_gates[r.gate], &foto);
+        long age = (long)((esp_timer_get_time() - r.t_us) / 1000);
+        bool ok = (r.tipo == PUB_REC_ESTADO) ? publicar_doc(&foto, g_topic_status, true, true, 1, age)
+                                             : publicar_doc(&foto, g_topic_tele, true, true, g_tele_qos, age);
+        if (!ok) return;   // queda en el anillo: sigue en el próximo tick (o tras reconectar)
+        pub_ring_pop();
+    }
+    if (pub_ring_pendiente()) return;
+    stimer_cancelar(&g_t_pub);
+    for (int i = 0; i < GATE_COUNT; i++) publicar_json(&g_gates[i], g_topic_status, true, true);
+}
+/** @brief Estado que gobierna el consumo: el del primer portón en recorrido o, si ninguno se mueve, el del primero. */
+static void pm_actualizar(void) {
+    int e = g_gates[0].estado;
+    for (int i = 0; i < GATE_COUNT; i++) {
+        if (g_gates[i].estado == ESTADO_ABRIENDO || g_gates[i].estado == ESTADO_CERRANDO) { e = g_gates[i].estado; break; }
+    }
+    gate_pm_estado(e);
+    bool mov = e == ESTADO_ABRIENDO || e == ESTADO_CERRANDO;
+    if (mov && !stimer_activo(&g_t_prog))      stimer_periodico(&g_t_prog, PROG_MS);
+    else if (!mov && stimer_activo(&g_t_prog)) stimer_cancelar(&g_t_prog);
+    // La sonda despertaría al chip cada SONDA_MS; en reposo no hay latencia de FSM que medir
+    if (GATE_PM_LIGHT_SLEEP && SONDA_MS) {
+        if (mov && !stimer_activo(&g_t_sonda))      stimer_periodico(&g_t_sonda, SONDA_MS);
+        else if (!mov && stimer_activo(&g_t_sonda)) stimer_cancelar(&g_t_sonda);
+    }
+}
+/** @brief Avance del recorrido en "<tele>/progress": transcurrido, tiempo máximo y, con modelo, % y ETA. */
+static void publicar_progreso(void) {
+    if (!g_mqtt_ok || !g_topic_tele[0]) return;
+    for (int i = 0; i < GATE_COUNT; i++) {
+        const gate_t *g = &g_gates[i];
+        if (g->estado != ESTADO_ABRIENDO && g->estado != ESTADO_CERRANDO) continue;
+        const travel_dir_t *d = &g->travel.dir[g->estado == ESTADO_ABRIENDO ? TRAVEL_ABRIR : TRAVEL_CERRAR];
+        uint32_t t = (uint32_t)((esp_timer_get_time() - g->rec_t0_us) / 1000), eta = 0;
+        int pct = travel_progreso(d, t, &eta);
+        char tbuf[128], topic[144], js[128];
+        snprintf(topic, sizeof(topic), "%s/progress", topic_gate(tbuf, sizeof(tbuf), g_topic_tele, g));
+        int n = snprintf(js, sizeof(js), "{\"state\":\"%s\",\"elapsed_ms\":%lu,\"timeout_ms\":%lu",
+                         estado_str(g->estado), (unsigned long)t, (unsigned long)g->rec_timeout_ms);
+        if (pct >= 0 && n > 0 && n < (int)sizeof(js)) n += snprintf(js + n, sizeof(js) - (size_t)n, ",\"progress\":%d,\"eta_ms\":%lu", pct, (unsigned long)eta);
+        if (n > 0 && n < (int)sizeof(js) - 1) { js[n++] = '}'; mqtt_pub(topic, js, n, 0, 0); }
+    }
+}
+/** @brief Modelo de recorrido del portón en "<tele>/travel" (retenido). */
+static void publicar_travel(const gate_t *g) {
+    if (!g_mqtt_ok || !g_topic_tele[0]) return;
+    char tbuf[128], topic[144], js[320]; int n = 0;
+    snprintf(topic, sizeof(topic), "%s/travel", topic_gate(tbuf, sizeof(tbuf), g_topic_tele, g));
+    static const char *const k_nombre[2] = { "open", "close" };
+    const int k_limite[2] = { g->cfg->t_open_ms, g->cfg->t_close_ms };
+    for (int s = 0; s < 2 && n >= 0 && n < (int)sizeof(js); s++) {
+        const travel_dir_t *d = &g->travel.dir[s];
+        n += snprintf(js + n, sizeof(js) - (size_t)n, "%s\"%s\":{\"n\":%u,\"mean_ms\":%lu,\"sd_ms\":%lu,\"timeout_ms\":%lu,\"limit_ms\":%d,\"rejected\":%u}",
+                      s ? "," : "{", k_nombre[s], d->n, (unsigned long)d->media_ms, (unsigned long)travel_sigma_ms(d),
+                      (unsigned long)travel_timeout_ms(d, (uint32_t)k_limite[s]), k_limite[s], d->descartes);
+    }
+    if (n > 0 && n < (int)sizeof(js) - 1) { js[n++] = '}'; mqtt_pub(topic, js, n, 0, 1); }
+}
+/** @brief Guarda el modelo tras una muestra nueva (nvs_cache agrupa el commit). */
+static void guardar_travel(gate_t *g) {
+    char key[16]; snprintf(key, sizeof(key), NVS_KEY_TRAVEL, (unsigned)g->id);
+    if (nvs_cache_set_blob(key, &g->travel, sizeof(g->travel)) == ESP_OK) g->travel_nuevo = false;   // si NVS aún no está, se reintenta
+    publicar_travel(g);
+}
+/** @brief Toma lo leído de NVS (tarea FSM) si tiene más historia que lo aprendido desde el arranque. */
+static void aplicar_travel_nvs(void) {
+    uint32_t ok = s_travel_nvs_ok; s_travel_nvs_ok = 0;
+    for (int i = 0; i < GATE_COUNT; i++) {
+        if (!(ok & (1u << i))) continue;
+        for (int s = 0; s < 2; s++) {
+            if (s_travel_nvs[i].dir[s].n > g_gates[i].travel.dir[s].n) g_gates[i].travel.dir[s] = s_travel_nvs[i].dir[s];
+        }
+        // Una línea por sentido: ALOGx guarda hasta ALOG_ARGS argumentos
+        ALOGI(TAG, "[%s] Recorrido aprendido: abrir %u ms (n=%u)", g_gates[i].cfg->nombre,
+              (unsigned)g_gates[i].travel.dir[0].media_ms, (unsigned)g_gates[i].travel.dir[0].n);
+        ALOGI(TAG, "[%s] Recorrido aprendido: cerrar %u ms (n=%u)", g_gates[i].cfg->nombre,
+              (unsigned)g_gates[i].travel.dir[1].media_ms, (unsigned)g_gates[i].travel.dir[1].n);
+    }
+}
+/** @brief Lee los modelos guardados (tarea de arranque de red, tras nvs_cache_init). */
+static void cargar_travel_nvs(void) {
+    uint32_t ok = 0;
+    for (int i = 0; i < GATE_COUNT; i++) {
+        char key[16]; snprintf(key, sizeof(key), NVS_KEY_TRAVEL, (unsigned)i);
+        size_t len = sizeof(s_travel_nvs[i]);
+        if (nvs_cache_get_blob(key, &s_travel_nvs[i], &len) == ESP_OK && len == sizeof(s_travel_nvs[i])
+            && s_travel_nvs[i].version == TRAVEL_VERSION) ok |= 1u << i;
     }
+    if (ok) { s_travel_nvs_ok = ok; xEventGroupSetBits(g_ev, EV_TRAVEL); }
+}
+static void on_gate_transicion(gate_t *g, int estado_prev) {
+    pm_actualizar();
+    local_cmd_estado(g);   // primero la LAN: no espera al broker
+    portal_api_push(g);
+    gate_strip_estado(g);
+    publicar_o_guardar(g, PUB_REC_ESTADO);
+    if (g->ref_settle_us >= 0) gate_ref_fijar(g, NULL, 0);   // ya se devolvió con el reposo
+    if (g->travel_nuevo) guardar_travel(g);
+    if (g->t_cmd_rx_us) { gate_metrics_lat(MET_RX_PUB, esp_timer_get_time() - g->t_cmd_rx_us); g->t_cmd_rx_us = 0; }
+    // Diferido (alog): la FSM no espera a la UART. nombre y estado_str() son constantes
+    if (g->estado == ESTADO_ERROR) ALOGW(TAG, "[%s] Entrando a ERROR (code=%d, tope %lu ms).", g->cfg->nombre, g->error_code, (unsigned long)g->rec_timeout_ms);
+    else                           ALOGI(TAG, "[%s] Estado => %s", g->cfg->nombre, estado_str(g->estado));
+}
+/** @brief Contadores del planificador de comandos en "<tele>/sched" (para dimensionar q_cmd). */
+static void publicar_sched_stats(void) {
+    if (!g_mqtt_ok || !g_topic_tele[0]) return;
+    cmd_sched_stats_t st; cmd_sched_get_stats(&st);
+    char topic[128], js[192];
+    snprintf(topic, sizeof(topic), "%s/sched", g_topic_tele);
+    int n = snprintf(js, sizeof(js),
+        "{\"rx\":%lu,\"dlv\":%lu,\"coalesced\":%lu,\"drop_full\":%lu,\"stop_voided\":%lu,\"stop_prio\":%lu,\"depth\":%lu,\"depth_max\":%lu}",
+        (unsigned long)st.recibidos, (unsigned long)st.entregados, (unsigned long)st.coalescidos, (unsigned long)st.descartes_llena,
+        (unsigned long)st.anulados_stop, (unsigned long)st.stop_prioridad, (unsigned long)st.profundidad, (unsigned long)st.profundidad_max);
+    if (n > 0 && n < (int)sizeof(js)) mqtt_pub(topic, js, n, 0, 0);
+}
+/** @brief Desgaste de NVS en "<tele>/nvs": commits, entradas escritas y vida estimada de la partición. */
+static void publicar_nvs_stats(void) {
+    if (!g_mqtt_ok || !g_topic_tele[0]) return;
+    nvs_cache_stats_t st; nvs_cache_get_stats(&st);
+    char topic[128], js[224];
+    snprintf(topic, sizeof(topic), "%s/nvs", g_topic_tele);
+    int n = snprintf(js, sizeof(js),
+        "{\"sets\":%lu,\"same\":%lu,\"commits\":%lu,\"entries\":%lu,\"bytes\":%llu,\"dirty\":%lu,\"err\":%lu,\"direct\":%lu,\"life_days\":%lu,\"brownout\":%s}",
+        (unsigned long)st.sets, (unsigned long)st.sin_cambio, (unsigned long)st.commits, (unsigned long)st.entradas,
+        (unsigned long long)st.bytes, (unsigned long)st.sucias, (unsigned long)st.errores, (unsigned long)st.directos, (unsigned long)st.vida_dias,
+        st.brownout ? "true" : "false");
+    if (n > 0 && n < (int)sizeof(js)) mqtt_pub(topic, js, n, 0, 0);
+}
+/** @brief Tiempo y corriente media por estado en "<tele>/power". */
+static void publicar_pm_stats(void) {
+    if (!g_mqtt_ok || !g_topic_tele[0]) return;
+    char topic[128], js[512];
+    snprintf(topic, sizeof(topic), "%s/power", g_topic_tele);
+    size_t n = gate_pm_json(js, sizeof(js));
+    if (n) mqtt_pub(topic, js, (int)n, 0, 0);
+}
+/** @brief Contadores del buffer offline en "<tele>/ring". */
+static void publicar_ring_stats(void) {
+    if (!g_mqtt_ok || !g_topic_tele[0]) return;
+    pub_ring_stats_t st; pub_ring_get_stats(&st);
+    char topic[128], js[128];
+    snprintf(topic, sizeof(topic), "%s/ring", g_topic_tele);
+    int n = snprintf(js, sizeof(js), "{\"stored\":%lu,\"lost\":%lu,\"tele_collapsed\":%lu,\"replayed\":%lu,\"pending\":%lu}",
+                     (unsigned long)st.guardados, (unsigned long)st.perdidos, (unsigned long)st.tele_pisada,
+                     (unsigned long)st.repetidos, (unsigned long)st.pendientes);
+    if (n > 0 && n < (int)sizeof(js)) mqtt_pub(topic, js, n, 0, 0);
+}
+/** @brief Cierra el lote del portón y lo manda a "<tele>/batch" (sin retener). Offline se descarta. */
+static void publicar_lote(const gate_t *g, tele_batch_t *b) {
+    static char js[TELE_JSON_MAX];
+    size_t n = tele_batch_json(b, js, sizeof(js), g_tele_ms);
+    if (!n) return;
+    if (!g_mqtt_ok || !g_topic_tele[0]) { tele_batch_resync(b); return; }   // el próximo será autocontenido
+    char base[112], tbuf[128];
+    snprintf(base, sizeof(base), "%s/batch", g_topic_tele);
+    if (mqtt_pub(topic_gate(tbuf, sizeof(tbuf), base, g), js, (int)n, g_tele_qos, 0) < 0) tele_batch_resync(b);
 }
 static inline void tick_telemetria(void) {
-    uint64_t now = esp_timer_get_time();
-    if ((now - g_last_pub_us) > (uint64_t)PUB_PERIOD_MS * 1000ULL) {
-        publicar_json(g_topic_tele, true, true);
-        g_last_pub_us = now;
+    if (g_tele_lote) {
+        // Todos los portones se muestrean juntos, así que cierran el lote en el mismo tick;
+        // los contadores salen solo en ese tick
+        bool cierre = false;
+        int64_t t = esp_timer_get_time();
+        for (int i = 0; i < GATE_COUNT; i++) {
+            if (tele_batch_muestra(&s_tele_b[i], &g_gates[i], t, g_tele_lote)) { publicar_lote(&g_gates[i], &s_tele_b[i]); cierre = true; }
+        }
+        if (!cierre) return;
+    } else {
+        for (int i = 0; i < GATE_COUNT; i++) publicar_o_guardar(&g_gates[i], PUB_REC_TELE);
     }
+    publicar_sched_stats();
+    publicar_nvs_stats();
+    publicar_ring_stats();
+    publicar_pm_stats();
 }
-static inline bool fetch_cmd(gate_cmd_t *out_cmd) { return xQueueReceive(q_cmd, out_cmd, 0) == pdTRUE; }
 
 // ------------------------------- MQTT dinámico -------------------------------
-static gate_cmd_t parse_cmd_json(const char *data, int len) {
-    cJSON *root = cJSON_ParseWithLength(data, len);
-    if (!root) return CMD_NONE;
-    cJSON *cmd = cJSON_GetObjectItem(root, "cmd");
-    gate_cmd_t out = CMD_NONE;
-    if (cJSON_IsString(cmd) && cmd->valuestring) {
-        if (!strcasecmp(cmd->valuestring, "OPEN")) out = CMD_OPEN;
-        else if (!strcasecmp(cmd->valuestring, "CLOSE")) out = CMD_CLOSE;
-        else if (!strcasecmp(cmd->valuestring, "STOP")) out = CMD_STOP;
-        else if (!strcasecmp(cmd->valuestring, "TOGGLE")) out = CMD_TOGGLE;
-        else if (!strcasecmp(cmd->valuestring, "LAMP_ON")) out = CMD_LAMP_ON;
-        else if (!strcasecmp(cmd->valuestring, "LAMP_OFF")) out = CMD_LAMP_OFF;
-    }
-    cJSON_Delete(root);
-    return out;
+// Reensamblado de comandos fragmentados. El handler corre siempre en la tarea de esp-mqtt,
+// así que un único buffer estático basta.
+#define CMD_RX_MAX  512
+static char s_rx_buf[CMD_RX_MAX];
+static bool s_rx_activo = false;
+static bool s_rx_cbor = false;            // el mensaje en curso llegó por "<cmd>/cbor"
+static char s_topic_cmd_cbor[104] = "";
+static char s_topic_cmd_ota[104] = "";
+
+/** @brief Compara un tópico recibido (sin '\0') con un filtro MQTT, admitiendo '+' y '#'. */
+static bool topic_match(const char *filtro, const char *t, int tlen) {
+    const char *end = t + tlen;
+    while (*filtro) {
+        if (*filtro == '#') return true;
+        if (*filtro == '+') {
+            while (t < end && *t != '/') t++;
+            filtro++;
+        } else {
+            if (t >= end || *t != *filtro) return false;
+            t++; filtro++;
+        }
+    }
+    return t == end;
+}
+/** @brief Tiempos del arranque en "<tele>/boot" (una vez): arranque -> IP -> MQTT conectado. */
+static void publicar_tiempos_arranque(void) {
+    ESP_LOGI(TAG, "Arranque: IP %lu ms, MQTT %lu ms", (unsigned long)(g_t_got_ip_us / 1000), (unsigned long)(g_t_mqtt_us / 1000));
+    if (!g_mqtt_ok || !g_topic_tele[0]) return;
+    char topic[128], js[160];
+    snprintf(topic, sizeof(topic), "%s/boot", g_topic_tele);
+    int n = snprintf(js, sizeof(js), "{\"safe_us\":%lu,\"got_ip_ms\":%lu,\"mqtt_ms\":%lu,\"directed\":%s,\"static_ip\":%s,\"reset\":%d}",
+                     (unsigned long)g_t_safe_us, (unsigned long)(g_t_got_ip_us / 1000), (unsigned long)(g_t_mqtt_us / 1000), wifi_fast_dirigido() ? "true" : "false",
+                     wifi_fast_ip_estatica() ? "true" : "false", (int)esp_reset_reason());
+    if (n > 0 && n < (int)sizeof(js)) mqtt_pub(topic, js, n, 1, 1);
+}
+/** @brief Informe de latencias/contadores en "<tele>/metrics" y de tareas en "<tele>/tasks" (tarea MQTT). */
+static void publicar_metricas(void) {
+    static char js[2048];   // publish copia el payload, así que sirve para los dos informes
+    if (!g_mqtt_ok || !g_topic_tele[0]) return;
+    char topic[128]; snprintf(topic, sizeof(topic), "%s/metrics", g_topic_tele);
+    size_t n = gate_metrics_report(js, sizeof(js), esp_app_get_description()->version, (uint32_t)(esp_timer_get_time() / 1000000));
+    if (n) mqtt_pub(topic, js, (int)n, 0, 0);
+    // Reparto de CPU por tarea/núcleo desde el pedido anterior (el retardo de la FSM va en fsm_wake)
+    snprintf(topic, sizeof(topic), "%s/tasks", g_topic_tele);
+    n = task_report_json(js, sizeof(js));
+    if (n) mqtt_pub(topic, js, (int)n, 0, 0);
+}
+/**
+ * @brief Diagnóstico en "<tele>/diag": heap (libre, mínimo histórico, bloque mayor), pila libre
+ *        mínima de cada tarea (bytes) y actividad de la rueda de timers, para dimensionar STACK_*
+ *        y detectar fragmentación.
+ */
+static void publicar_diag(void) {
+    if (!g_mqtt_ok || !g_topic_tele[0]) return;
+    static const char *const k_sistema[] = { "mqtt_task", "httpd", "esp_timer", "tiT", "wifi", "sys_evt", "nvs_commit" };
+    char topic[128], js[768];
+    snprintf(topic, sizeof(topic), "%s/diag", g_topic_tele);
+    int n = snprintf(js, sizeof(js), "{\"heap\":{\"free\":%u,\"min\":%u,\"largest\":%u},\"mqtt_restarts\":%lu,\"static\":%s,\"stack_free\":{",
+                     (unsigned)heap_caps_get_free_size(MALLOC_CAP_DEFAULT), (unsigned)heap_caps_get_minimum_free_size(MALLOC_CAP_DEFAULT),
+                     (unsigned)heap_caps_get_largest_free_block(MALLOC_CAP_DEFAULT), (unsigned long)s_mqtt_reinicios,
+                     TASK_PLAN_ESTATICO ? "true" : "false");
+    struct { const char *n; TaskHandle_t h; } t[5 + sizeof(k_sistema) / sizeof(k_sistema[0])];
+    size_t nt = 0;
+    t[nt].n = "state_machine"; t[nt++].h = g_fsm_task;
+    t[nt].n = "local_cmd";     t[nt++].h = g_local_task;
+    t[nt].n = "ota";           t[nt++].h = g_ota_task;
+    t[nt].n = "strip";         t[nt++].h = g_strip_task;
+    t[nt].n = "alog";          t[nt++].h = xTaskGetHandle("alog");
+    for (size_t i = 0; i < sizeof(k_sistema) / sizeof(k_sistema[0]); i++) { t[nt].n = k_sistema[i]; t[nt++].h = xTaskGetHandle(k_sistema[i]); }
+    bool primero = true;
+    for (size_t i = 0; i < nt && n > 0 && n < (int)sizeof(js); i++) {
+        if (!t[i].h) continue;
+        n += snprintf(js + n, sizeof(js) - (size_t)n, "%s\"%s\":%u", primero ? "" : ",", t[i].n, (unsigned)uxTaskGetStackHighWaterMark(t[i].h));
+        primero = false;
+    }
+    stimer_stats_t st; stimer_get_stats(&st);
+    local_cmd_stats_t lc; local_cmd_get_stats(&lc);
+    alog_stats_t lg; alog_get_stats(&lg);
+    if (n > 0 && n < (int)sizeof(js))
+        n += snprintf(js + n, sizeof(js) - (size_t)n, "},\"stimer\":{\"armed\":%lu,\"wakes\":%lu,\"fired\":%lu,\"cascades\":%lu},"
+                      "\"local\":{\"rx\":%lu,\"ok\":%lu,\"bad_tag\":%lu,\"replay\":%lu,\"echo\":%lu},"
+                      "\"log\":{\"written\":%lu,\"dropped\":%lu,\"peak\":%lu}}",
+                      (unsigned long)st.armados, (unsigned long)st.despertares, (unsigned long)st.disparos, (unsigned long)st.cascadas,
+                      (unsigned long)lc.recibidos, (unsigned long)lc.aceptados, (unsigned long)lc.firma_mala, (unsigned long)lc.repetidos, (unsigned long)lc.ecos,
+                      (unsigned long)lg.escritos, (unsigned long)lg.descartados, (unsigned long)lg.ocupacion_max);
+    if (n > 0 && n < (int)sizeof(js)) mqtt_pub(topic, js, n, 0, 0);
+}
+static bool topic_termina(const char *t, int tlen, const char *suf) {
+    const int n = (int)strlen(suf);
+    return tlen >= n && !memcmp(t + tlen - n, suf, (size_t)n);
+}
+/** @brief true si el tópico termina en "/cbor": el payload viene en gate_wire y no en JSON. */
+static bool topic_cbor(const char *t, int tlen) { return topic_termina(t, tlen, "/" GW_SUBTOPIC); }
+
+// ------------------------------ LOG -------------------------------------------
+/** @brief WARN y ERROR de alog también a "<tele>/log" (corre en la tarea alog). */
+static void reenviar_log(int nivel, const char *tag, const char *linea, size_t len) {
+    if (!g_mqtt_ok || !g_topic_tele[0]) return;
+    char topic[128], js[ALOG_LINEA_MAX + 48];
+    snprintf(topic, sizeof(topic), "%s/log", g_topic_tele);
+    int n = snprintf(js, sizeof(js), "{\"lvl\":%d,\"tag\":\"%s\",\"msg\":\"", nivel, tag);
+    for (size_t i = 0; i < len && n > 0 && n < (int)sizeof(js) - 3; i++) {
+        char c = linea[i];
+        if (c == '"' || c == '\\') js[n++] = '\\';
+        js[n++] = (c >= ' ') ? c : ' ';
+    }
+    if (n <= 0 || n > (int)sizeof(js) - 2) return;
+    js[n++] = '"'; js[n++] = '}';
+    mqtt_pub(topic, js, n, 0, 0);
+}
+
+// ------------------------------ OTA -------------------------------------------
+/** @brief Sin motor en marcha en ningún portón: se puede cambiar de imagen (o volver a la anterior). */
+static bool gates_en_reposo(void) {
+    for (int i = 0; i < GATE_COUNT; i++) {
+        const gate_t *g = &g_gates[i];
+        if (g->estado == ESTADO_ABRIENDO || g->estado == ESTADO_CERRANDO || g->motorA || g->motorC) return false;
+    }
+    return true;
+}
+/** @brief Informes de gate_ota en "<tele>/ota". */
+static void publicar_ota(const char *js, size_t n) {
+    if (!g_mqtt_ok || !g_topic_tele[0]) return;
+    char topic[128];
+    snprintf(topic, sizeof(topic), "%s/" SUBTOPIC_OTA, g_topic_tele);
+    mqtt_pub(topic, js, (int)n, 1, 0);
+}
+static void ota_pedir(const char *url, size_t len) {
+    if (!g_ota_task) g_ota_task = crear_tarea(gate_ota_task, "ota", STACK_OTA, NULL, PRIO_OTA, CORE_NET, PILA(s_ota));
+    if (!gate_ota_pedir(url, len)) {
+        static const char k_rechazo[] = "{\"event\":\"rejected\"}";   // sin firma habilitada, URL no https o ya hay una en curso
+        publicar_ota(k_rechazo, sizeof(k_rechazo) - 1);
+    }
+}
+/**
+ * @brief Comando de MQTT, de la LAN o del portal hacia cmd_sched; false si no se entendió o la cola estaba llena.
+ *        METRICS y DIAG comparten búferes y estado de task_report: solo se atienden en la tarea MQTT (`mqtt`).
+ */
+static bool encolar_cmd_de(const char *data, size_t len, bool cbor, int64_t t_rx_us, bool mqtt) {
+    gate_cmd_msg_t pc;
+    if (!(cbor ? gate_cmd_parse_cbor((const uint8_t *)data, len, &pc) : gate_cmd_parse(data, len, &pc))) return false;
+    if (pc.cmd == CMD_METRICS || pc.cmd == CMD_DIAG) {
+        if (!mqtt) return false;
+        if (pc.cmd == CMD_METRICS) publicar_metricas(); else publicar_diag();
+        return true;
+    }
+    if (pc.cmd == CMD_EMERGENCY && pc.gate < 0) {   // sin "gate": traba todos
+        bool ok = true;
+        for (uint8_t k = 0; k < GATE_COUNT; k++) ok &= cmd_sched_submit(k, pc.cmd, t_rx_us, &pc.ref);
+        return ok;
+    }
+    return cmd_sched_submit((pc.gate >= 0 && pc.gate < GATE_COUNT) ? (uint8_t)pc.gate : 0, pc.cmd, t_rx_us, &pc.ref);
+}
+static bool encolar_cmd(const char *data, size_t len, bool cbor, int64_t t_rx_us) { return encolar_cmd_de(data, len, cbor, t_rx_us, false); }
+static bool on_local_cmd(const uint8_t *cbor, size_t len, int64_t t_rx_us) { return encolar_cmd((const char *)cbor, len, true, t_rx_us); }
+/** @brief Crea la tarea UDP la primera vez que hay clave (arranque o portal). */
+static void local_arrancar(void) {
+    if (!g_local_task && local_cmd_activo())
+        g_local_task = crear_tarea(local_cmd_task, "local_cmd", STACK_LOCAL, NULL, PRIO_LOCAL, CORE_NET, PILA(s_local));
 }
 static void mqtt_event_handler(void *handler_args, esp_event_base_t base, int32_t event_id, void *event_data) {
     esp_mqtt_event_handle_t e = event_data;
     switch (event_id) {
         case MQTT_EVENT_CONNECTED:
             ESP_LOGI(TAG, "MQTT conectado (%s)", g_mqtt_uri);
+            g_mqtt_ok = true;
+            if (!g_t_mqtt_us) { g_t_mqtt_us = esp_timer_get_time(); publicar_tiempos_arranque(); }
+            gate_ota_confirmar(g_t_safe_us, g_t_mqtt_us);   // la imagen llegó al broker: no hay rollback
             if (g_topic_cmd[0]) esp_mqtt_client_subscribe(g_client, g_topic_cmd, 1);
-            publicar_json(g_topic_status, true, false);
+            s_topic_cmd_cbor[0] = s_topic_cmd_ota[0] = '\0';
+            if (g_topic_cmd[0] && !strchr(g_topic_cmd, '#')) {   // con '#' el filtro ya cubre los subtópicos
+                snprintf(s_topic_cmd_cbor, sizeof(s_topic_cmd_cbor), "%s/" GW_SUBTOPIC, g_topic_cmd);
+                esp_mqtt_client_subscribe(g_client, s_topic_cmd_cbor, 1);
+                snprintf(s_topic_cmd_ota, sizeof(s_topic_cmd_ota), "%s/" SUBTOPIC_OTA, g_topic_cmd);
+                esp_mqtt_client_subscribe(g_client, s_topic_cmd_ota, 1);
+            }
+            // Lo acumulado y el estado vigente los publica la tarea FSM, al ritmo de g_t_pub
+            stimer_periodico(&g_t_pub, PUB_REPLAY_MS);
+            break;
+        case MQTT_EVENT_DISCONNECTED:
+            g_mqtt_ok = false;
             break;
         case MQTT_EVENT_DATA: {
-            char *buf = calloc(1, e->data_len + 1); if (!buf) break;
-            memcpy(buf, e->data, e->data_len);
-            gate_cmd_t cmd = parse_cmd_json(buf, e->data_len);
-            free(buf);
-            if (cmd != CMD_NONE && q_cmd) xQueueSend(q_cmd, &cmd, 0);
+            int64_t t_rx = esp_timer_get_time();
+            if (e->current_data_offset == 0) {
+                // Primer (o único) fragmento: es el único que trae el tópico
+                s_rx_activo = false;
+                if (!g_topic_cmd[0]) break;
+                if (!topic_match(g_topic_cmd, e->topic, e->topic_len) &&
+                    !(s_topic_cmd_cbor[0] && topic_match(s_topic_cmd_cbor, e->topic, e->topic_len)) &&
+                    !(s_topic_cmd_ota[0] && topic_match(s_topic_cmd_ota, e->topic, e->topic_len))) break;
+                if (topic_termina(e->topic, e->topic_len, "/" SUBTOPIC_OTA)) {   // la URL entra en un fragmento
+                    if (e->data_len >= e->total_data_len) ota_pedir(e->data, (size_t)e->data_len);
+                    break;
+                }
+                s_rx_cbor = topic_cbor(e->topic, e->topic_len);
+                if (e->data_len >= e->total_data_len) { encolar_cmd_de(e->data, e->data_len, s_rx_cbor, t_rx, true); break; }  // sin copia
+                if (e->total_data_len > CMD_RX_MAX) { ESP_LOGW(TAG, "CMD de %d bytes descartado", e->total_data_len); break; }
+                s_rx_activo = true;
+            }
+            if (!s_rx_activo) break;
+            int fin = e->current_data_offset + e->data_len;
+            if (fin > e->total_data_len || fin > CMD_RX_MAX) { s_rx_activo = false; break; }
+            memcpy(s_rx_buf + e->current_data_offset, e->data, e->data_len);
+            if (fin == e->total_data_len) { s_rx_activo = false; encolar_cmd_de(s_rx_buf, (size_t)fin, s_rx_cbor, t_rx, true); }
             break;
         }
         default: break;
     }
 }
+// El cliente se crea una sola vez y se reconfigura en cada cambio de broker: crear y destruir
+// el cliente (tarea, buffers, outbox) en cada guardado del portal terminaba fragmentando el heap.
 static void mqtt_init(void) {
     if (!g_mqtt_uri[0]) {
         ESP_LOGW(TAG, "MQTT no iniciado: broker vacio.");
@@ -640,196 +1271,113 @@ static void mqtt_init(void) {
     esp_mqtt_client_config_t cfg = {
         .broker  = { .address.uri = g_mqtt_uri },
         .session = { .keepalive = 30, .disable_clean_session = false },
+        .task    = { .priority = PRIO_MQTT },   // núcleo: CONFIG_MQTT_USE_CORE_0 (task_plan.h)
+        .outbox  = { .limit = MQTT_OUTBOX_MAX },
     };
 
-    g_client = esp_mqtt_client_init(&cfg);
-    esp_mqtt_client_register_event(g_client, ESP_EVENT_ANY_ID, mqtt_event_handler, NULL);
+    if (!g_client) {
+        g_client = esp_mqtt_client_init(&cfg);
+        if (!g_client) { ESP_LOGE(TAG, "MQTT: sin memoria para el cliente"); return; }
+        esp_mqtt_client_register_event(g_client, ESP_EVENT_ANY_ID, mqtt_event_handler, NULL);
+    } else if (esp_mqtt_set_config(g_client, &cfg) != ESP_OK) {
+        ESP_LOGE(TAG, "MQTT: no se pudo aplicar la configuracion");
+        return;
+    }
     esp_mqtt_client_start(g_client);
 }
 
 static void mqtt_restart(void) {
-    if (g_client) { esp_mqtt_client_stop(g_client); esp_mqtt_client_destroy(g_client); g_client = NULL; }
+    g_mqtt_ok = false;
+    if (g_client) esp_mqtt_client_stop(g_client);
+    s_mqtt_reinicios++;
     mqtt_init();
 }
 
-// --------------------------- BUCLES DE ESTADO --------------------------------
-static int loop_error(void) {
-    ESP_LOGW(TAG, "Entrando a ERROR (code=%d).", g_error_code);
-    motor_stop(); publicar_estado_si_cambia();
-    while (1) {
-        leer_sensores();
-        if (!(g_lsa && g_lsc)) {
-            if (g_lsc && !g_lsa) return ESTADO_CERRADO;
-            if (g_lsa && !g_lsc) return ESTADO_ABIERTO;
-            if (!g_lsa && !g_lsc) return ESTADO_DESCONOCIDO;
-        }
-        gate_cmd_t cmd;
-        if (fetch_cmd(&cmd)) {
-            if (cmd == CMD_LAMP_ON)  lamp_on(true);
-            if (cmd == CMD_LAMP_OFF) lamp_on(false);
-            if (cmd == CMD_OPEN)     return ESTADO_ABRIENDO;
-            if (cmd == CMD_CLOSE)    return ESTADO_CERRANDO;
-            if (cmd == CMD_TOGGLE)   return ESTADO_ABRIENDO;
-        }
-        tick_telemetria(); publicar_estado_si_cambia(); vTaskDelay(pdMS_TO_TICKS(20));
-    }
-}
-static int loop_abierto(void) {
-    motor_stop(); publicar_estado_si_cambia();
-    while (1) {
-        leer_sensores();
-        if (g_lsa && g_lsc) { g_error_code = ERR_LS_INCONSISTENT; return ESTADO_ERROR; }
-        if (g_lsc && !g_lsa) return ESTADO_CERRADO;
-        if (!g_lsa && !g_lsc) return ESTADO_DESCONOCIDO;
-        gate_cmd_t cmd;
-        if (fetch_cmd(&cmd)) {
-            if (cmd == CMD_CLOSE || cmd == CMD_TOGGLE) return ESTADO_CERRANDO;
-            if (cmd == CMD_STOP)   return ESTADO_DETENIDO;
-            if (cmd == CMD_LAMP_ON)  lamp_on(true);
-            if (cmd == CMD_LAMP_OFF) lamp_on(false);
-        }
-        tick_telemetria(); publicar_estado_si_cambia(); vTaskDelay(pdMS_TO_TICKS(20));
-    }
-}
-static int loop_cerrado(void) {
-    motor_stop(); publicar_estado_si_cambia();
-    while (1) {
-        leer_sensores();
-        if (g_lsa && g_lsc) { g_error_code = ERR_LS_INCONSISTENT; return ESTADO_ERROR; }
-        if (g_lsa && !g_lsc) return ESTADO_ABIERTO;
-        if (!g_lsa && !g_lsc) return ESTADO_DESCONOCIDO;
-        gate_cmd_t cmd;
-        if (fetch_cmd(&cmd)) {
-            if (cmd == CMD_OPEN || cmd == CMD_TOGGLE) return ESTADO_ABRIENDO;
-            if (cmd == CMD_STOP)   return ESTADO_DETENIDO;
-            if (cmd == CMD_LAMP_ON)  lamp_on(true);
-            if (cmd == CMD_LAMP_OFF) lamp_on(false);
-        }
-        tick_telemetria(); publicar_estado_si_cambia(); vTaskDelay(pdMS_TO_TICKS(20));
-    }
-}
-static int loop_detenido(void) {
-    motor_stop(); publicar_estado_si_cambia();
-    while (1) {
-        leer_sensores();
-        if (g_lsa && g_lsc) { g_error_code = ERR_LS_INCONSISTENT; return ESTADO_ERROR; }
-        if (g_lsa && !g_lsc) return ESTADO_ABIERTO;
-        if (g_lsc && !g_lsa) return ESTADO_CERRADO;
-        gate_cmd_t cmd;
-        if (fetch_cmd(&cmd)) {
-            if (cmd == CMD_OPEN)   return ESTADO_ABRIENDO;
-            if (cmd == CMD_CLOSE)  return ESTADO_CERRANDO;
-            if (cmd == CMD_TOGGLE) return g_lsc ? ESTADO_ABRIENDO : ESTADO_CERRANDO;
-            if (cmd == CMD_LAMP_ON)  lamp_on(true);
-            if (cmd == CMD_LAMP_OFF) lamp_on(false);
-        }
-        tick_telemetria(); publicar_estado_si_cambia(); vTaskDelay(pdMS_TO_TICKS(20));
-    }
-}
-static int loop_desconocido(void) {
-    motor_stop(); publicar_estado_si_cambia();
-    while (1) {
-        leer_sensores();
-        if (g_lsa && g_lsc) { g_error_code = ERR_LS_INCONSISTENT; return ESTADO_ERROR; }
-        if (g_lsa && !g_lsc) return ESTADO_ABIERTO;
-        if (g_lsc && !g_lsa) return ESTADO_CERRADO;
-        gate_cmd_t cmd;
-        if (fetch_cmd(&cmd)) {
-            if (cmd == CMD_OPEN)     return ESTADO_ABRIENDO;
-            if (cmd == CMD_CLOSE)    return ESTADO_CERRANDO;
-            if (cmd == CMD_TOGGLE)   return ESTADO_ABRIENDO;
-            if (cmd == CMD_LAMP_ON)  lamp_on(true);
-            if (cmd == CMD_LAMP_OFF) lamp_on(false);
-        }
-        tick_telemetria(); publicar_estado_si_cambia(); vTaskDelay(pdMS_TO_TICKS(20));
-    }
-}
-static int loop_abriendo(void) {
-    motor_abrir();
-    uint64_t deadline_us = esp_timer_get_time() + (uint64_t)T_OPEN_MS * 1000ULL;
-    publicar_estado_si_cambia();
-    while (1) {
-        leer_sensores();
-        if (g_lsa && g_lsc) { motor_stop(); g_error_code = ERR_LS_INCONSISTENT; return ESTADO_ERROR; }
-        if (g_lsa && !g_lsc) { motor_stop(); return ESTADO_ABIERTO; }
-        if (esp_timer_get_time() > deadline_us) { motor_stop(); g_error_code = ERR_TIMEOUT_OPEN; return ESTADO_ERROR; }
-        gate_cmd_t cmd;
-        if (fetch_cmd(&cmd)) {
-            if (cmd == CMD_STOP)   { motor_stop(); return ESTADO_DETENIDO; }
-            if (cmd == CMD_CLOSE)  { motor_cerrar(); deadline_us = esp_timer_get_time() + (uint64_t)T_CLOSE_MS * 1000ULL; g_estado = ESTADO_CERRANDO; publicar_estado_si_cambia(); return ESTADO_CERRANDO; }
-            if (cmd == CMD_TOGGLE) { motor_stop(); return ESTADO_DETENIDO; }
-            if (cmd == CMD_LAMP_ON)  lamp_on(true);
-            if (cmd == CMD_LAMP_OFF) lamp_on(false);
-        }
-        tick_telemetria(); publicar_estado_si_cambia(); vTaskDelay(pdMS_TO_TICKS(10));
-    }
-}
-static int loop_cerrando(void) {
-    motor_cerrar();
-    uint64_t deadline_us = esp_timer_get_time() + (uint64_t)T_CLOSE_MS * 1000ULL;
-    publicar_estado_si_cambia();
-    while (1) {
-        leer_sensores();
-        if (g_lsa && g_lsc) { motor_stop(); g_error_code = ERR_LS_INCONSISTENT; return ESTADO_ERROR; }
-        if (g_lsc && !g_lsa) { motor_stop(); return ESTADO_CERRADO; }
-        if (esp_timer_get_time() > deadline_us) { motor_stop(); g_error_code = ERR_TIMEOUT_CLOSE; return ESTADO_ERROR; }
-        gate_cmd_t cmd;
-        if (fetch_cmd(&cmd)) {
-            if (cmd == CMD_STOP)   { motor_stop(); return ESTADO_DETENIDO; }
-            if (cmd == CMD_OPEN)   { motor_abrir(); deadline_us = esp_timer_get_time() + (uint64_t)T_OPEN_MS * 1000ULL; g_estado = ESTADO_ABRIENDO; publicar_estado_si_cambia(); return ESTADO_ABRIENDO; }
-            if (cmd == CMD_TOGGLE) { motor_stop(); return ESTADO_DETENIDO; }
-            if (cmd == CMD_LAMP_ON)  lamp_on(true);
-            if (cmd == CMD_LAMP_OFF) lamp_on(false);
-        }
-        tick_telemetria(); publicar_estado_si_cambia(); vTaskDelay(pdMS_TO_TICKS(10));
-    }
-}
-static int loop_inicial(void) {
-    leer_sensores();
-    if (g_lsa && g_lsc) { g_error_code = ERR_LS_INCONSISTENT; return ESTADO_ERROR; }
-    if (g_lsa && !g_lsc) return ESTADO_ABIERTO;
-    if (g_lsc && !g_lsa) return ESTADO_CERRADO;
-    return ESTADO_DESCONOCIDO;
-}
-
 // ----------------------------- DISPATCHER FSM ---------------------------------
+/**
+ * @brief Una sola tarea para todos los portones: duerme en el event group y, al despertar,
+ *        reevalúa sensores/deadlines de cada portón y consume los comandos pendientes.
+ */
 static void state_machine_task(void *arg) {
-    g_last_pub_us = esp_timer_get_time();
-    lamp_on(false); motor_stop();
+    // El GPIO y sus ISR se instalan desde aquí para que queden en el núcleo de control
+    gates_init();
+    ESP_ERROR_CHECK(cmd_sched_init(g_ev, EV_CMD));
+    xTaskNotifyGive((TaskHandle_t)arg);
+    for (int i = 0; i < GATE_COUNT; i++) gate_evaluar(&g_gates[i]);   // INICIAL -> según sensores
+    g_t_safe_us = esp_timer_get_time();
+    ESP_LOGI(TAG, "Control local activo a los %lu us", (unsigned long)g_t_safe_us);
+    tele_reprogramar();
     while (1) {
-        switch (g_estado) {
-            case ESTADO_INICIAL:     g_estado = loop_inicial();     publicar_estado_si_cambia(); break;
-            case ESTADO_ABIERTO:     g_estado = loop_abierto();     break;
-            case ESTADO_CERRADO:     g_estado = loop_cerrado();     break;
-            case ESTADO_ABRIENDO:    g_estado = loop_abriendo();    break;
-            case ESTADO_CERRANDO:    g_estado = loop_cerrando();    break;
-            case ESTADO_DETENIDO:    g_estado = loop_detenido();    break;
-            case ESTADO_DESCONOCIDO: g_estado = loop_desconocido(); break;
-            case ESTADO_ERROR:       g_estado = loop_error();       break;
-            default:                 g_estado = ESTADO_ERROR;       g_error_code = ERR_STATE_GUARDRAIL; break;
+        EventBits_t ev = xEventGroupWaitBits(g_ev, EV_ALL, pdTRUE, pdFALSE, portMAX_DELAY);
+        if (ev & EV_SONDA) gate_metrics_lat(MET_FSM_WAKE, esp_timer_get_time() - s_t_sonda_us);
+        if (ev & (EV_LS | EV_DEADLINE)) {
+            for (int i = 0; i < GATE_COUNT; i++) gate_evaluar(&g_gates[i]);
+        }
+        gate_msg_t m;
+        while (cmd_sched_next(&m)) {
+            if (m.gate >= GATE_COUNT) continue;
+            gate_t *g = &g_gates[m.gate];
+            if (m.t_rx_us) gate_metrics_lat(MET_RX_DEQ, esp_timer_get_time() - m.t_rx_us);
+            g->t_cmd_rx_us = m.t_rx_us;
+            bool lamp = m.cmd == CMD_LAMP_ON || m.cmd == CMD_LAMP_OFF;
+            if (!lamp) gate_ref_fijar(g, &m.ref, m.t_rx_us);   // un movimiento sin id también reemplaza la anterior
+            gate_comando(g, (gate_cmd_t)m.cmd);
+            g->t_cmd_rx_us = 0;
+            // Sin transición (p.ej. OPEN ya abierto): igual se devuelve la referencia con el estado actual
+            if (!lamp && gate_ref_activa(g) && g->ref_act_us < 0) { publicar_o_guardar(g, PUB_REC_ESTADO); gate_ref_fijar(g, NULL, 0); }
         }
+        if (ev & EV_TELE) tick_telemetria();
+        if (ev & EV_PUB)  vaciar_pendientes();
+        if (ev & EV_PROG) publicar_progreso();
+        if (ev & EV_TRAVEL) aplicar_travel_nvs();
     }
 }
 
 // ------------------------------ INICIALIZACIÓN --------------------------------
-static void gpio_init_all(void) {
-    gpio_config_t in = { .pin_bit_mask=(1ULL<<PIN_LSA)|(1ULL<<PIN_LSC), .mode=GPIO_MODE_INPUT, .pull_up_en=GPIO_PULLUP_DISABLE, .pull_down_en=GPIO_PULLDOWN_DISABLE, .intr_type=GPIO_INTR_DISABLE };
-    ESP_ERROR_CHECK(gpio_config(&in));
-    gpio_config_t out = { .pin_bit_mask=(1ULL<<PIN_MOTOR_A)|(1ULL<<PIN_MOTOR_C)|(1ULL<<PIN_LAMP), .mode=GPIO_MODE_OUTPUT, .pull_up_en=GPIO_PULLUP_DISABLE, .pull_down_en=GPIO_PULLDOWN_DISABLE, .intr_type=GPIO_INTR_DISABLE };
-    ESP_ERROR_CHECK(gpio_config(&out));
-    motor_stop(); lamp_on(false);
+static void gates_init(void) {
+    g_ev = xEventGroupCreateStatic(&s_ev_buf);
+    ESP_ERROR_CHECK(stimer_iniciar());
+    stimer_crear(&g_t_tele, on_timer_event, (void *)(uintptr_t)EV_TELE);
+    stimer_crear(&g_t_pub, on_timer_event, (void *)(uintptr_t)EV_PUB);
+    stimer_crear(&g_t_sonda, on_sonda, NULL);
+    stimer_crear(&g_t_prog, on_timer_event, (void *)(uintptr_t)EV_PROG);
+    if (SONDA_MS && !GATE_PM_LIGHT_SLEEP) stimer_periodico(&g_t_sonda, SONDA_MS);
+    gate_pm_init();   // antes de los finales: el despertar por GPIO se habilita aquí
+    // Antes de los portones, para que la barra reciba la primera transición; sin barra el control sigue igual
+    esp_err_t err = STRIP_LEDS ? gate_strip_iniciar(PIN_STRIP, STRIP_LEDS, GATE_COUNT) : ESP_ERR_NOT_SUPPORTED;
+    if (STRIP_LEDS && err != ESP_OK) ESP_LOGW(TAG, "Barra de estado sin iniciar: %s", esp_err_to_name(err));
+    for (int i = 0; i < GATE_COUNT; i++) {
+        ESP_ERROR_CHECK(gate_esp_init(&g_gates[i], &g_gates_hw[i], &k_gate_cfg[i], (uint8_t)i, g_ev, on_gate_transicion));
+    }
+    if (err == ESP_OK) g_strip_task = crear_tarea(gate_strip_task, "strip", STACK_STRIP, NULL, PRIO_STRIP, CORE_NET, PILA(s_strip));
 }
 
-void app_main(void) {
+/**
+ * @brief Segunda etapa del arranque: NVS, WiFi, portal y MQTT. Corre en paralelo con la FSM, que ya
+ *        protege el portón; un borrado de NVS o un AP lento no retrasan el control local.
+ */
+static void net_boot_task(void *arg) {
     esp_err_t ret = nvs_flash_init();
     if (ret == ESP_ERR_NVS_NO_FREE_PAGES || ret == ESP_ERR_NVS_NEW_VERSION_FOUND) { ESP_ERROR_CHECK(nvs_flash_erase()); ESP_ERROR_CHECK(nvs_flash_init()); }
+    ESP_ERROR_CHECK(nvs_cache_init(NVS_NAMESPACE, NVS_COMMIT_MS));
+    local_cmd_init(on_local_cmd);
+    cargar_travel_nvs();
+    gate_ota_init(gates_en_reposo, publicar_ota);
+    alog_reenviar(reenviar_log, ALOG_WARN);
 
-    gpio_init_all();
     wifi_init_sta();
-
-    q_cmd = xQueueCreate(16, sizeof(gate_cmd_t));
+    local_arrancar();   // no depende del broker ni de internet
     if (g_mqtt_uri[0]) mqtt_init();   // solo si hay broker configurado
+    ESP_LOGI(TAG, "Red iniciada.");
+    vTaskDelete(NULL);
+}
+
+void app_main(void) {
+    // Primera etapa: GPIO + FSM, sin depender de NVS ni de la red (la red usa g_ev y q_cmd)
+    g_fsm_task = crear_tarea(state_machine_task, "state_machine", STACK_FSM, xTaskGetCurrentTaskHandle(), PRIO_FSM, CORE_CTRL, PILA(s_fsm));
+    ulTaskNotifyTake(pdTRUE, portMAX_DELAY);
+    alog_iniciar(PRIO_LOG, CORE_NET);   // lo que la FSM registró hasta acá ya está en el anillo
 
-    xTaskCreatePinnedToCore(state_machine_task, "state_machine_task", 4096, NULL, 10, NULL, tskNO_AFFINITY);
+    crear_tarea(net_boot_task, "net_boot", STACK_NET_BOOT, NULL, PRIO_NET_BOOT, CORE_NET, PILA(s_net_boot));
     ESP_LOGI(TAG, "Sistema iniciado.");
 }
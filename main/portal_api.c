@@ -0,0 +1,168 @@
+/**
+ * @file portal_api.c
+ * @brief Handlers /api/status, /api/cmd y /ws; empuje de transiciones a los WebSocket abiertos.
+ */
+
+#include "portal_api.h"
+
+#include <stdio.h>
+#include <string.h>
+
+#include "esp_log.h"
+#include "esp_timer.h"
+
+#include "gate_json.h"
+
+static const char *TAG = "PORTAL_API";
+
+#define API_CMD_MAX   128   // cuerpo de un comando (JSON o CBOR)
+#define API_FDS       8     // >= max_open_sockets del httpd
+#define API_DOC_MAX   (GATE_JSON_MAX + 48)   // + "gate" y "name"
+
+static httpd_handle_t s_h = NULL;
+static const gate_t *s_gates = NULL;
+static size_t s_n = 0;
+static portal_api_cmd_t s_cmd = NULL;
+static portal_api_permiso_t s_permiso = NULL;
+static portal_api_stats_t s_st;
+static uint32_t s_pend;               // portones con cambio sin empujar (bit = id)
+static volatile bool s_ws_hay;        // algún handshake desde la última lista vacía
+static char s_buf[512];               // el httpd atiende de a una petición
+
+// ------------------------------ DOCUMENTO -------------------------------------
+/** @brief {"gate":<id>,"name":"<nombre>","state":...} a partir de una foto del portón. */
+static size_t doc_gate(char *buf, size_t cap, const gate_t *g) {
+    gate_t f = *g;   // foto: la FSM puede estar escribiendo en la otra tarea
+    int h = snprintf(buf, cap, "{\"gate\":%u,\"name\":\"%s\"", (unsigned)f.id, f.cfg->nombre);
+    if (h <= 0 || (size_t)h >= cap) return 0;
+    size_t n = gate_json_estado(buf + h, cap - (size_t)h, &f, true, true);
+    if (!n) return 0;
+    buf[h] = ',';    // el '{' del documento pasa a ser el separador
+    return (size_t)h + n;
+}
+
+// ------------------------------ WEBSOCKET -------------------------------------
+#ifdef CONFIG_HTTPD_WS_SUPPORT
+static void empujar(void *arg) {
+    uint32_t bits = __atomic_exchange_n(&s_pend, 0u, __ATOMIC_ACQ_REL);
+    int fds[API_FDS]; size_t nfd = API_FDS;
+    if (!bits || httpd_get_client_list(s_h, &nfd, fds) != ESP_OK) return;
+    uint32_t vivos = 0;
+    for (size_t i = 0; i < nfd; i++) vivos += httpd_ws_get_fd_info(s_h, fds[i]) == HTTPD_WS_CLIENT_WEBSOCKET;
+    s_st.ws_clientes = vivos;
+    if (!vivos) { s_ws_hay = false; return; }
+
+    char doc[API_DOC_MAX];
+    for (size_t k = 0; k < s_n; k++) {
+        if (!(bits & (1u << k))) continue;
+        size_t n = doc_gate(doc, sizeof(doc), &s_gates[k]);
+        if (!n) continue;
+        httpd_ws_frame_t fr = { .final = true, .type = HTTPD_WS_TYPE_TEXT, .payload = (uint8_t *)doc, .len = n };
+        for (size_t i = 0; i < nfd; i++) {
+            if (httpd_ws_get_fd_info(s_h, fds[i]) != HTTPD_WS_CLIENT_WEBSOCKET) continue;
+            if (httpd_ws_send_frame_async(s_h, fds[i], &fr) == ESP_OK) s_st.empujes++;
+        }
+    }
+}
+
+static void pedir_empuje(uint32_t bits) {
+    if (__atomic_fetch_or(&s_pend, bits, __ATOMIC_ACQ_REL)) return;   // ya hay uno en cola: se suma
+    if (httpd_queue_work(s_h, empujar, NULL) != ESP_OK) __atomic_store_n(&s_pend, 0u, __ATOMIC_RELEASE);
+}
+
+static esp_err_t ws_handler(httpd_req_t *req) {
+    if (req->method == HTTP_GET) {   // handshake ya respondido: el nuevo recibe la foto completa
+        s_ws_hay = true;
+        pedir_empuje((s_n >= 32) ? UINT32_MAX : ((1u << s_n) - 1u));
+        return ESP_OK;
+    }
+    uint8_t buf[API_CMD_MAX];
+    httpd_ws_frame_t fr = { 0 };
+    if (httpd_ws_recv_frame(req, &fr, 0) != ESP_OK) return ESP_FAIL;
+    if (fr.len == 0 || fr.len > sizeof(buf)) return ESP_FAIL;   // cierra: nadie manda comandos así
+    fr.payload = buf;
+    if (httpd_ws_recv_frame(req, &fr, fr.len) != ESP_OK) return ESP_FAIL;
+    if (fr.type != HTTPD_WS_TYPE_TEXT && fr.type != HTTPD_WS_TYPE_BINARY) return ESP_OK;
+    s_st.cmds++;
+    if (!s_permiso || !s_permiso()) { s_st.denegados++; return ESP_OK; }   // el empuje sigue igual
+    if (!s_cmd((const char *)buf, fr.len, fr.type == HTTPD_WS_TYPE_BINARY, esp_timer_get_time())) s_st.rechazados++;
+    return ESP_OK;
+}
+#endif
+
+void portal_api_push(const gate_t *g) {
+#ifdef CONFIG_HTTPD_WS_SUPPORT
+    if (s_h && s_ws_hay && g->id < 32) pedir_empuje(1u << g->id);
+#endif
+}
+
+// ------------------------------ HTTP ------------------------------------------
+static esp_err_t status_handler(httpd_req_t *req) {
+    httpd_resp_set_type(req, "application/json");
+    httpd_resp_set_hdr(req, "Cache-Control", "no-store");
+    size_t n = 0;
+    bool primero = true;
+    s_buf[n++] = '[';
+    for (size_t k = 0; k < s_n; k++) {
+        if (sizeof(s_buf) - n < API_DOC_MAX + 2) {   // no entra otro: sale lo que hay
+            if (httpd_resp_send_chunk(req, s_buf, (ssize_t)n) != ESP_OK) return ESP_FAIL;
+            n = 0;
+        }
+        // El separador va delante y solo si el documento salió: un portón que falla no rompe el JSON
+        size_t d = doc_gate(s_buf + n + !primero, sizeof(s_buf) - n - 1, &s_gates[k]);
+        if (!d) continue;
+        if (!primero) s_buf[n++] = ',';
+        n += d;
+        primero = false;
+    }
+    s_buf[n++] = ']';
+    s_st.status++;
+    if (httpd_resp_send_chunk(req, s_buf, (ssize_t)n) != ESP_OK) return ESP_FAIL;
+    return httpd_resp_send_chunk(req, NULL, 0);
+}
+
+static esp_err_t cmd_handler(httpd_req_t *req) {
+    int64_t t_rx = esp_timer_get_time();
+    if (!s_permiso || !s_permiso()) {
+        s_st.cmds++; s_st.denegados++;
+        httpd_resp_send_err(req, HTTPD_403_FORBIDDEN, "comandos solo con el AP de configuracion");
+        return ESP_OK;
+    }
+    if (req->content_len == 0 || req->content_len > API_CMD_MAX) {
+        httpd_resp_send_err(req, HTTPD_400_BAD_REQUEST, "cuerpo vacio o demasiado largo");
+        return ESP_OK;
+    }
+    char body[API_CMD_MAX]; size_t got = 0;
+    while (got < req->content_len) {
+        int r = httpd_req_recv(req, body + got, req->content_len - got);
+        if (r <= 0) { if (r == HTTPD_SOCK_ERR_TIMEOUT) continue; return ESP_FAIL; }
+        got += (size_t)r;
+    }
+    char ct[32] = { 0 };
+    bool cbor = httpd_req_get_hdr_value_str(req, "Content-Type", ct, sizeof(ct)) == ESP_OK && !strncmp(ct, "application/cbor", 16);
+
+    s_st.cmds++;
+    bool ok = s_cmd(body, got, cbor, t_rx);
+    if (!ok) s_st.rechazados++;
+    httpd_resp_set_status(req, ok ? "202 Accepted" : "400 Bad Request");
+    httpd_resp_set_type(req, "application/json");
+    return httpd_resp_sendstr(req, ok ? "{\"ok\":true}" : "{\"ok\":false}");
+}
+
+// ------------------------------ REGISTRO --------------------------------------
+void portal_api_registrar(httpd_handle_t h, const gate_t *gates, size_t n, portal_api_cmd_t cmd, portal_api_permiso_t permiso) {
+    if (!h) return;
+    s_h = h; s_gates = gates; s_n = n; s_cmd = cmd; s_permiso = permiso;
+    const httpd_uri_t u[] = {
+        { .uri = "/api/status", .method = HTTP_GET,  .handler = status_handler },
+        { .uri = "/api/cmd",    .method = HTTP_POST, .handler = cmd_handler },
+#ifdef CONFIG_HTTPD_WS_SUPPORT
+        { .uri = "/ws",         .method = HTTP_GET,  .handler = ws_handler, .is_websocket = true },
+#endif
+    };
+    for (size_t i = 0; i < sizeof(u) / sizeof(u[0]); i++) {
+        if (httpd_register_uri_handler(h, &u[i]) != ESP_OK) ESP_LOGW(TAG, "No se pudo registrar %s", u[i].uri);
+    }
+}
+
+void portal_api_get_stats(portal_api_stats_t *st) { *st = s_st; }
@@ -0,0 +1,47 @@
+/**
+ * @file portal_api.h
+ * @brief API local sobre el httpd del portal: estado en JSON, comandos y empuje por WebSocket.
+ *
+ * GET  /api/status  -> [ {"gate":0,"name":"...","state":...}, ... ] (el documento de publicar_json()
+ *                      con el índice y el nombre del portón delante)
+ * POST /api/cmd     -> mismo JSON que "<cmd>" (o CBOR con Content-Type application/cbor); 202 si entró
+ *                      a cmd_sched, 400 si no se entendió o la cola estaba llena
+ * GET  /ws          -> WebSocket: al conectar recibe todos los portones y después un mensaje de texto
+ *                      por transición, con el mismo documento; un texto/binario entrante es un comando
+ *
+ * Los comandos no llevan firma, así que solo se aceptan mientras `permiso()` lo diga (el AP de
+ * configuración activo): en STA, POST /api/cmd contesta 403 y los frames entrantes se descartan.
+ * Desde la LAN sin AP, los comandos van por el canal UDP firmado de local_cmd.
+ *
+ * El empuje sale desde la tarea del httpd (httpd_queue_work): la FSM no espera a los sockets.
+ */
+#pragma once
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+
+#include "esp_http_server.h"
+#include "gate_fsm.h"
+
+/** @brief Entrega un comando (cuerpo JSON o CBOR); true si se aceptó. Corre en la tarea del httpd. */
+typedef bool (*portal_api_cmd_t)(const char *data, size_t len, bool cbor, int64_t t_rx_us);
+/** @brief true si se aceptan comandos sin firma en este momento. Corre en la tarea del httpd. */
+typedef bool (*portal_api_permiso_t)(void);
+
+typedef struct {
+    uint32_t status;        // GET /api/status atendidos
+    uint32_t cmds;          // comandos recibidos (POST y WebSocket)
+    uint32_t rechazados;
+    uint32_t denegados;     // comandos descartados por falta de permiso (sin AP de configuración)
+    uint32_t empujes;       // mensajes enviados por WebSocket
+    uint32_t ws_clientes;   // clientes vivos en el último empuje
+} portal_api_stats_t;
+
+/** @brief Registra los handlers en `h`; `gates` debe vivir lo que dure el servidor. */
+void portal_api_registrar(httpd_handle_t h, const gate_t *gates, size_t n, portal_api_cmd_t cmd, portal_api_permiso_t permiso);
+
+/** @brief Avisa un cambio del portón a los clientes WebSocket (tarea FSM; no bloquea). */
+void portal_api_push(const gate_t *g);
+
+void portal_api_get_stats(portal_api_stats_t *st);
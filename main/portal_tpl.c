@@ -0,0 +1,83 @@
+/**
+ * @file portal_tpl.c
+ * @brief Motor de plantillas del portal de configuración.
+ */
+
+#include "portal_tpl.h"
+
+#include <string.h>
+
+// Reemplazo HTML de un carácter (NULL = se copia tal cual)
+static inline const char *escape(char c) {
+    switch (c) {
+        case '&':  return "&amp;";
+        case '<':  return "&lt;";
+        case '>':  return "&gt;";
+        case '"':  return "&quot;";
+        case '\'': return "&#39;";
+        default:   return NULL;
+    }
+}
+
+/** @brief Si `p` empieza un marcador, devuelve su valor (o "") y deja `*fin` tras "}}". */
+static const char *marcador(const char *p, const tpl_var_t *vars, size_t nvars, const char **fin) {
+    if (p[0] != '{' || p[1] != '{') return NULL;
+    const char *cierre = strstr(p + 2, "}}");
+    if (!cierre) return NULL;
+    size_t n = (size_t)(cierre - (p + 2));
+    *fin = cierre + 2;
+    for (size_t i = 0; i < nvars; i++) {
+        if (strlen(vars[i].nombre) == n && !memcmp(vars[i].nombre, p + 2, n)) return vars[i].valor ? vars[i].valor : "";
+    }
+    return "";
+}
+
+size_t tpl_longitud(const char *tpl, const tpl_var_t *vars, size_t nvars) {
+    size_t total = 0;
+    const char *p = tpl;
+    while (*p) {
+        const char *lit = strstr(p, "{{");
+        if (!lit) { total += strlen(p); break; }
+        total += (size_t)(lit - p);
+        const char *fin, *v = marcador(lit, vars, nvars, &fin);
+        if (!v) { total += 2; p = lit + 2; continue; }
+        for (; *v; v++) { const char *e = escape(*v); total += e ? strlen(e) : 1; }
+        p = fin;
+    }
+    return total;
+}
+
+// ------------------------------- SALIDA --------------------------------------
+typedef struct { tpl_buf_t *b; tpl_out_t out; void *ctx; int err; } sal_t;
+
+static void poner(sal_t *s, const char *d, size_t n) {
+    while (n && !s->err) {
+        size_t k = s->b->cap - s->b->n;
+        if (k > n) k = n;
+        memcpy(s->b->p + s->b->n, d, k);
+        s->b->n += k; d += k; n -= k;
+        if (s->b->n == s->b->cap) { s->err = s->out(s->ctx, s->b->p, s->b->n); s->b->n = 0; }
+    }
+}
+
+int tpl_render(const char *tpl, const tpl_var_t *vars, size_t nvars, tpl_buf_t *b, tpl_out_t out, void *ctx) {
+    sal_t s = { b, out, ctx, 0 };
+    const char *p = tpl;
+    while (*p && !s.err) {
+        const char *lit = strstr(p, "{{");
+        if (!lit) { poner(&s, p, strlen(p)); break; }
+        poner(&s, p, (size_t)(lit - p));
+        const char *fin, *v = marcador(lit, vars, nvars, &fin);
+        if (!v) { poner(&s, lit, 2); p = lit + 2; continue; }
+        // Tramos sin caracteres especiales van de una vez
+        while (*v) {
+            size_t n = strcspn(v, "&<>\"'");
+            poner(&s, v, n);
+            v += n;
+            if (*v) { const char *e = escape(*v++); poner(&s, e, strlen(e)); }
+        }
+        p = fin;
+    }
+    if (!s.err && b->n) { s.err = out(ctx, b->p, b->n); b->n = 0; }
+    return s.err;
+}
@@ -0,0 +1,36 @@
+/**
+ * @file portal_tpl.h
+ * @brief Plantillas HTML de una pasada: texto fijo en flash con marcadores `{{nombre}}`.
+ *
+ * tpl_longitud() calcula el tamaño exacto de la salida (para Content-Length) y tpl_render()
+ * la produce en bloques de tamaño fijo, sin copias intermedias ni heap. Los valores se escapan
+ * para HTML (texto y atributos entre comillas simples o dobles). Un marcador desconocido se
+ * reemplaza por nada.
+ */
+#pragma once
+
+#include <stddef.h>
+
+typedef struct {
+    const char *nombre;
+    const char *valor;      // NULL = cadena vacía
+} tpl_var_t;
+
+// Bloque de salida; puede venir con datos ya puestos (p.ej. la cabecera HTTP)
+typedef struct {
+    char  *p;
+    size_t cap, n;
+} tpl_buf_t;
+
+/** @brief Destino de cada bloque lleno; devolver != 0 aborta el render. */
+typedef int (*tpl_out_t)(void *ctx, const char *data, size_t len);
+
+/** @brief Bytes exactos que producirá tpl_render() con esos valores. */
+size_t tpl_longitud(const char *tpl, const tpl_var_t *vars, size_t nvars);
+
+/**
+ * @brief Recorre la plantilla una vez y entrega la salida en bloques de `b->cap` bytes
+ *        (el último puede ser menor).
+ * @return 0, o lo que devolvió `out` si abortó.
+ */
+int tpl_render(const char *tpl, const tpl_var_t *vars, size_t nvars, tpl_buf_t *b, tpl_out_t out, void *ctx);
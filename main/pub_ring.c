@@ -0,0 +1,66 @@
+/**
+ * @file pub_ring.c
+ * @brief Anillo de transiciones + última telemetría por portón (ver pub_ring.h).
+ */
+
+#include "pub_ring.h"
+
+#include <string.h>
+
+_Static_assert((PUB_RING_N & (PUB_RING_N - 1)) == 0, "PUB_RING_N debe ser potencia de 2");
+_Static_assert(sizeof(pub_rec_t) == 16, "pub_rec_t creció");
+
+static pub_rec_t s_ring[PUB_RING_N];
+static uint32_t  s_head, s_tail;                    // índices libres, se enmascaran al usar
+static pub_rec_t s_tele[PUB_RING_MAX_GATES];
+static uint8_t   s_tele_pend;                       // bit por portón con telemetría guardada
+static pub_ring_stats_t s_st;
+
+static void foto(pub_rec_t *r, const gate_t *g, pub_rec_tipo_t tipo, int64_t t_us) {
+    *r = (pub_rec_t){ .t_us = t_us, .tipo = (uint8_t)tipo, .gate = g->id, .estado = (int8_t)g->estado, .err = (uint8_t)g->error_code,
+                      .bits = (uint8_t)((g->lsa ? PUB_BIT_LSA : 0) | (g->lsc ? PUB_BIT_LSC : 0) |
+                                        (g->motorA ? PUB_BIT_MA : 0) | (g->motorC ? PUB_BIT_MC : 0)) };
+}
+
+void pub_ring_push(const gate_t *g, pub_rec_tipo_t tipo, int64_t t_us) {
+    if (tipo == PUB_REC_TELE) {
+        if (g->id >= PUB_RING_MAX_GATES) return;
+        if (s_tele_pend & (1u << g->id)) s_st.tele_pisada++;
+        foto(&s_tele[g->id], g, tipo, t_us);
+        s_tele_pend |= (uint8_t)(1u << g->id);
+        return;
+    }
+    if (s_head - s_tail == PUB_RING_N) { s_tail++; s_st.perdidos++; }   // lleno: se pierde la más vieja
+    foto(&s_ring[s_head & (PUB_RING_N - 1)], g, tipo, t_us);
+    s_head++;
+    s_st.guardados++;
+}
+
+bool pub_ring_peek(pub_rec_t *out) {
+    if (s_head != s_tail) { *out = s_ring[s_tail & (PUB_RING_N - 1)]; return true; }
+    if (!s_tele_pend) return false;
+    *out = s_tele[__builtin_ctz(s_tele_pend)];
+    return true;
+}
+
+void pub_ring_pop(void) {   // mismo orden que pub_ring_peek()
+    if (s_head != s_tail) s_tail++;
+    else if (s_tele_pend) s_tele_pend &= (uint8_t)(s_tele_pend - 1);   // el bit más bajo
+    else return;
+    s_st.repetidos++;
+}
+
+bool pub_ring_pendiente(void) { return s_head != s_tail || s_tele_pend; }
+
+void pub_ring_a_gate(const pub_rec_t *r, const gate_t *base, gate_t *out) {
+    *out = *base;
+    gate_ref_fijar(out, NULL, 0);   // la referencia es del estado en vivo, no de la foto
+    out->estado = r->estado;  out->error_code = r->err;
+    out->lsa = (r->bits & PUB_BIT_LSA) != 0;  out->lsc = (r->bits & PUB_BIT_LSC) != 0;
+    out->motorA = (r->bits & PUB_BIT_MA) != 0; out->motorC = (r->bits & PUB_BIT_MC) != 0;
+}
+
+void pub_ring_get_stats(pub_ring_stats_t *out) {
+    *out = s_st;
+    out->pendientes = s_head - s_tail;
+}
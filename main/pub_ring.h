@@ -0,0 +1,65 @@
+/**
+ * @file pub_ring.h
+ * @brief Buffer de publicaciones para cortes del broker.
+ *
+ *  - Cada transición de estado se guarda como una foto compacta del portón (16 bytes) en un
+ *    anillo de tamaño fijo; si se llena se pisa la más vieja y se cuenta como perdida.
+ *  - La telemetría no se acumula: se guarda solo la última de cada portón.
+ *  - Al reconectar se vacía en orden (primero las transiciones, luego la telemetría), de a
+ *    pocos registros por vez para no inundar el outbox de esp-mqtt. Se mira con pub_ring_peek()
+ *    y se saca con pub_ring_pop() solo si se publicó: un corte durante el vaciado no pierde nada.
+ *
+ * Sin locks: productor y consumidor son la tarea de la FSM.
+ */
+#pragma once
+
+#include <stdint.h>
+#include <stdbool.h>
+#include <stddef.h>
+
+#include "gate_fsm.h"
+
+#define PUB_RING_N         32   // transiciones guardadas como máximo (potencia de 2)
+#define PUB_RING_MAX_GATES 8
+
+typedef enum { PUB_REC_ESTADO = 0, PUB_REC_TELE } pub_rec_tipo_t;
+
+typedef struct {
+    int64_t t_us;      // instante de la foto
+    uint8_t tipo;      // pub_rec_tipo_t
+    uint8_t gate;
+    int8_t  estado;
+    uint8_t err;
+    uint8_t bits;      // PUB_BIT_*
+    uint8_t _r[3];
+} pub_rec_t;
+
+#define PUB_BIT_LSA  (1u << 0)
+#define PUB_BIT_LSC  (1u << 1)
+#define PUB_BIT_MA   (1u << 2)
+#define PUB_BIT_MC   (1u << 3)
+
+typedef struct {
+    uint32_t guardados;    // transiciones que entraron al anillo
+    uint32_t perdidos;     // transiciones pisadas por anillo lleno
+    uint32_t tele_pisada;  // telemetrías reemplazadas por una más nueva
+    uint32_t repetidos;    // registros vaciados tras reconectar
+    uint32_t pendientes;   // en el anillo ahora
+} pub_ring_stats_t;
+
+/** @brief Guarda una foto del portón (transición al anillo, telemetría en su ranura). */
+void pub_ring_push(const gate_t *g, pub_rec_tipo_t tipo, int64_t t_us);
+
+/** @brief Siguiente registro a publicar, en orden, sin sacarlo; false si no queda nada. */
+bool pub_ring_peek(pub_rec_t *out);
+
+/** @brief Saca el registro que devolvió el último pub_ring_peek() (ya publicado). */
+void pub_ring_pop(void);
+
+/** @brief true si hay algo guardado. */
+bool pub_ring_pendiente(void);
+
+/** @brief Reconstruye un gate_t de solo lectura a partir de la foto (para gate_json_estado). */
+void pub_ring_a_gate(const pub_rec_t *r, const gate_t *base, gate_t *out);
+
+void pub_ring_get_stats(pub_ring_stats_t *out);
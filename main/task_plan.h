@@ -0,0 +1,57 @@
+/**
+ * @file task_plan.h
+ * @brief Reparto de tareas entre núcleos y prioridades.
+ *
+ * Control (FSM y antirrebote, que corre en la tarea esp_timer) en el APP_CPU; WiFi, lwIP,
+ * esp-mqtt y el servidor HTTP en el PRO_CPU. Las tareas propias se crean con estos valores;
+ * las del sistema se fijan en sdkconfig.defaults (ver la lista al final).
+ * Con TASK_PLAN_AISLADO 0 todo vuelve a tskNO_AFFINITY (mismo esquema de prioridades).
+ *
+ * Con TASK_PLAN_ESTATICO 1 las tareas propias se crean con pila y TCB estáticos (no tocan el
+ * heap). Los tamaños de pila (bytes) se ajustan mirando la pila libre que informa DIAG.
+ * Lo periódico (telemetría, reintentos, el timeout de conexión) no tiene tarea propia: va en la
+ * rueda de components/stimer, dentro de la tarea esp_timer.
+ */
+#pragma once
+
+#include "sdkconfig.h"
+#include "freertos/FreeRTOS.h"
+
+#ifndef TASK_PLAN_AISLADO
+#define TASK_PLAN_AISLADO  1
+#endif
+
+#if TASK_PLAN_AISLADO && !CONFIG_FREERTOS_UNICORE
+#define CORE_CTRL  1                // APP_CPU
+#define CORE_NET   0                // PRO_CPU
+#else
+#define CORE_CTRL  tskNO_AFFINITY
+#define CORE_NET   tskNO_AFFINITY
+#endif
+
+#ifndef TASK_PLAN_ESTATICO
+#define TASK_PLAN_ESTATICO  1
+#endif
+
+#define STACK_FSM          4096     // publica MQTT desde la FSM (transiciones, telemetría)
+#define STACK_NET_BOOT     4096     // esp_wifi_init + NVS + arranque de MQTT
+#define STACK_LOCAL        3072     // UDP + HMAC-SHA256 (mbedtls) + cmd_sched
+#define STACK_OTA          8192     // handshake TLS de esp_https_ota en la propia tarea
+#define STACK_STRIP        3072     // cuadros de la barra WS2812 (los búferes son estáticos)
+
+// Prioridades (mayor = más urgente). esp_timer (22), WiFi (23) y lwIP (18) quedan por encima,
+// pero en el otro núcleo salvo esp_timer, que es parte del lazo de control.
+#define PRIO_FSM          10        // state_machine_task
+#define PRIO_LOCAL         8        // comandos UDP de la LAN: por delante de MQTT y del portal
+#define PRIO_MQTT          5        // tarea de esp-mqtt
+#define PRIO_NET_BOOT      5        // arranque de red (se borra al terminar)
+#define PRIO_HTTPD         4        // portal
+#define PRIO_STRIP         3        // barra de estado: solo se ve, cede ante el portal y la red
+#define PRIO_OTA           2        // descarga de firmware: solo con el resto en espera
+#define PRIO_LOG           1        // components/alog: vacía el anillo de log a la UART
+// components/nvs_cache crea "nvs_commit" con NVS_CACHE_PRIO (1): los commits a flash, fuera de esp_timer
+
+// sdkconfig.defaults que acompaña a este plan:
+//   CONFIG_ESP_MAIN_TASK_AFFINITY_CPU0, CONFIG_ESP_WIFI_TASK_PINNED_TO_CORE_0,
+//   CONFIG_LWIP_TCPIP_TASK_AFFINITY_CPU0, CONFIG_MQTT_TASK_CORE_SELECTION_ENABLED + CONFIG_MQTT_USE_CORE_0,
+//   CONFIG_ESP_TIMER_TASK_AFFINITY_CPU1 y las estadísticas de FreeRTOS para task_report.
@@ -0,0 +1,69 @@
+/**
+ * @file task_report.c
+ * @brief Informe de tareas a partir de uxTaskGetSystemState() (ver task_report.h).
+ */
+
+#include "task_report.h"
+
+#include <stdio.h>
+#include <string.h>
+
+#include "sdkconfig.h"
+#include "freertos/FreeRTOS.h"
+#include "freertos/task.h"
+#include "esp_timer.h"
+
+#if CONFIG_FREERTOS_USE_TRACE_FACILITY && CONFIG_FREERTOS_GENERATE_RUN_TIME_STATS
+
+// Solo se llama desde la tarea MQTT (pedido de métricas), así que basta con estado estático
+static TaskStatus_t s_st[TASK_REPORT_MAX];
+static struct { TaskHandle_t h; uint32_t run; } s_prev[TASK_REPORT_MAX];
+static uint32_t s_prev_total;
+static int64_t  s_prev_us;
+
+static uint32_t run_previo(TaskHandle_t h) {
+    for (int i = 0; i < TASK_REPORT_MAX; i++) if (s_prev[i].h == h) return s_prev[i].run;
+    return 0;
+}
+
+size_t task_report_json(char *buf, size_t cap) {
+    uint32_t total;
+    UBaseType_t n = uxTaskGetSystemState(s_st, TASK_REPORT_MAX, &total);
+    int64_t now = esp_timer_get_time();
+    uint32_t ventana = total - s_prev_total;   // tiempo de reloj: el 100 % de un núcleo
+
+    size_t o = 0; int r;
+    r = snprintf(buf, cap, "{\"window_ms\":%lu,\"tasks\":[", (unsigned long)((now - s_prev_us) / 1000));
+    if (r < 0 || (size_t)r >= cap) return 0;
+    o = (size_t)r;
+    for (UBaseType_t i = 0; i < n; i++) {
+        const TaskStatus_t *t = &s_st[i];
+        uint32_t d = t->ulRunTimeCounter - run_previo(t->xHandle);
+        unsigned cpu10 = ventana ? (unsigned)((uint64_t)d * 1000u / ventana) : 0;   // décimas de %
+#if CONFIG_FREERTOS_VTASKLIST_INCLUDE_COREID
+        int core = (t->xCoreID == tskNO_AFFINITY) ? -1 : (int)t->xCoreID;
+#else
+        int core = -1;
+#endif
+        r = snprintf(buf + o, cap - o, "%s{\"n\":\"%s\",\"core\":%d,\"prio\":%u,\"cpu\":%u.%u,\"hwm\":%lu}", i ? "," : "",
+                     t->pcTaskName, core, (unsigned)t->uxCurrentPriority, cpu10 / 10, cpu10 % 10, (unsigned long)t->usStackHighWaterMark);
+        if (r < 0 || (size_t)r >= cap - o) return 0;
+        o += (size_t)r;
+    }
+    if (cap - o < 3) return 0;
+    buf[o++] = ']'; buf[o++] = '}'; buf[o] = '\0';
+
+    memset(s_prev, 0, sizeof(s_prev));
+    for (UBaseType_t i = 0; i < n; i++) { s_prev[i].h = s_st[i].xHandle; s_prev[i].run = s_st[i].ulRunTimeCounter; }
+    s_prev_total = total; s_prev_us = now;
+    return o;
+}
+
+#else
+
+size_t task_report_json(char *buf, size_t cap) {
+    int r = snprintf(buf, cap, "{\"tasks\":\"off\"}");
+    return (r > 0 && (size_t)r < cap) ? (size_t)r : 0;
+}
+
+#endif
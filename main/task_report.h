@@ -0,0 +1,19 @@
+/**
+ * @file task_report.h
+ * @brief Uso de CPU por tarea (entre dos informes consecutivos), núcleo, prioridad y pila libre.
+ *
+ * Necesita CONFIG_FREERTOS_USE_TRACE_FACILITY y CONFIG_FREERTOS_GENERATE_RUN_TIME_STATS; sin
+ * ellas el informe solo dice {"tasks":"off"}.
+ */
+#pragma once
+
+#include <stddef.h>
+
+#define TASK_REPORT_MAX  32   // tareas que se listan como máximo
+
+/**
+ * @brief JSON: {"window_ms":N,"tasks":[{"n":"nombre","core":c,"prio":p,"cpu":x.x,"hwm":b},...]}.
+ *        "cpu" es % de un núcleo desde el informe anterior; core -1 = sin afinidad.
+ * @return Longitud escrita, o 0 si `cap` no alcanza.
+ */
+size_t task_report_json(char *buf, size_t cap);
@@ -0,0 +1,78 @@
+/**
+ * @file tele_batch.c
+ * @brief RLE + delta por campo de las muestras de telemetría (ver tele_batch.h).
+ */
+
+#include "tele_batch.h"
+
+#include <stdio.h>
+#include <stdarg.h>
+
+// Empaquetado: [3:0] estado, [7:4] bits de finales/motor, [15:8] error
+#define V_ESTADO(v) ((int)((v) & 0x0F))
+#define V_BITS(v)   ((unsigned)(((v) >> 4) & 0x0F))
+#define V_ERR(v)    ((unsigned)((v) >> 8))
+
+static uint16_t empaquetar(const gate_t *g) {
+    unsigned bits = (g->lsa ? 1u : 0) | (g->lsc ? 2u : 0) | (g->motorA ? 4u : 0) | (g->motorC ? 8u : 0);
+    unsigned e = (g->estado >= 0 && g->estado < GATE_NUM_ESTADOS) ? (unsigned)g->estado : 0x0F;
+    return (uint16_t)(e | bits << 4 | ((unsigned)g->error_code & 0xFF) << 8);
+}
+
+void tele_batch_resync(tele_batch_t *b) { b->n = 0; b->runs = 0; b->hay_previo = false; }
+
+bool tele_batch_muestra(tele_batch_t *b, const gate_t *g, int64_t t_us, uint8_t lote) {
+    if (lote > TELE_LOTE_MAX) lote = TELE_LOTE_MAX;
+    if (b->n >= TELE_LOTE_MAX) return true;   // sin tele_batch_json() de por medio
+    uint16_t v = empaquetar(g);
+    if (b->n == 0) b->t0_us = t_us;
+    if (b->runs && b->run_val[b->runs - 1] == v) b->run_len[b->runs - 1]++;
+    else { b->run_val[b->runs] = v; b->run_len[b->runs] = 1; b->runs++; }
+    b->n++;
+    return b->n >= lote;
+}
+
+typedef struct { char *p; size_t cap, n; bool ok; } out_t;
+
+static void pf(out_t *o, const char *fmt, ...) {
+    if (!o->ok) return;
+    va_list ap; va_start(ap, fmt);
+    int r = vsnprintf(o->p + o->n, o->cap - o->n, fmt, ap);
+    va_end(ap);
+    if (r < 0 || (size_t)r >= o->cap - o->n) { o->ok = false; return; }
+    o->n += (size_t)r;
+}
+
+size_t tele_batch_json(tele_batch_t *b, char *buf, size_t cap, uint32_t dt_ms) {
+    if (!b->n || !buf || !cap) return 0;
+    out_t o = { buf, cap, 0, true };
+    b->seq++;
+    if (b->seq % TELE_KEY_CADA == 0) b->hay_previo = false;
+    if (b->hay_previo && b->runs == 1 && b->run_val[0] == b->previo) {
+        pf(&o, "{\"seq\":%lu,\"hb\":%u}", (unsigned long)b->seq, (unsigned)b->n);
+    } else {
+        pf(&o, "{\"seq\":%lu,%s\"t0\":%lu,\"dt\":%lu,\"n\":%u,\"r\":[", (unsigned long)b->seq, b->hay_previo ? "" : "\"k\":1,",
+           (unsigned long)(b->t0_us / 1000), (unsigned long)dt_ms, (unsigned)b->n);
+        bool ref = b->hay_previo; uint16_t prev = b->previo;
+        for (uint8_t i = 0; i < b->runs; i++) {
+            uint16_t v = b->run_val[i];
+            pf(&o, "%s[%u", i ? "," : "", (unsigned)b->run_len[i]);
+            bool ds = !ref || V_ESTADO(v) != V_ESTADO(prev), db = !ref || V_BITS(v) != V_BITS(prev), de = !ref || V_ERR(v) != V_ERR(prev);
+            if (ds || db || de) {
+                const char *sep = "";
+                pf(&o, ",{");
+                if (ds) { pf(&o, "\"s\":\"%s\"", estado_str(V_ESTADO(v))); sep = ","; }
+                if (db) { pf(&o, "%s\"b\":%u", sep, V_BITS(v)); sep = ","; }
+                if (de) pf(&o, "%s\"e\":%u", sep, V_ERR(v));
+                pf(&o, "}");
+            }
+            pf(&o, "]");
+            prev = v; ref = true;
+        }
+        pf(&o, "]}");
+    }
+    b->previo = b->run_val[b->runs - 1];
+    b->hay_previo = true;
+    b->n = 0; b->runs = 0;
+    return o.ok ? o.n : 0;
+}
@@ -0,0 +1,50 @@
+/**
+ * @file tele_batch.h
+ * @brief Telemetría por lotes: se muestrea más seguido y se manda un mensaje cada N muestras.
+ *
+ * Cada muestra se empaqueta en 16 bits (estado, finales, motor, error). Dentro del lote las
+ * muestras iguales y consecutivas se agrupan en corridas (RLE) y cada corrida lleva solo los
+ * campos que cambiaron respecto de la anterior (la primera, respecto del lote previo):
+ *
+ *   {"seq":7,"t0":123456,"dt":1000,"n":30,"r":[[12],[5,{"s":"ABRIENDO","b":5}],[13,{"s":"ABIERTO","b":1}]]}
+ *
+ * b = lsa | lsc<<1 | motor_open<<2 | motor_close<<3; s = estado; e = código de error.
+ * Si el lote entero repite el último valor enviado sale solo un latido: {"seq":8,"hb":30}.
+ * "k":1 marca un lote autocontenido: el primero, cada TELE_KEY_CADA lotes (por si se perdió uno
+ * con QoS 0) y tras tele_batch_resync().
+ */
+#pragma once
+
+#include <stdint.h>
+#include <stdbool.h>
+#include <stddef.h>
+
+#include "gate_fsm.h"
+
+#define TELE_LOTE_MAX   32     // muestras por lote como máximo
+#define TELE_JSON_MAX   1400   // peor caso: TELE_LOTE_MAX corridas con los tres campos
+#define TELE_KEY_CADA   16     // lotes entre dos autocontenidos
+
+typedef struct {
+    uint32_t seq;
+    int64_t  t0_us;                    // primera muestra del lote
+    uint8_t  n;                        // muestras acumuladas
+    uint8_t  runs;
+    uint8_t  run_len[TELE_LOTE_MAX];
+    uint16_t run_val[TELE_LOTE_MAX];
+    uint16_t previo;                   // último valor del lote enviado antes
+    bool     hay_previo;
+} tele_batch_t;
+
+/** @brief Vacía el lote y fuerza que el próximo sea autocontenido. */
+void tele_batch_resync(tele_batch_t *b);
+
+/** @brief Agrega una muestra del portón; devuelve true cuando ya hay `lote` muestras. */
+bool tele_batch_muestra(tele_batch_t *b, const gate_t *g, int64_t t_us, uint8_t lote);
+
+/**
+ * @brief Escribe el lote (o el latido) en `buf` y empieza uno nuevo.
+ * @param dt_ms  Periodo de muestreo, para que el receptor reconstruya los instantes.
+ * @return Longitud sin el '\0', o 0 si el lote está vacío o `cap` no alcanza.
+ */
+size_t tele_batch_json(tele_batch_t *b, char *buf, size_t cap, uint32_t dt_ms);
@@ -0,0 +1,40 @@
+/**
+ * @file travel_model.c
+ * @brief Media/varianza en línea del tiempo de recorrido y derivados (ver travel_model.h).
+ */
+
+#include "travel_model.h"
+
+#include <math.h>
+
+bool travel_agregar(travel_dir_t *d, uint32_t ms) {
+    float x = (float)ms;
+    if (travel_valido(d) && x < d->media_ms * 0.5f) { d->descartes++; return false; }
+    if (d->n < TRAVEL_VENTANA) d->n++;
+    // Con peso 1/n es Welford exacto (varianza poblacional); con n saturado, media móvil exponencial
+    float a = 1.0f / (float)d->n, delta = x - d->media_ms;
+    d->media_ms += a * delta;
+    d->var_ms2 = (1.0f - a) * (d->var_ms2 + a * delta * delta);
+    return true;
+}
+
+uint32_t travel_sigma_ms(const travel_dir_t *d) { return (uint32_t)sqrtf(d->var_ms2 > 0.0f ? d->var_ms2 : 0.0f); }
+
+uint32_t travel_timeout_ms(const travel_dir_t *d, uint32_t limite_ms) {
+    if (!travel_valido(d)) return limite_ms;
+    uint32_t media = (uint32_t)d->media_ms;
+    uint32_t m = TRAVEL_K_SIGMA * travel_sigma_ms(d);
+    uint32_t p = media * TRAVEL_MARGEN_PCT / 100u;
+    if (m < p) m = p;
+    if (m < TRAVEL_MARGEN_MIN_MS) m = TRAVEL_MARGEN_MIN_MS;
+    return (media + m < limite_ms) ? media + m : limite_ms;
+}
+
+int travel_progreso(const travel_dir_t *d, uint32_t transcurrido_ms, uint32_t *eta_ms) {
+    if (!travel_valido(d)) return -1;
+    uint32_t media = (uint32_t)d->media_ms;
+    if (eta_ms) *eta_ms = transcurrido_ms < media ? media - transcurrido_ms : 0;
+    if (!media || transcurrido_ms >= media) return 99;
+    uint32_t pct = (uint32_t)((uint64_t)transcurrido_ms * 100u / media);
+    return pct > 99 ? 99 : (int)pct;
+}
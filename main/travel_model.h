@@ -0,0 +1,54 @@
+/**
+ * @file travel_model.h
+ * @brief Tiempo de recorrido aprendido por sentido, timeout adaptativo y ETA.
+ *
+ * Cada recorrido completo (de un final de carrera al otro) actualiza en línea media y varianza
+ * (Welford). Pasadas TRAVEL_VENTANA muestras el peso de la nueva queda fijo en 1/TRAVEL_VENTANA,
+ * así el modelo sigue el desgaste o el frío sin arrastrar toda la historia.
+ *
+ *   timeout = media + max(TRAVEL_K_SIGMA·σ, TRAVEL_MARGEN_PCT % de la media, TRAVEL_MARGEN_MIN_MS)
+ *
+ * acotado por el límite fijo del portón; con menos de TRAVEL_MIN_MUESTRAS se usa el límite fijo.
+ * Sin dependencias de ESP-IDF (se compila también en el host). El struct se guarda tal cual en NVS.
+ */
+#pragma once
+
+#include <stdint.h>
+#include <stdbool.h>
+
+#define TRAVEL_MIN_MUESTRAS   5
+#define TRAVEL_VENTANA        32
+#define TRAVEL_K_SIGMA        4
+#define TRAVEL_MARGEN_PCT     15
+#define TRAVEL_MARGEN_MIN_MS  500
+#define TRAVEL_VERSION        1
+
+typedef enum { TRAVEL_ABRIR = 0, TRAVEL_CERRAR = 1 } travel_sentido_t;
+
+typedef struct {
+    uint16_t n;          // muestras (satura en TRAVEL_VENTANA)
+    uint16_t descartes;  // muestras rechazadas por cortas (final pisado a mitad de camino)
+    float    media_ms;
+    float    var_ms2;
+} travel_dir_t;
+
+typedef struct {
+    uint8_t      version;   // TRAVEL_VERSION
+    uint8_t      _r[3];
+    travel_dir_t dir[2];    // travel_sentido_t
+} travel_model_t;
+
+/** @brief Agrega un recorrido completo; false si se descartó (menos de la mitad de la media). */
+bool travel_agregar(travel_dir_t *d, uint32_t ms);
+
+static inline bool travel_valido(const travel_dir_t *d) { return d->n >= TRAVEL_MIN_MUESTRAS; }
+uint32_t travel_sigma_ms(const travel_dir_t *d);
+
+/** @brief Tiempo máximo para el próximo recorrido en ese sentido (nunca más que `limite_ms`). */
+uint32_t travel_timeout_ms(const travel_dir_t *d, uint32_t limite_ms);
+
+/**
+ * @brief Avance estimado tras `transcurrido_ms` de recorrido.
+ * @return Porcentaje 0..99 (100 solo lo da el final de carrera), o -1 sin modelo válido.
+ */
+int travel_progreso(const travel_dir_t *d, uint32_t transcurrido_ms, uint32_t *eta_ms);
@@ -0,0 +1,113 @@
+/**
+ * @file wifi_fast.c
+ * @brief Conexión dirigida con los datos de la última asociación.
+ */
+
+#include "wifi_fast.h"
+
+#include <string.h>
+
+#include "esp_timer.h"
+#include "esp_log.h"
+
+#include "nvs_cache.h"
+
+static const char *TAG = "WIFI_FAST";
+
+#define NVS_KEY_FAST  "wifi_fast"
+#define FAST_VER      1
+
+typedef struct {
+    uint8_t  ver;
+    uint8_t  canal;
+    uint8_t  bssid[6];
+    char     ssid[33];
+    uint32_t ip, mask, gw, dns;   // último lease (orden de red, como esp_ip4_addr_t)
+} fast_blob_t;
+
+typedef enum { M_BARRIDO = 0, M_DIRIGIDO, M_FALLIDO } modo_t;
+
+static fast_blob_t        s_blob;       // lo guardado (o lo que se guardará)
+static bool               s_valido;
+static bool               s_permitir_estatica;
+static bool               s_estatica;
+static modo_t             s_modo;
+static esp_netif_t       *s_netif;
+static esp_timer_handle_t s_t_dhcp;
+
+static void on_dhcp_timeout(void *arg) {
+    if (!s_valido || !s_blob.ip) return;
+    esp_netif_ip_info_t ip = { .ip.addr = s_blob.ip, .netmask.addr = s_blob.mask, .gw.addr = s_blob.gw };
+    esp_netif_dhcpc_stop(s_netif);
+    if (esp_netif_set_ip_info(s_netif, &ip) != ESP_OK) { esp_netif_dhcpc_start(s_netif); return; }
+    if (s_blob.dns) {
+        esp_netif_dns_info_t dns = { .ip.u_addr.ip4.addr = s_blob.dns, .ip.type = ESP_IPADDR_TYPE_V4 };
+        esp_netif_set_dns_info(s_netif, ESP_NETIF_DNS_MAIN, &dns);
+    }
+    s_estatica = true;
+    ESP_LOGW(TAG, "DHCP sin respuesta en %d ms: usando lease guardado " IPSTR, WIFI_FAST_DHCP_MS, IP2STR(&ip.ip));
+}
+
+void wifi_fast_init(esp_netif_t *sta, const char *ssid, bool ip_estatica) {
+    s_netif = sta;
+    s_permitir_estatica = ip_estatica;
+    size_t len = sizeof(s_blob);
+    s_valido = nvs_cache_get_blob(NVS_KEY_FAST, &s_blob, &len) == ESP_OK && len == sizeof(s_blob)
+            && s_blob.ver == FAST_VER && s_blob.canal && !strncmp(s_blob.ssid, ssid, sizeof(s_blob.ssid));
+    if (!s_valido) memset(&s_blob, 0, sizeof(s_blob));
+
+    const esp_timer_create_args_t ta = { .callback = on_dhcp_timeout, .name = "wifi_fast_dhcp" };
+    if (!s_t_dhcp) esp_timer_create(&ta, &s_t_dhcp);
+}
+
+bool wifi_fast_config(wifi_config_t *cfg) {
+    if (!s_valido) { s_modo = M_BARRIDO; return false; }
+    cfg->sta.bssid_set = true;
+    memcpy(cfg->sta.bssid, s_blob.bssid, sizeof(s_blob.bssid));
+    cfg->sta.channel = s_blob.canal;
+    cfg->sta.scan_method = WIFI_FAST_SCAN;
+    s_modo = M_DIRIGIDO;
+    ESP_LOGI(TAG, "Conexion dirigida a %02x:%02x:%02x:%02x:%02x:%02x canal %u", s_blob.bssid[0], s_blob.bssid[1],
+             s_blob.bssid[2], s_blob.bssid[3], s_blob.bssid[4], s_blob.bssid[5], s_blob.canal);
+    return true;
+}
+
+void wifi_fast_on_connected(const wifi_event_sta_connected_t *ev) {
+    memcpy(s_blob.bssid, ev->bssid, sizeof(s_blob.bssid));
+    s_blob.canal = ev->channel;
+    size_t n = ev->ssid_len < sizeof(s_blob.ssid) - 1 ? ev->ssid_len : sizeof(s_blob.ssid) - 1;
+    memcpy(s_blob.ssid, ev->ssid, n); s_blob.ssid[n] = '\0';
+    if (s_permitir_estatica && s_valido && s_blob.ip) esp_timer_start_once(s_t_dhcp, (uint64_t)WIFI_FAST_DHCP_MS * 1000ULL);
+}
+
+void wifi_fast_on_disconnected(void) {
+    esp_timer_stop(s_t_dhcp);
+    if (s_estatica) { esp_netif_dhcpc_start(s_netif); s_estatica = false; }
+    if (s_modo != M_DIRIGIDO) return;
+    // El AP cambió de canal/BSSID (o no está): desde aquí, barrido completo
+    wifi_config_t cfg;
+    if (esp_wifi_get_config(WIFI_IF_STA, &cfg) == ESP_OK) {
+        cfg.sta.bssid_set = false;
+        cfg.sta.channel = 0;
+        cfg.sta.scan_method = WIFI_ALL_CHANNEL_SCAN;
+        esp_wifi_set_config(WIFI_IF_STA, &cfg);
+    }
+    s_modo = M_FALLIDO;
+    ESP_LOGW(TAG, "Conexion dirigida fallida; barrido completo");
+}
+
+void wifi_fast_on_got_ip(const esp_netif_ip_info_t *ip) {
+    esp_timer_stop(s_t_dhcp);
+    if (s_estatica) return;   // no guardar de vuelta el propio lease guardado
+    s_blob.ver  = FAST_VER;
+    s_blob.ip   = ip->ip.addr;
+    s_blob.mask = ip->netmask.addr;
+    s_blob.gw   = ip->gw.addr;
+    esp_netif_dns_info_t dns;
+    s_blob.dns  = esp_netif_get_dns_info(s_netif, ESP_NETIF_DNS_MAIN, &dns) == ESP_OK ? dns.ip.u_addr.ip4.addr : 0;
+    s_valido = true;
+    nvs_cache_set_blob(NVS_KEY_FAST, &s_blob, sizeof(s_blob));   // sin cambios no escribe flash
+}
+
+bool wifi_fast_dirigido(void)    { return s_modo == M_DIRIGIDO; }
+bool wifi_fast_ip_estatica(void) { return s_estatica; }
@@ -0,0 +1,35 @@
+/**
+ * @file wifi_fast.h
+ * @brief Reconexión rápida: BSSID, canal y último lease guardados en NVS.
+ *
+ * Tras cada asociación con IP se guarda (vía nvs_cache, solo si cambió) el AP, el canal y la
+ * IP/máscara/gateway/DNS. En el siguiente arranque la primera conexión va dirigida a ese
+ * BSSID/canal sin barrido; si falla se vuelve al barrido completo. Opcionalmente, si el DHCP
+ * no responde a tiempo tras asociar, se aplica el último lease como IP estática.
+ */
+#pragma once
+
+#include <stdbool.h>
+#include <stdint.h>
+
+#include "esp_netif.h"
+#include "esp_wifi.h"
+
+#define WIFI_FAST_DHCP_MS  3000   // espera de DHCP antes de aplicar el lease guardado
+
+/**
+ * @brief Carga lo guardado para `ssid` (si el SSID cambió, se ignora).
+ * @param ip_estatica  Permite el fallback a IP estática con el último lease.
+ */
+void wifi_fast_init(esp_netif_t *sta, const char *ssid, bool ip_estatica);
+
+/** @brief Completa la config STA con BSSID/canal si hay datos; devuelve true si la conexión va dirigida. */
+bool wifi_fast_config(wifi_config_t *cfg);
+
+void wifi_fast_on_connected(const wifi_event_sta_connected_t *ev);
+/** @brief Si el intento dirigido falló, reconfigura para barrido completo. Llamar antes de reconectar. */
+void wifi_fast_on_disconnected(void);
+void wifi_fast_on_got_ip(const esp_netif_ip_info_t *ip);
+
+bool wifi_fast_dirigido(void);      // la conexión actual salió sin barrido
+bool wifi_fast_ip_estatica(void);   // la IP actual es el lease guardado, no de DHCP
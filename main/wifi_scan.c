@@ -0,0 +1,120 @@
+/**
+ * @file wifi_scan.c
+ * @brief Barrido asíncrono periódico, caché ordenada por RSSI y handler /api/scan.
+ */
+
+#include "wifi_scan.h"
+
+#include <stdio.h>
+#include <string.h>
+
+#include "freertos/FreeRTOS.h"
+#include "esp_log.h"
+#include "esp_timer.h"
+#include "esp_wifi.h"
+
+#include "stimer.h"
+
+static const char *TAG = "WIFI_SCAN";
+
+#define AP_JSON_MAX 160   // una entrada con el SSID todo escapado
+
+static stimer_t        s_t_barrido;
+static bool            s_pausa;
+static portMUX_TYPE    s_mux = portMUX_INITIALIZER_UNLOCKED;
+static wifi_scan_ap_t  s_ap[WIFI_SCAN_MAX];      // caché (bajo s_mux)
+static size_t          s_n;
+static int64_t         s_t_us;                   // último barrido completado
+static wifi_ap_record_t s_crudos[WIFI_SCAN_CRUDOS];   // solo la tarea de eventos
+static char            s_js[WIFI_SCAN_MAX * AP_JSON_MAX + 32];   // el httpd atiende de a una petición
+
+// ------------------------------ BARRIDO ---------------------------------------
+static void on_barrido(void *arg) {
+    if (s_pausa) return;
+    const wifi_scan_config_t sc = { .show_hidden = false, .scan_type = WIFI_SCAN_TYPE_ACTIVE,
+                                    .scan_time.active = { .min = 0, .max = WIFI_SCAN_CANAL_MS } };
+    esp_err_t err = esp_wifi_scan_start(&sc, false);   // vuelve enseguida; avisa con SCAN_DONE
+    if (err != ESP_OK) ESP_LOGD(TAG, "barrido no iniciado: %s", esp_err_to_name(err));
+}
+
+void wifi_scan_iniciar(void) {
+    stimer_crear(&s_t_barrido, on_barrido, NULL);
+    stimer_armar(&s_t_barrido, STIMER_TICK_MS, WIFI_SCAN_MS);
+}
+void wifi_scan_detener(void) { stimer_cancelar(&s_t_barrido); }
+void wifi_scan_pausar(bool pausa) { s_pausa = pausa; }
+
+void wifi_scan_on_done(void) {
+    uint16_t n = WIFI_SCAN_CRUDOS;
+    if (esp_wifi_scan_get_ap_records(&n, s_crudos) != ESP_OK) return;   // también libera la lista del driver
+    wifi_scan_ap_t ap[WIFI_SCAN_MAX]; size_t m = 0;
+    for (uint16_t i = 0; i < n; i++) {
+        const wifi_ap_record_t *r = &s_crudos[i];
+        if (!r->ssid[0]) continue;
+        size_t k = 0;
+        while (k < m && strcmp(ap[k].ssid, (const char *)r->ssid)) k++;
+        if (k < m && ap[k].rssi >= r->rssi) continue;            // ya está con mejor señal
+        if (k == m) { if (m == WIFI_SCAN_MAX) continue; m++; }
+        wifi_scan_ap_t *a = &ap[k];
+        strncpy(a->ssid, (const char *)r->ssid, sizeof(a->ssid) - 1); a->ssid[sizeof(a->ssid) - 1] = '\0';
+        memcpy(a->bssid, r->bssid, sizeof(a->bssid));
+        a->canal = r->primary; a->rssi = r->rssi; a->auth = (uint8_t)r->authmode;
+    }
+    for (size_t i = 1; i < m; i++) {   // inserción: son pocos y casi siempre vienen ordenados
+        wifi_scan_ap_t x = ap[i]; size_t j = i;
+        while (j && ap[j - 1].rssi < x.rssi) { ap[j] = ap[j - 1]; j--; }
+        ap[j] = x;
+    }
+    portENTER_CRITICAL(&s_mux);
+    memcpy(s_ap, ap, m * sizeof(ap[0])); s_n = m; s_t_us = esp_timer_get_time();
+    portEXIT_CRITICAL(&s_mux);
+}
+
+bool wifi_scan_buscar(const char *ssid, wifi_scan_ap_t *ap) {
+    bool ok = false;
+    portENTER_CRITICAL(&s_mux);
+    for (size_t i = 0; i < s_n && !ok; i++) {
+        if (!strcmp(s_ap[i].ssid, ssid)) { *ap = s_ap[i]; ok = true; }
+    }
+    portEXIT_CRITICAL(&s_mux);
+    return ok;
+}
+
+// ------------------------------ HTTP ------------------------------------------
+/** @brief Copia `s` escapando '"' y '\\'; los de control (SSID binarios) se omiten. */
+static size_t json_str(char *o, size_t cap, const char *s) {
+    size_t n = 0;
+    for (; *s && n + 2 < cap; s++) {
+        unsigned char c = (unsigned char)*s;
+        if (c < 0x20) continue;
+        if (c == '"' || c == '\\') o[n++] = '\\';
+        o[n++] = (char)c;
+    }
+    return n;
+}
+
+static esp_err_t scan_handler(httpd_req_t *req) {
+    wifi_scan_ap_t ap[WIFI_SCAN_MAX]; size_t m; int64_t t;
+    portENTER_CRITICAL(&s_mux);
+    m = s_n; memcpy(ap, s_ap, m * sizeof(ap[0])); t = s_t_us;
+    portEXIT_CRITICAL(&s_mux);
+
+    long edad = t ? (long)((esp_timer_get_time() - t) / 1000) : -1;
+    size_t n = (size_t)snprintf(s_js, sizeof(s_js), "{\"age_ms\":%ld,\"aps\":[", edad);
+    for (size_t i = 0; i < m && n + AP_JSON_MAX < sizeof(s_js); i++) {
+        n += (size_t)snprintf(s_js + n, sizeof(s_js) - n, "%s{\"ssid\":\"", i ? "," : "");
+        n += json_str(s_js + n, 66, ap[i].ssid);
+        const uint8_t *b = ap[i].bssid;
+        n += (size_t)snprintf(s_js + n, sizeof(s_js) - n, "\",\"bssid\":\"%02x:%02x:%02x:%02x:%02x:%02x\",\"ch\":%u,\"rssi\":%d,\"auth\":%u}",
+                              b[0], b[1], b[2], b[3], b[4], b[5], ap[i].canal, ap[i].rssi, ap[i].auth);
+    }
+    n += (size_t)snprintf(s_js + n, sizeof(s_js) - n, "]}");
+    httpd_resp_set_type(req, "application/json");
+    httpd_resp_set_hdr(req, "Cache-Control", "no-store");
+    return httpd_resp_send(req, s_js, (ssize_t)n);
+}
+
+void wifi_scan_registrar(httpd_handle_t h) {
+    const httpd_uri_t u = { .uri = "/api/scan", .method = HTTP_GET, .handler = scan_handler };
+    if (h && httpd_register_uri_handler(h, &u) != ESP_OK) ESP_LOGW(TAG, "No se pudo registrar %s", u.uri);
+}
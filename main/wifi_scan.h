@@ -0,0 +1,45 @@
+/**
+ * @file wifi_scan.h
+ * @brief Barrido WiFi en segundo plano con la lista de APs cercanos en caché (portal de config).
+ *
+ * Mientras el AP de configuración está activo se lanza un barrido asíncrono cada WIFI_SCAN_MS
+ * (desde la rueda stimer; el resultado llega por WIFI_EVENT_SCAN_DONE). Se guarda un AP por SSID,
+ * el de mejor RSSI, ordenados de más fuerte a más débil, con canal y BSSID. GET /api/scan sirve
+ * esa foto sin esperar a la radio, y la prueba de credenciales usa canal/BSSID para asociarse
+ * directo. Seguro entre tareas; la caché se copia con una sección crítica corta.
+ */
+#pragma once
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+
+#include "esp_http_server.h"
+
+#define WIFI_SCAN_MAX       16        // SSIDs distintos en la caché
+#define WIFI_SCAN_CRUDOS    24        // registros pedidos al driver (antes de agrupar por SSID)
+#define WIFI_SCAN_MS        20000     // periodo del barrido con el portal abierto
+#define WIFI_SCAN_CANAL_MS  120       // escucha activa por canal (~1,6 s los 13 canales)
+
+typedef struct {
+    char    ssid[33];
+    uint8_t bssid[6];
+    uint8_t canal;
+    int8_t  rssi;
+    uint8_t auth;      // wifi_auth_mode_t
+} wifi_scan_ap_t;
+
+/** @brief Arranca el barrido periódico (el primero enseguida). Tras esp_wifi_start() en APSTA. */
+void wifi_scan_iniciar(void);
+void wifi_scan_detener(void);
+/** @brief Mientras se prueba una conexión no se barre (el driver lo rechazaría y la demora). */
+void wifi_scan_pausar(bool pausa);
+
+/** @brief Llamar en WIFI_EVENT_SCAN_DONE (tarea de eventos): vuelca los registros a la caché. */
+void wifi_scan_on_done(void);
+
+/** @brief Copia el AP más fuerte con ese SSID; false si no se vio en el último barrido. */
+bool wifi_scan_buscar(const char *ssid, wifi_scan_ap_t *ap);
+
+/** @brief Registra GET /api/scan: {"age_ms":N,"aps":[{"ssid","bssid","ch","rssi","auth"},...]}. */
+void wifi_scan_registrar(httpd_handle_t h);
@@ -0,0 +1,60 @@
+/**
+ * @file cmd_hash_gen.c
+ * @brief Busca la semilla que deja cada palabra de gate_cmd_dic.h en una ranura distinta y
+ *        escribe gate_cmd_hash.h en el archivo del argumento (o por stdout). Lo corre el build
+ *        (components/gate_cmd/gate_cmd_hash.cmake) cada vez que cambia gate_cmd_dic.h.
+ *
+ * Prueba tablas de 2^bits ranuras, de la más chica que admite todas las palabras a 2^8, y por
+ * cada tamaño hasta 2^24 semillas. Termina con código 1 si no encuentra ninguna.
+ */
+
+#include <stdio.h>
+#include <string.h>
+
+#include "gate_cmd_dic.h"
+
+typedef struct { const char *s; gate_cmd_t cmd; } palabra_t;
+#define X(p, c) { p, c },
+static const palabra_t k_palabras[] = { GATE_CMD_PALABRAS(X) };
+#undef X
+#define N_PALABRAS (sizeof(k_palabras) / sizeof(k_palabras[0]))
+
+static int probar(uint32_t semilla, int bits, uint8_t *slot) {
+    memset(slot, 0, (size_t)1 << bits);
+    for (size_t i = 0; i < N_PALABRAS; i++) {
+        uint32_t k = gate_cmd_hash(k_palabras[i].s, strlen(k_palabras[i].s), semilla) >> (32 - bits);
+        if (slot[k]) return 0;
+        slot[k] = (uint8_t)(i + 1);
+    }
+    return 1;
+}
+
+int main(int argc, char **argv) {
+    static uint8_t slot[256];
+    if (argc > 1 && !freopen(argv[1], "w", stdout)) { perror(argv[1]); return 1; }
+    for (size_t i = 0; i < N_PALABRAS; i++) {
+        if (strlen(k_palabras[i].s) > GATE_CMD_PALABRA_MAX) { fprintf(stderr, "'%s' supera GATE_CMD_PALABRA_MAX\n", k_palabras[i].s); return 1; }
+        for (size_t j = 0; j < i; j++)
+            if (!strcmp(k_palabras[i].s, k_palabras[j].s)) { fprintf(stderr, "'%s' repetida\n", k_palabras[i].s); return 1; }
+    }
+    int bits = 1;
+    while ((1u << bits) < N_PALABRAS) bits++;
+    for (; bits <= 8; bits++) {
+        for (uint32_t s = 1; s < (1u << 24); s++) {
+            if (!probar(s, bits, slot)) continue;
+            printf("/**\n * @file gate_cmd_hash.h\n * @brief Tabla del hash perfecto de gate_cmd_dic.h. GENERADO por tools/cmd_hash_gen: no editar.\n */\n");
+            printf("#pragma once\n\n#include <stdint.h>\n\n");
+            printf("#define GATE_CMD_HASH_SEMILLA  0x%08xu\n", (unsigned)s);
+            printf("#define GATE_CMD_HASH_BITS     %d\n", bits);
+            printf("#define GATE_CMD_HASH_PALABRAS %u\n\n", (unsigned)N_PALABRAS);
+            printf("// índice + 1 en GATE_CMD_PALABRAS (0 = ranura vacía)\n");
+            printf("static const uint8_t k_gate_cmd_ranura[1u << GATE_CMD_HASH_BITS] = {");
+            for (int k = 0; k < (1 << bits); k++) printf("%s%u", !k ? "\n    " : k % 16 ? ", " : ",\n    ", slot[k]);
+            printf("\n};\n");
+            fprintf(stderr, "%u palabras en %d ranuras, semilla 0x%08x\n", (unsigned)N_PALABRAS, 1 << bits, (unsigned)s);
+            return 0;
+        }
+    }
+    fprintf(stderr, "sin semilla\n");
+    return 1;
+}
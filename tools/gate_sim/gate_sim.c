@@ -0,0 +1,366 @@
+/**
+ * @file gate_sim.c
+ * @brief Banco de pruebas en el host para la FSM del portón (gate_fsm + gate_cmd + gate_json).
+ *
+ * Repite escenarios de comandos y sensores sobre la planta simulada y mide:
+ *  - transiciones/s y ns por operación del motor de la FSM (tiempo real del host),
+ *  - latencias de reacción en tiempo simulado (tope -> motor parado, comando -> movimiento,
+ *    arranque -> falla por tiempo con el timeout aprendido de travel_model),
+ *  - asignaciones de heap por operación (malloc/calloc/realloc envueltos con --wrap).
+ * Además comprueba invariantes en cada paso y, al arrancar, el diccionario de comandos (gate_cmd_dic.h
+ * contra el hash perfecto generado); termina con código 1 si algo falla.
+ *
+ * Uso: gate_sim [-e escenario] [-n repeticiones] [-t segundos_sim] [-g portones] [-s semilla] [-m]
+ */
+
+#include <ctype.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <time.h>
+
+#include "gate_fsm.h"
+#include "gate_json.h"
+#include "gate_metrics.h"
+#include "gate_cmd.h"
+#include "gate_cmd_dic.h"
+#include "sim_hal.h"
+
+#define SIM_PASO_US    1000       // igual que LS_SAMPLE_US
+#define SIM_MAX_GATES  8
+#define DEBOUNCE_MS    3
+#define T_RECORRIDO_MS 15000      // T_OPEN_MS / T_CLOSE_MS del firmware
+
+// ------------------------------ HEAP ------------------------------------------
+static uint64_t s_allocs;
+
+void *__real_malloc(size_t n);
+void *__real_calloc(size_t n, size_t m);
+void *__real_realloc(void *p, size_t n);
+void *__wrap_malloc(size_t n)            { s_allocs++; return __real_malloc(n); }
+void *__wrap_calloc(size_t n, size_t m)  { s_allocs++; return __real_calloc(n, m); }
+void *__wrap_realloc(void *p, size_t n)  { s_allocs++; return __real_realloc(p, n); }
+
+// ------------------------------ RESULTADOS ------------------------------------
+typedef struct {
+    uint64_t ops, trans, ns;
+    uint64_t cmds_tx, cmds_rechazados;
+    uint64_t pub_msgs, pub_bytes;
+    uint64_t err[4];              // TIMEOUT_OPEN, TIMEOUT_CLOSE, LS_INCONSISTENT, GUARDRAIL
+    uint64_t abiertos, cerrados;  // recorridos completos
+    uint64_t emergencias, trabados;  // CMD_EMERGENCY enviados / portones trabados al final
+    uint64_t allocs;
+    uint64_t fallos;              // invariantes violados
+    sim_lat_t ls_stop, cmd_mov;
+    sim_lat_t deteccion;          // arranque del recorrido -> ERR_TIMEOUT_*
+} res_t;
+
+static res_t      s_res;
+static sim_gate_t s_gates[SIM_MAX_GATES];
+static gate_cfg_t s_cfg[SIM_MAX_GATES];
+static char       s_nombres[SIM_MAX_GATES][8];
+static int        s_n_gates = 4;
+static uint32_t   s_rng;
+
+static inline uint32_t rnd(void) { s_rng ^= s_rng << 13; s_rng ^= s_rng >> 17; s_rng ^= s_rng << 5; return s_rng; }
+static inline uint32_t rnd_n(uint32_t n) { return rnd() % n; }
+
+static inline uint64_t reloj_ns(void) {
+    struct timespec ts; clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (uint64_t)ts.tv_sec * 1000000000ULL + (uint64_t)ts.tv_nsec;
+}
+
+// --------------------------- SUMIDERO MQTT ------------------------------------
+/** @brief Igual que on_gate_transicion() del firmware, pero el "broker" solo cuenta bytes. */
+static void on_transicion(gate_t *g, int prev) {
+    static char js[GATE_JSON_MAX];
+    size_t n = gate_json_estado(js, sizeof(js), g, true, true);
+    if (n) { s_res.pub_msgs++; s_res.pub_bytes += n; }
+    s_res.trans++;
+    if (g->estado == ESTADO_ABIERTO && prev == ESTADO_ABRIENDO) s_res.abiertos++;
+    if (g->estado == ESTADO_CERRADO && prev == ESTADO_CERRANDO) s_res.cerrados++;
+    if (g->estado == ESTADO_ERROR) {
+        if (g->error_code == ERR_TIMEOUT_OPEN || g->error_code == ERR_TIMEOUT_CLOSE) sim_lat_add(&s_res.deteccion, g_sim_now_us - g->rec_t0_us);
+        switch (g->error_code) {
+            case ERR_TIMEOUT_OPEN:    s_res.err[0]++; break;
+            case ERR_TIMEOUT_CLOSE:   s_res.err[1]++; break;
+            case ERR_LS_INCONSISTENT: s_res.err[2]++; break;
+            default:                  s_res.err[3]++; break;
+        }
+    }
+    g->t_cmd_rx_us = 0;
+}
+
+// ------------------------------ ENTRADAS --------------------------------------
+/** @brief Camino de un payload MQTT (JSON o palabra): parseo sin copia y gate_comando() sobre el portón indicado. */
+static void enviar(const char *payload, size_t len) {
+    s_res.cmds_tx++;
+    uint64_t t0 = reloj_ns();
+    gate_cmd_msg_t pc;
+    bool ok = gate_cmd_parse(payload, len, &pc);
+    if (ok) {
+        gate_t *g = &s_gates[(pc.gate >= 0 && pc.gate < s_n_gates) ? pc.gate : 0].g;
+        g->t_cmd_rx_us = g_sim_now_us;
+        gate_comando(g, pc.cmd);
+        g->t_cmd_rx_us = 0;
+    }
+    s_res.ns += reloj_ns() - t0;
+    s_res.ops++;
+    if (!ok) s_res.cmds_rechazados++;
+}
+static void enviar_cmd(const char *cmd, int gate) {
+    char p[64];
+    int n = snprintf(p, sizeof(p), "{\"cmd\":\"%s\",\"gate\":%d}", cmd, gate);
+    enviar(p, (size_t)n);
+}
+static void evaluar(gate_t *g) {
+    uint64_t t0 = reloj_ns();
+    gate_evaluar(g);
+    s_res.ns += reloj_ns() - t0;
+    s_res.ops++;
+}
+
+// ------------------------------ ESCENARIOS ------------------------------------
+typedef struct {
+    const char *nombre;
+    const char *desc;
+    void (*preparar)(sim_gate_t *s);
+    void (*paso)(void);
+    bool (*esperado)(const res_t *r);
+} escenario_t;
+
+static void preparar_normal(sim_gate_t *s) { s->recorrido_us = 8000000 + rnd_n(4000000); }
+
+/** @brief Ciclos abrir/cerrar con pausas aleatorias en los extremos. */
+static void paso_ciclos_gate(sim_gate_t *s) {
+    int e = s->g.estado;
+    if (e == ESTADO_ABRIENDO || e == ESTADO_CERRANDO || g_sim_now_us < s->espera_us) return;
+    static const char *const k_medio[] = { "open", "close", "TOGGLE" };   // a mitad de recorrido: cualquiera
+    enviar_cmd(e == ESTADO_ABIERTO ? "close" : e == ESTADO_CERRADO ? "open" : k_medio[rnd_n(3)], s->g.id);
+    s->espera_us = g_sim_now_us + 20000 + rnd_n(2000000);
+}
+static void paso_ciclos(void) { for (int i = 0; i < s_n_gates; i++) paso_ciclos_gate(&s_gates[i]); }
+static bool esp_ciclos(const res_t *r) { return r->abiertos && r->cerrados && !r->err[0] && !r->err[1] && !r->err[2] && !r->err[3]; }
+
+/** @brief Ráfagas de comandos mezclados (mayúsculas, lámpara, basura) a portones al azar. */
+static void paso_tormenta(void) {
+    static const char *const k_cmds[] = { "open", "CLOSE", "Stop", "toggle", "lamp_on", "LAMP_OFF", "stop" };
+    static const char *const k_basura[] = { "{\"cmd\":}", "{\"gate\":1}", "abrir ya", "{\"cmd\":\"fly\"}", "{\"cmd\":\"open\"" };
+    if (rnd_n(4)) return;   // en media, un mensaje cada 4 ms
+    if (!rnd_n(20)) { const char *b = k_basura[rnd_n(5)]; enviar(b, strlen(b)); return; }
+    enviar_cmd(k_cmds[rnd_n(7)], (int)rnd_n((uint32_t)s_n_gates));
+}
+static bool esp_tormenta(const res_t *r) { return r->trans && r->cmds_rechazados && !r->err[3]; }
+
+/** @brief Ciclos con finales contradictorios (ambos a la vez), lecturas falsas y rebotes cortos. */
+static void paso_contradictorio(void) {
+    for (int i = 0; i < s_n_gates; i++) {
+        sim_gate_t *s = &s_gates[i];
+        if (s->forzado && g_sim_now_us >= s->fallo_hasta_us) s->forzado = 0;
+        if (!s->forzado && !rnd_n(1500)) {
+            switch (rnd_n(3)) {
+                case 0: s->forzado = GATE_LS_LSA | GATE_LS_LSC; s->fallo_hasta_us = g_sim_now_us + 5000 + rnd_n(200000); break;
+                case 1: s->forzado = rnd_n(2) ? GATE_LS_LSA : GATE_LS_LSC; s->fallo_hasta_us = g_sim_now_us + 50000; break;
+                default: // rebote más corto que el antirrebote: no debe llegar a la FSM
+                    s->forzado = GATE_LS_LSA; s->fallo_hasta_us = g_sim_now_us + (DEBOUNCE_MS - 1) * 1000; break;
+            }
+        }
+        paso_ciclos_gate(s);
+    }
+}
+static bool esp_contradictorio(const res_t *r) { return r->err[2] && !r->err[3]; }
+
+/** @brief Ciclos normales; en algún momento cada portón recibe una emergencia y no debe volver a moverse. */
+static void paso_emergencia(void) {
+    static const char *const k_emerg[] = { "emergency", "EMERGENCIA", "estop" };
+    for (int i = 0; i < s_n_gates; i++) {
+        sim_gate_t *s = &s_gates[i];
+        if (!s->g.emergencia && !rnd_n(20000)) {
+            s_res.emergencias++;
+            if (i == 0) { static const char k_suelta[] = " emergencia\n"; enviar(k_suelta, sizeof(k_suelta) - 1); }   // palabra suelta: portón 0
+            else enviar_cmd(k_emerg[rnd_n(3)], i);
+        }
+        paso_ciclos_gate(s);   // los comandos siguientes tienen que ignorarse
+    }
+}
+static bool esp_emergencia(const res_t *r) { return r->emergencias && r->trabados == r->emergencias && !r->err[3]; }
+
+/** @brief La mitad de los portones se atasca y el resto tarda más que T_RECORRIDO_MS. */
+static void preparar_timeout(sim_gate_t *s) {
+    s->recorrido_us = (int64_t)T_RECORRIDO_MS * 1000 + 2000000 + rnd_n(3000000);
+    s->atascado = rnd_n(2);
+}
+static bool esp_timeout(const res_t *r) { return r->err[0] && r->err[1] && !r->err[2] && !r->err[3]; }
+
+/** @brief Recorridos cortos hasta que el modelo aprende ambos sentidos; después la hoja se traba. */
+static void preparar_atasco(sim_gate_t *s) { s->recorrido_us = 2500000 + rnd_n(1000000); }
+static void paso_atasco(void) {
+    for (int i = 0; i < s_n_gates; i++) {
+        sim_gate_t *s = &s_gates[i];
+        if (!s->atascado && travel_valido(&s->g.travel.dir[TRAVEL_ABRIR]) && travel_valido(&s->g.travel.dir[TRAVEL_CERRAR])) s->atascado = true;
+        paso_ciclos_gate(s);
+    }
+}
+// Se detecta con el timeout aprendido (media + margen), muy por debajo del límite fijo
+static bool esp_atasco(const res_t *r) {
+    return (r->err[0] || r->err[1]) && !r->err[2] && !r->err[3] && r->deteccion.n && r->deteccion.max < (int64_t)T_RECORRIDO_MS * 1000 / 2;
+}
+
+static const escenario_t k_escenarios[] = {
+    { "ciclos",         "abrir/cerrar completos",             preparar_normal,  paso_ciclos,         esp_ciclos },
+    { "tormenta",       "rafagas de comandos y basura",       preparar_normal,  paso_tormenta,       esp_tormenta },
+    { "contradictorio", "LSA+LSC, falsas lecturas, rebotes",  preparar_normal,  paso_contradictorio, esp_contradictorio },
+    { "timeout",        "motor atascado / recorrido lento",   preparar_timeout, paso_ciclos,         esp_timeout },
+    { "atasco",         "traba tras aprender el recorrido",   preparar_atasco,  paso_atasco,         esp_atasco },
+    { "emergencia",     "sin movimiento tras CMD_EMERGENCY",  preparar_normal,  paso_emergencia,     esp_emergencia },
+};
+#define N_ESCENARIOS (sizeof(k_escenarios) / sizeof(k_escenarios[0]))
+
+// ------------------------------ INVARIANTES -----------------------------------
+static void verificar(sim_gate_t *s) {
+    const gate_t *g = &s->g;
+    bool marcha = s->a || s->c;
+    bool mal = (s->a && s->c)
+            || (s->a != g->motorA || s->c != g->motorC)
+            || (marcha && g->estado != ESTADO_ABRIENDO && g->estado != ESTADO_CERRANDO)
+            || (marcha && g->deadline_us && (uint64_t)g_sim_now_us >= g->deadline_us)
+            || (marcha && g->emergencia)
+            || (s->t_contacto_us && g_sim_now_us - s->t_contacto_us > 2 * s->debounce_us + 2 * SIM_PASO_US);
+    if (mal && s_res.fallos++ < 5) {
+        fprintf(stderr, "  invariante: t=%lld ms %s estado=%s a=%d c=%d pos=%lld ls=%u\n",
+                (long long)(g_sim_now_us / 1000), g->cfg->nombre, estado_str(g->estado), s->a, s->c,
+                (long long)(s->pos_us / 1000), (unsigned)s->snap);
+    }
+}
+
+// ------------------------------ EJECUCIÓN -------------------------------------
+static void repetir(const escenario_t *e, int64_t dur_us) {
+    g_sim_now_us = 0;
+    for (int i = 0; i < s_n_gates; i++) {
+        sim_gate_init(&s_gates[i], &s_cfg[i], (uint8_t)i, 10000000, on_transicion);
+        e->preparar(&s_gates[i]);
+        evaluar(&s_gates[i].g);   // INICIAL -> según sensores, como al arrancar la tarea FSM
+    }
+    for (g_sim_now_us = SIM_PASO_US; g_sim_now_us <= dur_us; g_sim_now_us += SIM_PASO_US) {
+        for (int i = 0; i < s_n_gates; i++) if (sim_gate_tick(&s_gates[i], SIM_PASO_US)) evaluar(&s_gates[i].g);
+        e->paso();
+        for (int i = 0; i < s_n_gates; i++) verificar(&s_gates[i]);
+    }
+    for (int i = 0; i < s_n_gates; i++) {
+        s_res.trabados += s_gates[i].g.emergencia;
+        const sim_lat_t *l[2] = { &s_gates[i].lat_ls_stop, &s_gates[i].lat_cmd_mov };   // deteccion ya va directo a s_res
+        sim_lat_t *d[2] = { &s_res.ls_stop, &s_res.cmd_mov };
+        for (int k = 0; k < 2; k++) {
+            if (!l[k]->n) continue;
+            if (!d[k]->n || l[k]->min < d[k]->min) d[k]->min = l[k]->min;
+            if (l[k]->max > d[k]->max) d[k]->max = l[k]->max;
+            d[k]->suma += l[k]->suma; d[k]->n += l[k]->n;
+        }
+    }
+}
+
+// ------------------------------ DICCIONARIO -----------------------------------
+/** @brief Cada palabra (tal cual, en mayúsculas y suelta con espacios) da su comando; lo demás se rechaza. */
+static int verificar_diccionario(void) {
+    int mal = 0;
+    char buf[GATE_CMD_PALABRA_MAX + 4];
+#define X(p, c) do { \
+        size_t n_ = sizeof(p) - 1; gate_cmd_msg_t m_; \
+        for (size_t i_ = 0; i_ < n_; i_++) buf[i_] = (char)toupper((unsigned char)p[i_]); \
+        if (gate_cmd_palabra(p, n_) != c || gate_cmd_palabra(buf, n_) != c) { mal++; fprintf(stderr, "  diccionario: '%s'\n", p); } \
+        if (gate_cmd_palabra(p, n_ - 1) == c) { mal++; fprintf(stderr, "  diccionario: prefijo de '%s'\n", p); } \
+        int k_ = snprintf(buf, sizeof(buf), " %s\r\n", p); \
+        if (!gate_cmd_parse(buf, (size_t)k_, &m_) || m_.cmd != c) { mal++; fprintf(stderr, "  diccionario: suelta '%s'\n", p); } \
+    } while (0);
+    GATE_CMD_PALABRAS(X)
+#undef X
+    for (int c = CMD_NONE + 1; c <= CMD_ULTIMO; c++) {
+        const char *n = gate_cmd_nombre((gate_cmd_t)c);
+        if ((int)gate_cmd_palabra(n, strlen(n)) != c) { mal++; fprintf(stderr, "  diccionario: nombre %s\n", n); }
+    }
+    static const char *const k_no[] = { "", " ", "opens", "abri", "fly", "stop stop", "emergenciaa", "diagX", "{\"cmd\":\"estop\"" };
+    for (size_t i = 0; i < sizeof(k_no) / sizeof(k_no[0]); i++) {
+        gate_cmd_msg_t m;
+        if (gate_cmd_parse(k_no[i], strlen(k_no[i]), &m)) { mal++; fprintf(stderr, "  diccionario: acepta '%s'\n", k_no[i]); }
+    }
+    return mal;
+}
+
+static void imprimir_lat(const char *nombre, const sim_lat_t *l) {
+    if (!l->n) { printf("  %-18s -\n", nombre); return; }
+    printf("  %-18s n=%-8u min=%.1f avg=%.2f max=%.1f ms\n", nombre, l->n,
+           l->min / 1000.0, (double)l->suma / l->n / 1000.0, l->max / 1000.0);
+}
+
+int main(int argc, char **argv) {
+    int reps = 200, seg = 60;
+    uint32_t semilla = 12345;
+    const char *solo = NULL;
+    bool metricas = false;
+    int opt;
+    while ((opt = getopt(argc, argv, "e:n:t:g:s:m")) != -1) {
+        switch (opt) {
+            case 'e': solo = optarg; break;
+            case 'n': reps = atoi(optarg); break;
+            case 't': seg = atoi(optarg); break;
+            case 'g': s_n_gates = atoi(optarg); break;
+            case 's': semilla = (uint32_t)strtoul(optarg, NULL, 0); break;
+            case 'm': metricas = true; break;
+            default:
+                fprintf(stderr, "uso: %s [-e escenario] [-n repeticiones] [-t segundos_sim] [-g portones] [-s semilla] [-m]\n", argv[0]);
+                return 2;
+        }
+    }
+    if (reps < 1 || seg < 1 || s_n_gates < 1 || s_n_gates > SIM_MAX_GATES) { fprintf(stderr, "parametros fuera de rango\n"); return 2; }
+
+    for (int i = 0; i < s_n_gates; i++) {
+        snprintf(s_nombres[i], sizeof(s_nombres[i]), "sim%d", i);
+        s_cfg[i] = (gate_cfg_t){ .nombre = s_nombres[i], .lm_activo = 0, .debounce_ms = DEBOUNCE_MS,
+                                 .t_open_ms = T_RECORRIDO_MS, .t_close_ms = T_RECORRIDO_MS };
+    }
+
+    int dic = verificar_diccionario();
+    printf("diccionario de comandos: %s\n", dic ? "FALLO" : "OK");
+    printf("gate_sim: %d repeticiones x %d s simulados x %d portones, semilla %u\n\n", reps, seg, s_n_gates, (unsigned)semilla);
+    int fallidos = dic != 0, corridos = 0;
+    for (size_t k = 0; k < N_ESCENARIOS; k++) {
+        const escenario_t *e = &k_escenarios[k];
+        if (solo && strcmp(solo, e->nombre)) continue;
+        corridos++;
+        memset(&s_res, 0, sizeof(s_res));
+        gate_metrics_reset();
+        s_rng = semilla ? semilla : 1;
+
+        uint64_t a0 = s_allocs, t0 = reloj_ns();
+        for (int r = 0; r < reps; r++) repetir(e, (int64_t)seg * 1000000);
+        uint64_t wall = reloj_ns() - t0;
+        s_res.allocs = s_allocs - a0;
+
+        bool ok = !s_res.fallos && e->esperado(&s_res);
+        if (!ok) fallidos++;
+        printf("[%s] %s (%s)\n", ok ? " OK " : "FALLO", e->nombre, e->desc);
+        printf("  ops=%llu trans=%llu cmds=%llu (rechazados %llu) pub=%llu msgs/%llu B\n",
+               (unsigned long long)s_res.ops, (unsigned long long)s_res.trans, (unsigned long long)s_res.cmds_tx,
+               (unsigned long long)s_res.cmds_rechazados, (unsigned long long)s_res.pub_msgs, (unsigned long long)s_res.pub_bytes);
+        printf("  recorridos abiertos=%llu cerrados=%llu  err T/O=%llu T/C=%llu LS=%llu GR=%llu  invariantes=%llu\n",
+               (unsigned long long)s_res.abiertos, (unsigned long long)s_res.cerrados,
+               (unsigned long long)s_res.err[0], (unsigned long long)s_res.err[1],
+               (unsigned long long)s_res.err[2], (unsigned long long)s_res.err[3], (unsigned long long)s_res.fallos);
+        printf("  fsm: %.1f ns/op, %.0f transiciones/s  (total %.2f s reales por %llu s simulados)\n",
+               s_res.ops ? (double)s_res.ns / s_res.ops : 0.0, s_res.ns ? s_res.trans * 1e9 / s_res.ns : 0.0,
+               wall / 1e9, (unsigned long long)reps * (unsigned long long)seg * (unsigned long long)s_n_gates);
+        imprimir_lat("tope -> parado", &s_res.ls_stop);
+        imprimir_lat("cmd -> movimiento", &s_res.cmd_mov);
+        imprimir_lat("arranque -> falla", &s_res.deteccion);
+        printf("  heap: %llu asignaciones (%.3f por op)\n\n", (unsigned long long)s_res.allocs,
+               s_res.ops ? (double)s_res.allocs / s_res.ops : 0.0);
+        if (metricas) {
+            static char js[1024];
+            if (gate_metrics_report(js, sizeof(js), "host", (uint32_t)seg)) printf("  metrics: %s\n\n", js);
+        }
+    }
+    if (!corridos) { fprintf(stderr, "escenario desconocido: %s\n", solo); return 2; }
+    printf("%s\n", fallidos ? "HAY FALLOS" : "todo OK");
+    return fallidos ? 1 : 0;
+}
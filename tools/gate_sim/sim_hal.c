@@ -0,0 +1,75 @@
+/**
+ * @file sim_hal.c
+ * @brief Planta simulada del portón.
+ */
+
+#include "sim_hal.h"
+
+int64_t g_sim_now_us;
+
+#define SIM(g) ((sim_gate_t *)(g)->hw)
+
+void sim_lat_add(sim_lat_t *l, int64_t us) {
+    if (l->n == 0 || us < l->min) l->min = us;
+    if (us > l->max) l->max = us;
+    l->suma += us;
+    l->n++;
+}
+
+// ---------------------------------- HAL --------------------------------------
+static void sim_motor(gate_t *g, int a, int c) {
+    sim_gate_t *s = SIM(g);
+    if (!a && !c && s->t_contacto_us) sim_lat_add(&s->lat_ls_stop, g_sim_now_us - s->t_contacto_us);
+    s->t_contacto_us = 0;
+    if ((a || c) && (a != s->a || c != s->c)) {
+        s->arranque_us = g_sim_now_us + SIM_TIEMPO_MUERTO_US;
+        if (g->t_cmd_rx_us) sim_lat_add(&s->lat_cmd_mov, s->arranque_us - g->t_cmd_rx_us);
+    }
+    s->a = a; s->c = c;
+}
+static void     sim_lamp(gate_t *g, bool on)  { (void)g; (void)on; }
+static uint32_t sim_sensores(gate_t *g)       { return SIM(g)->snap; }
+static int64_t  sim_t_flanco(gate_t *g)       { return SIM(g)->t_flanco_us; }
+static int64_t  sim_ahora(void)               { return g_sim_now_us; }
+static void     sim_deadline(gate_t *g, int64_t us) { SIM(g)->deadline_at = us > 0 ? g_sim_now_us + us : 0; }
+
+const gate_hal_t k_sim_hal = {
+    .motor = sim_motor, .lamp = sim_lamp, .sensores = sim_sensores,
+    .t_flanco_us = sim_t_flanco, .deadline = sim_deadline, .ahora_us = sim_ahora,
+};
+
+// --------------------------------- PLANTA ------------------------------------
+static inline uint32_t sim_fisico(const sim_gate_t *s) {
+    uint32_t b = s->forzado;
+    if (s->pos_us >= s->recorrido_us) b |= GATE_LS_LSA;
+    if (s->pos_us <= 0)               b |= GATE_LS_LSC;
+    return b;
+}
+
+void sim_gate_init(sim_gate_t *s, const gate_cfg_t *cfg, uint8_t id, int64_t recorrido_us, gate_transicion_cb_t cb) {
+    *s = (sim_gate_t){ .recorrido_us = recorrido_us, .debounce_us = (int64_t)cfg->debounce_ms * 1000 };
+    s->candidato = s->snap = sim_fisico(s);
+    gate_init(&s->g, cfg, id, &k_sim_hal, s, cb);
+}
+
+bool sim_gate_tick(sim_gate_t *s, int64_t dt_us) {
+    if ((s->a || s->c) && !s->atascado && g_sim_now_us >= s->arranque_us) {
+        s->pos_us += s->a ? dt_us : -dt_us;
+        if (s->pos_us < 0) s->pos_us = 0;
+        if (s->pos_us > s->recorrido_us) s->pos_us = s->recorrido_us;
+    }
+    bool tope = (s->a && s->pos_us >= s->recorrido_us) || (s->c && s->pos_us <= 0);
+    if (tope && !s->t_contacto_us && !s->atascado) s->t_contacto_us = g_sim_now_us;
+
+    // Mismo criterio que ls_debounce: cualquier cambio reinicia la ventana de estabilidad
+    uint32_t fis = sim_fisico(s);
+    if (fis != s->candidato) {
+        if (s->candidato == s->snap) s->t_flanco_us = g_sim_now_us;   // primer flanco de la ráfaga
+        s->candidato = fis;
+        s->t_cand_us = g_sim_now_us;
+    }
+    bool evaluar = false;
+    if (s->candidato != s->snap && g_sim_now_us - s->t_cand_us >= s->debounce_us) { s->snap = s->candidato; evaluar = true; }
+    if (s->deadline_at && g_sim_now_us >= s->deadline_at) { s->deadline_at = 0; evaluar = true; }
+    return evaluar;
+}
@@ -0,0 +1,59 @@
+/**
+ * @file sim_hal.h
+ * @brief gate_hal_t simulado para el host: motor con tiempo de recorrido, finales de carrera
+ *        con antirrebote equivalente a ls_debounce e inyección de fallos.
+ *
+ * El tiempo es simulado (g_sim_now_us) y avanza en pasos fijos desde gate_sim.c.
+ */
+#pragma once
+
+#include <stdint.h>
+#include <stdbool.h>
+
+#include "gate_fsm.h"
+
+#define SIM_TIEMPO_MUERTO_US  10000   // mismo retardo que hal_motor() del firmware al arrancar
+
+extern int64_t g_sim_now_us;
+extern const gate_hal_t k_sim_hal;
+
+typedef struct { uint32_t n; int64_t min, max, suma; } sim_lat_t;
+
+typedef struct {
+    gate_t   g;                 // debe ir primero: gate_t::hw apunta a esta estructura
+
+    // Planta
+    int64_t  recorrido_us;      // tiempo de recorrido completo con el motor en marcha
+    int64_t  pos_us;            // 0 = cerrado, recorrido_us = abierto
+    bool     atascado;          // el motor gira pero la hoja no avanza
+    int      a, c;              // pines del motor tal como los dejó el HAL
+    int64_t  arranque_us;       // el motor se mueve a partir de aquí (tiempo muerto)
+    uint32_t forzado;           // bits GATE_LS_* inyectados (contradicciones, rebotes)
+
+    // Antirrebote
+    int64_t  debounce_us;
+    uint32_t candidato, snap;
+    int64_t  t_cand_us, t_flanco_us;
+
+    int64_t  deadline_at;       // 0 = sin aviso pendiente
+    int64_t  t_contacto_us;     // el motor empuja contra un tope desde aquí (0 = no)
+
+    // Latencias en tiempo simulado
+    sim_lat_t lat_ls_stop;      // contacto físico con el tope -> motor parado
+    sim_lat_t lat_cmd_mov;      // comando recibido -> hoja en movimiento
+
+    // Libre para el escenario
+    int64_t  espera_us;
+    int64_t  fallo_hasta_us;
+} sim_gate_t;
+
+void sim_lat_add(sim_lat_t *l, int64_t us);
+
+/** @brief Inicializa planta y portón (cerrado, en INICIAL) sobre k_sim_hal. */
+void sim_gate_init(sim_gate_t *s, const gate_cfg_t *cfg, uint8_t id, int64_t recorrido_us, gate_transicion_cb_t cb);
+
+/**
+ * @brief Avanza la planta `dt_us` (el reloj lo mueve quien llama).
+ * @return true si hay que llamar a gate_evaluar(): flanco confirmado o deadline vencido.
+ */
+bool sim_gate_tick(sim_gate_t *s, int64_t dt_us);
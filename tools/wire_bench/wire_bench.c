@@ -0,0 +1,77 @@
+/**
+ * @file wire_bench.c
+ * @brief Bytes y ns/op de los caminos JSON y CBOR de estado y comandos, con los mismos módulos
+ *        que compila el firmware (gate_json.c, gate_cmd.c, gate_wire.c).
+ *
+ * Uso: wire_bench [-n iteraciones]
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <unistd.h>
+
+#include "gate_json.h"
+#include "gate_cmd.h"
+#include "gate_wire.h"
+
+static volatile size_t g_sumidero;   // evita que el compilador descarte los bucles
+
+static double ahora_ns(void) {
+    struct timespec ts; clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (double)ts.tv_sec * 1e9 + (double)ts.tv_nsec;
+}
+
+typedef struct { const char *nombre; size_t bytes; double ns; bool ok; } medida_t;
+
+static void imprimir(const medida_t *m) {
+    printf("  %-28s %4zu B  %8.1f ns/op%s\n", m->nombre, m->bytes, m->ns, m->ok ? "" : "  (FALLO)");
+}
+
+int main(int argc, char **argv) {
+    long iters = 2000000;
+    int opt;
+    while ((opt = getopt(argc, argv, "n:")) != -1) {
+        if (opt == 'n') iters = atol(optarg);
+        else { fprintf(stderr, "uso: %s [-n iteraciones]\n", argv[0]); return 2; }
+    }
+    if (iters <= 0) iters = 1;
+
+    // Peor caso de estado: nombre más largo, motor y error de dos dígitos
+    gate_t g = { .estado = ESTADO_DESCONOCIDO, .lsa = 1, .lsc = 0, .motorA = 0, .motorC = 1, .error_code = 12 };
+    char js[GATE_JSON_MAX]; uint8_t cb[GATE_CBOR_MAX];
+    medida_t m[4];
+    double t0;
+
+    // --- estado: codificar ---
+    t0 = ahora_ns();
+    for (long i = 0; i < iters; i++) { g.lsa = (int)(i & 1); g_sumidero += gate_json_estado(js, sizeof(js), &g, true, true); }
+    m[0] = (medida_t){ "estado JSON (codificar)", gate_json_estado(js, sizeof(js), &g, true, true), (ahora_ns() - t0) / (double)iters, true };
+    t0 = ahora_ns();
+    for (long i = 0; i < iters; i++) { g.lsa = (int)(i & 1); g_sumidero += gate_cbor_estado(cb, sizeof(cb), &g, true, true); }
+    m[1] = (medida_t){ "estado CBOR (codificar)", gate_cbor_estado(cb, sizeof(cb), &g, true, true), (ahora_ns() - t0) / (double)iters, true };
+
+    // --- comando: decodificar ---
+    static const char k_cmd_js[] = "{\"cmd\":\"TOGGLE\",\"gate\":3}";
+    uint8_t cmd_cb[16]; gw_writer_t w; gw_writer_init(&w, cmd_cb, sizeof(cmd_cb));
+    gw_map(&w, 2); gw_put_uint(&w, GW_K_CMD, CMD_TOGGLE); gw_put_uint(&w, GW_K_GATE, 3);
+    size_t cmd_cb_n = gw_writer_len(&w);
+    gate_cmd_msg_t pc; bool ok = true;
+
+    t0 = ahora_ns();
+    for (long i = 0; i < iters; i++) { ok &= gate_cmd_parse_json(k_cmd_js, sizeof(k_cmd_js) - 1, &pc); g_sumidero += (size_t)pc.gate; }
+    ok &= pc.cmd == CMD_TOGGLE && pc.gate == 3;
+    m[2] = (medida_t){ "comando JSON (decodificar)", sizeof(k_cmd_js) - 1, (ahora_ns() - t0) / (double)iters, ok };
+    ok = true;
+    t0 = ahora_ns();
+    for (long i = 0; i < iters; i++) { ok &= gate_cmd_parse_cbor(cmd_cb, cmd_cb_n, &pc); g_sumidero += (size_t)pc.gate; }
+    ok &= pc.cmd == CMD_TOGGLE && pc.gate == 3;
+    m[3] = (medida_t){ "comando CBOR (decodificar)", cmd_cb_n, (ahora_ns() - t0) / (double)iters, ok };
+
+    printf("wire_bench: %ld iteraciones\n", iters);
+    for (int i = 0; i < 4; i++) imprimir(&m[i]);
+    printf("  estado:  CBOR = %.0f%% de los bytes, %.2fx de velocidad\n", 100.0 * (double)m[1].bytes / (double)m[0].bytes, m[0].ns / m[1].ns);
+    printf("  comando: CBOR = %.0f%% de los bytes, %.2fx de velocidad\n", 100.0 * (double)m[3].bytes / (double)m[2].bytes, m[2].ns / m[3].ns);
+    return (m[2].ok && m[3].ok) ? 0 : 1;
+}